@@ -27,7 +27,10 @@
 //    esp_wifi:               lib to set wifi into deep sleep
 //    WiFi:                   connect to wireless network
 //    PubSubClient:           MQTT
-//    ezTime:                 time
+//    mbedtls:                MQTT over TLS with session resumption, see tlsclient.h
+//    WiFiUdp:                SNTP, see sntp.h
+//    LittleFS:               ESP32 lib for the event log in flash
+//    HTTPClient:             firmware download, see ota.h
 //
 //  Dev history:
 //    28.08.2019, IH:         First set-up, influenced from Esp32-Radio (Ed Smallenburg), 
@@ -50,53 +53,172 @@
 //    04.07.2022, IH:         problems with pref storage
 //    05.07.2022, IH:         changed handling of start time
 //    06.07.2022, IH:         added button icon for refill
+//    17.10.2026, IH:         compile time log levels, log ring buffer in RTC memory
+//    17.10.2026, IH:         heap and stack statistics published before going to sleep
+//    17.10.2026, IH:         String replaced by fixed size buffers for topics, payloads and texts
+//    17.10.2026, IH:         static memory mode with RAM budget and heap guard after setup
+//    17.10.2026, IH:         metrics registry in RTC memory, exported every METRICS_EXPORT_WAKES
+//    17.10.2026, IH:         event log of pump runs in LittleFS, history command
+//    17.10.2026, IH:         water ledger with refill reconciliation, fixed fill percentage
+//    17.10.2026, IH:         local refill with long press of the top button, partial refills
+//    17.10.2026, IH:         manual watering by holding a button while waking up, before wifi and tft
+//    17.10.2026, IH:         pump job queue, water-now command with completion message, persistent session
+//    17.10.2026, IH:         own SNTP client with timeout instead of ezTime, POSIX time zone
+//    17.10.2026, IH:         time and cycles per phase of the wake, published before sleep
+//    17.10.2026, IH:         MQTT commands over serial without broker, injected message loss
+//    17.10.2026, IH:         wake offset per system, subscriptions kept in the broker session
+//    17.10.2026, IH:         binary status frame once per wake
+//    17.10.2026, IH:         forecast of the hours till the tank is dry, published with the water level
+//    17.10.2026, IH:         schedule from the daily water need, sleep till the next pump is due
+//    17.10.2026, IH:         multiple tanks, each with its own ledger, dry threshold and telemetry
+//    17.10.2026, IH:         firmware update over the air, resumable over wakes, rollback
+//    17.10.2026, IH:         MQTT over TLS, handshake time in the metrics
+//    17.10.2026, IH:         status frame over UDP on timer wakes, MQTT only when needed
+//    17.10.2026, IH:         font subsets with only the used glyphs, see tools/fontsubset.py
+//    17.10.2026, IH:         icons drawn in blocks with DMA instead of pixel by pixel
+//    17.10.2026, IH:         screens for pumps, tank and diagnostics, edits saved before sleep
+//    17.10.2026, IH:         build variants full, headless and pumps only, see BUILD_VARIANT
 //
 //***************************************************************************************************
 
-#define VERSION               "0.10"   // 06.07.22
+#define VERSION               "0.11"   // 17.10.26
+
+// settings first, BUILD_VARIANT selects the libraries
+#include "secrets.h"          // secrets-dummy.h is NOT used
+#include "settings.h"
 
 // libraries
 #include <Preferences.h>
+#include "esp_adc_cal.h"
+#include "esp_timer.h"
+#if BUILD_DISPLAY
 #include <TFT_eSPI.h>
 #include "Free_Fonts.h"
 #include <Button2.h>
-#include "esp_adc_cal.h"
+#endif
+#if BUILD_NETWORK
 #include "esp_wifi.h"
 #include "WiFi.h"
 #include <PubSubClient.h>
-#include <ezTime.h>
+#endif
 
 // project files
+#if BUILD_DISPLAY
 #include "icons.h"
-#include "secrets.h"          // secrets-dummy.h is NOT used
-#include "settings.h"
+#if USE_FONT_SUBSET
+#include "fonts.h"            // made by tools/fontsubset.py, replaces FSS9 and FSS12
+#endif
 #include "texts.h"
+#endif
+#include "log.h"
+#include "heapstats.h"
+#include "format.h"
+#include "metrics.h"
+#include "eventlog.h"
+#include "profile.h"
+#if BUILD_NETWORK
+#include "sntp.h"
+#include "statusframe.h"
+#include "ota.h"
+#include "statusudp.h"
+#if MQTT_TLS
+#include "tlsclient.h"
+#endif
+#endif
+#if BUILD_DISPLAY
+#include "iconblit.h"
+#include "ui.h"
+#endif
 
 //***************************************************************************************************
 //  Global data
 //***************************************************************************************************
 Preferences prefs;
+#if BUILD_DISPLAY
 TFT_eSPI tft = TFT_eSPI();
 Button2 btnT(BTN_TOP);
 Button2 btnB(BTN_BOTTOM);
+#endif
+#if BUILD_NETWORK
 WiFiClient wifiClient;
-Timezone myTZ;
+WiFiClient otaClient;                   // of the download, MQTT stays connected on wifiClient
+#if MQTT_TLS
+TlsClient mqttTlsClient;
+PubSubClient mqttClient(mqttTlsClient);
+#else
 PubSubClient mqttClient(wifiClient);
+#endif
+#endif
 
 bool wifiConnected = false;
 bool mqttConnected = false;
+bool statusUdpOnly = false;             // this wake sent its status over UDP, no MQTT
+bool otaStepped = false;                // otaStep() ran in this wake, once per wake
+unsigned long mqttReconnectAt = 0;      // millis() of the last failed reconnect, 0 if none
+
+bool logDumpRequested = false;
+bool historyRequested = false;
+bool refillRequested = false;
+bool levelChanged = false;      // by a command, published and shown in loop()
+bool scheduleChanged = false;   // by a command, the forecast is published and shown in loop()
+int refillTank;
+int32_t refillPouredMl;
+uint32_t historyFrom;
+uint32_t historyTo;
+int32_t batteryMilliVolts = 0;
+RTC_DATA_ATTR uint32_t lastJobHour = 0;       // jobHour() of the last timed job or of the first valid clock
+RTC_DATA_ATTR bool lastJobHourValid = false;  // lastJobHour set, the hours since are caught up
+time_t shownMinute = 0;         // minutes since 1.1.1970 on the info bar
+bool timedJobDue = false;       // woken by timer, watering is expected in this wake
+int manualPump = -1;            // pump run by manualWateringIfRequested(), logged when the time is known
+uint32_t manualPumpMs = 0;
 
 bool btnTClicked = false;
 bool btnBClicked = false;
+bool btnTLongClicked = false;
+bool btnTReleased = false;      // short press of the top button
+unsigned long btnEventAt = 0;   // millis() of the last button event, see uiResponse()
+unsigned long btnTFlashAt = 0;  // pressed color shown since, 0 if not
+unsigned long btnBFlashAt = 0;
+
+//***************************************************************************************************
+//  Pump jobs, run one after the other by pumpJobLoop() without blocking the network
+//***************************************************************************************************
+const uint8_t jobSourceTimed =  0;
+const uint8_t jobSourceRemote = 1;
+
+typedef struct {
+  uint8_t pump;                 // counts from 0
+  uint8_t source;               // jobSourceTimed or jobSourceRemote
+  uint32_t ms;                  // requested on-time
+} pumpJob_t;
+
+pumpJob_t pumpQueue[PUMP_QUEUE_SIZE];
+uint8_t pumpQueueHead = 0;
+uint8_t pumpQueueCount = 0;
+bool pumpRunning = false;
+unsigned long pumpSwitchedAt = 0;       // on while running, off while idle
+esp_timer_handle_t pumpOffTimer;        // switches the running pump off on time, whatever loop() does
+volatile bool pumpTimedOut = false;     // set by pumpOffTimer
+volatile unsigned long pumpTimedOutAt = 0;
+bool sleepWhenIdle = false;             // timed job queued, go to sleep once all pumps are done
+
+char serialLine[MQTT_TOPIC_LENGTH + MQTT_VALUE_LENGTH];    // see serialCommandLoop()
+size_t serialLineLength = 0;
+
+int refillSelection = 0;        // tank * refill percentages + index into refillPercentages, bottom button
 
 unsigned long timeStamp;
 
 //***************************************************************************************************
 //  Data stored in preferences
 //***************************************************************************************************
-uint16_t containerSize;
-int16_t remainingWater;
+uint16_t containerSize[NUMBER_OF_TANKS];
+int16_t remainingWater[NUMBER_OF_TANKS];
 uint16_t pumpThroughput;
+uint16_t waterCorrection[NUMBER_OF_TANKS];      // per mille, learned from refills, see ledgerRefill()
+int32_t consumedSinceRefill[NUMBER_OF_TANKS];   // predicted by pump time only, without waterCorrection
+int32_t refilledSinceRefill[NUMBER_OF_TANKS];   // partial refills since the last full refill
 uint16_t wateringFreq[NUMBER_OF_PUMPS];
 uint16_t nextWatering[NUMBER_OF_PUMPS];
 uint16_t wateringAmount[NUMBER_OF_PUMPS];
@@ -105,20 +227,48 @@ uint16_t wateringAmount[NUMBER_OF_PUMPS];
 //  Screens
 //***************************************************************************************************
 const int scrMain =       1;
+const int scrPumps =      2;    // all pumps, the bottom button selects one
+const int scrPump =       3;    // edit the selected pump
+const int scrTank =       4;    // edit a tank
+const int scrDiag =       5;    // diagnostics
+const int scrLast =       scrDiag;
 
 int currentScreen;
+int uiPump = 0;                 // selected on scrPumps, edited on scrPump
+int uiTank = 0;
+int uiField = 0;                // selected row of scrPump and scrTank, 0 is the pump or tank itself
+bool uiPumpEdited[NUMBER_OF_PUMPS];     // live at once, saved by uiSaveEdits() before sleep
+bool uiTankEdited[NUMBER_OF_TANKS];
+unsigned long uiRefreshedAt = 0;
+
+#include "budget.h"           // after all files and globals, it sums up their buffers
 
 void setup() {
 //***************************************************************************************************
 //  run once every wake up from deep sleep
 //***************************************************************************************************
-  Serial.begin(115200);
-  Serial.println();
-  Serial.print("Starting plant-nanny by Ingo Hoffmann. Version: ");
-  Serial.println(VERSION);
+  profileBegin();
+  logBegin();
+  heapStatsBegin();
+  budgetReport();
+  metricsWake(esp_sleep_get_wakeup_cause());
+
+  // relais off and a held button waters right away, everything else comes afterwards
+  pumpsInit();
+  loadPrefs();
+  manualWateringIfRequested();
+  readBatteryVoltage();
+  eventLogMount();        // LittleFS allocates, so before heapStatsSetupDone() and not on first use
+
+  LOG_I("Starting plant-nanny by Ingo Hoffmann. Version: %s", VERSION);
+  setenv("TZ", timezone, 1);
+  tzset();
+  profileMark(PROFILE_START);
 
+#if BUILD_DISPLAY
   // initialise tft
   tft.init();
+  iconBlitBegin(tft);
   tft.setRotation(1);     // landscape
 
   // draw screen layout, show some info and system number
@@ -130,74 +280,172 @@ void setup() {
   clearBottomBtn();
   showProgInfo();
   showSystemNumber();
-  loadPrefs();
   showContainerSize();
+  profileMark(PROFILE_DISPLAY);
+#endif
 
+#if BUILD_NETWORK
   // connect and show status
   esp_wifi_start();
   connectAndShowWifiStatus();
+  profileMark(PROFILE_WIFI);
   if(wifiConnected) {
     getNetworkTime();
+#if BUILD_DISPLAY
     showTime();
-    connectAndShowMQTTStatus();
+#endif
+    profileMark(PROFILE_TIME);
+    if(!statusUdpWake()) {
+      connectAndShowMQTTStatus();
+    }
+    if(mqttConnected) {
+      otaConfirm();
+    }
+    profileMark(PROFILE_MQTT);
     showAndPublishBatteryVoltage();
+    manualWateringLog();
     showAndPublishWaterLevel();
-  
-    // configure pins
-    pinMode(PUMP_1, OUTPUT);
-    pinMode(PUMP_2, OUTPUT);
-    pinMode(PUMP_3, OUTPUT);
-    pinMode(PUMP_4, OUTPUT);
-
-    // immediately turn relais off
-    digitalWrite(PUMP_1, HIGH);
-    digitalWrite(PUMP_2, HIGH);
-    digitalWrite(PUMP_3, HIGH);
-    digitalWrite(PUMP_4, HIGH);
 
+#if BUILD_DISPLAY
     // initialise buttons
     buttonsInit();
 
     // prepare ui
     currentScreen = scrMain;
     showScreen();
+#endif
     timeStamp = millis();
+    timedJobDue = (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
+    heapStatsSetupDone();
+    profileMark(PROFILE_STATUS);
   } else {
-    Serial.print("No WiFi -> ");
+    LOG_W("No WiFi");
     setTimerAndGoToSleep();
   }
+#else
+  manualWateringLog();
+  timeStamp = millis();
+  timedJobDue = (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
+  heapStatsSetupDone();
+  profileMark(PROFILE_STATUS);
+#endif
 }
 
 void loop() {
 //***************************************************************************************************
 //  LOOP
 //***************************************************************************************************
+#if BUILD_DISPLAY
   int lastScreen = 0;
+#endif
   
-  if(minuteChanged() && wifiConnected) {
+#if BUILD_NETWORK
+  sntpPoll();
+#endif
+#if BUILD_DISPLAY
+  if(wifiConnected && time(NULL) / 60 != shownMinute) {
     showTime();
   }
+#endif
 
-  if(!mqttClient.connected()) {
-    mqttReconnect();
+  pumpJobLoop();           // first, the network below may take a while
+
+#if BUILD_NETWORK
+  if(!statusUdpOnly) {
+    if(!mqttClient.connected()) {
+      mqttReconnect();
+    }
+    mqttClient.loop();
   }
-  mqttClient.loop();
 
+  if(otaActive() && !otaStepped && pumpJobsIdle()) {
+    otaStep();
+  }
+#endif
   doTimedJobIfNecessary();  // and go to sleep after job is done
+  pumpJobLoop();
 
+#if BUILD_NETWORK
+  if(logDumpRequested) {
+    logDumpRequested = false;
+    mqttPublishLog();
+  }
+  if(refillRequested) {
+    refillRequested = false;
+    ledgerRefill(refillTank, refillPouredMl);
+    showAndPublishWaterLevel();
+#if BUILD_DISPLAY
+    showScreen();
+#endif
+  }
+  if(levelChanged) {
+    levelChanged = false;
+    showAndPublishWaterLevel();
+#if BUILD_DISPLAY
+    showContainerSize();
+    showScreen();
+#endif
+  }
+  if(scheduleChanged) {
+    scheduleChanged = false;
+    LOG_I("Schedule changed, next job in %d hours", hoursToNextJob());
+    showAndPublishWaterLevel();         // the forecast follows the schedule
+#if BUILD_DISPLAY
+    showScreen();
+#endif
+  }
+  if(historyRequested) {
+    historyRequested = false;
+    eventLogStream(historyFrom, historyTo, mqttPublishHistoryBatch);
+  }
+#endif
+#if LOG_LEVEL > LOG_LEVEL_NONE
+  serialCommandLoop();
+#endif
+
+#if BUILD_DISPLAY
+  // top: short press next screen, long press refill on the main screen or next row on the others,
+  // bottom: next value of the selected row
   btnT.loop();
   btnB.loop();
   if(btnTClicked) {
+    btnTClicked = false;
     timeStamp = millis();
     showBtnTClicked();
   }
+  if(btnTReleased) {
+    btnTReleased = false;
+    timeStamp = millis();
+    currentScreen = currentScreen % scrLast + 1;
+    uiField = 0;
+    showScreen();
+    uiResponse();
+  }
+  if(btnTLongClicked) {
+    btnTLongClicked = false;
+    timeStamp = millis();
+    if(currentScreen == scrMain) {
+      localRefill();
+    } else {
+      uiNextField();
+    }
+    uiResponse();
+  }
   if(btnBClicked) {
+    btnBClicked = false;
     timeStamp = millis();
     showBtnBClicked();
+    uiChange();
+    uiResponse();
   }
+  uiLoop();
+#endif
 
+  if(!pumpJobsIdle()) {
+    timeStamp = millis();
+  }
   if((millis() - timeStamp) > (INACTIVITY_THRESHOLD * 1000)) {
-    Serial.print("No activity -> ");
+    LOG_I("No activity");
     setTimerAndGoToSleep();
   }
 }
@@ -206,59 +454,92 @@ void loadPrefs() {
 //***************************************************************************************************
 //  name space is "nanny", these name value pairs store data during deep sleep
 //***************************************************************************************************
+  char key[8];
+  int tank;
+
   prefs.begin("nanny", false);
-  containerSize = prefs.getUInt(PREF_CONTAINER_SIZE, CONTAINER_SIZE_SMALL);
-  Serial.print("Load from prefs: containerSize      = ");
-  Serial.println(String(containerSize));
-  remainingWater = prefs.getUInt(PREF_REMAINING_WATER, CONTAINER_SIZE_SMALL);
-  Serial.print("Load from prefs: remainingWater     = ");
-  Serial.println(String(remainingWater));
   pumpThroughput = prefs.getUInt(PREF_PUMP_THROUGHPUT, PUMP_BLACK);
-  Serial.print("Load from prefs: pumpThroughput     = ");
-  Serial.println(String(pumpThroughput));
+  LOG_D("Load from prefs: pumpThroughput     = %u", pumpThroughput);
+  for(tank = 0; tank < NUMBER_OF_TANKS; tank++) {
+    tankPrefKey(key, sizeof(key), PREF_CONTAINER_SIZE, tank);
+    containerSize[tank] = prefs.getUInt(key, CONTAINER_SIZE_SMALL);
+    LOG_D("Load from prefs: T%d, containerSize      = %u", tank + 1, containerSize[tank]);
+    tankPrefKey(key, sizeof(key), PREF_REMAINING_WATER, tank);
+    remainingWater[tank] = prefs.getUInt(key, CONTAINER_SIZE_SMALL);
+    LOG_D("Load from prefs: T%d, remainingWater     = %d", tank + 1, remainingWater[tank]);
+    tankPrefKey(key, sizeof(key), PREF_WATER_CORRECTION, tank);
+    waterCorrection[tank] = prefs.getUInt(key, LEDGER_CORRECTION_NONE);
+    LOG_D("Load from prefs: T%d, waterCorrection    = %u", tank + 1, waterCorrection[tank]);
+    tankPrefKey(key, sizeof(key), PREF_CONSUMED_SINCE_REFILL, tank);
+    consumedSinceRefill[tank] = prefs.getUInt(key, 0);
+    LOG_D("Load from prefs: T%d, consumedSinceRefill= %ld", tank + 1, (long)consumedSinceRefill[tank]);
+    tankPrefKey(key, sizeof(key), PREF_REFILLED_SINCE_REFILL, tank);
+    refilledSinceRefill[tank] = prefs.getUInt(key, 0);
+    LOG_D("Load from prefs: T%d, refilledSinceRefill= %ld", tank + 1, (long)refilledSinceRefill[tank]);
+  }
   // pump 1
   wateringFreq[0] = prefs.getUInt(PREF_P1_WATERING_FREQ, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P1, wateringFreq   = ");
-  Serial.println(String(wateringFreq[0]));
+  LOG_D("Load from prefs: P1, wateringFreq   = %u", wateringFreq[0]);
   nextWatering[0] = prefs.getUInt(PREF_P1_NEXT_WATERING, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P1, nextWatering   = ");
-  Serial.println(String(nextWatering[0]));
+  LOG_D("Load from prefs: P1, nextWatering   = %u", nextWatering[0]);
   wateringAmount[0] = prefs.getUInt(PREF_P1_WATERING_AMOUNT, DEFAULT_WATERING_AMOUNT);
-  Serial.print("Load from prefs: P1, wateringAmount = ");
-  Serial.println(String(wateringAmount[0]));
+  LOG_D("Load from prefs: P1, wateringAmount = %u", wateringAmount[0]);
   // pump 2
   wateringFreq[1] = prefs.getUInt(PREF_P2_WATERING_FREQ, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P2, wateringFreq   = ");
-  Serial.println(String(wateringFreq[1]));
+  LOG_D("Load from prefs: P2, wateringFreq   = %u", wateringFreq[1]);
   nextWatering[1] = prefs.getUInt(PREF_P2_NEXT_WATERING, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P2, nextWatering   = ");
-  Serial.println(String(nextWatering[1]));
+  LOG_D("Load from prefs: P2, nextWatering   = %u", nextWatering[1]);
   wateringAmount[1] = prefs.getUInt(PREF_P2_WATERING_AMOUNT, DEFAULT_WATERING_AMOUNT);
-  Serial.print("Load from prefs: P2, wateringAmount = ");
-  Serial.println(String(wateringAmount[1]));
+  LOG_D("Load from prefs: P2, wateringAmount = %u", wateringAmount[1]);
   // pump 3
   wateringFreq[2] = prefs.getUInt(PREF_P3_WATERING_FREQ, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P3, wateringFreq   = ");
-  Serial.println(String(wateringFreq[2]));
+  LOG_D("Load from prefs: P3, wateringFreq   = %u", wateringFreq[2]);
   nextWatering[2] = prefs.getUInt(PREF_P3_NEXT_WATERING, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P3, nextWatering   = ");
-  Serial.println(String(nextWatering[2]));
+  LOG_D("Load from prefs: P3, nextWatering   = %u", nextWatering[2]);
   wateringAmount[2] = prefs.getUInt(PREF_P3_WATERING_AMOUNT, DEFAULT_WATERING_AMOUNT);
-  Serial.print("Load from prefs: P3, wateringAmount = ");
-  Serial.println(String(wateringAmount[2]));
+  LOG_D("Load from prefs: P3, wateringAmount = %u", wateringAmount[2]);
   // pump 4
   wateringFreq[3] = prefs.getUInt(PREF_P4_WATERING_FREQ, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P4, wateringFreq   = ");
-  Serial.println(String(wateringFreq[3]));
+  LOG_D("Load from prefs: P4, wateringFreq   = %u", wateringFreq[3]);
   nextWatering[3] = prefs.getUInt(PREF_P4_NEXT_WATERING, DEFAULT_WATERING_FREQ);
-  Serial.print("Load from prefs: P4, nextWatering   = ");
-  Serial.println(String(nextWatering[3]));
+  LOG_D("Load from prefs: P4, nextWatering   = %u", nextWatering[3]);
   wateringAmount[3] = prefs.getUInt(PREF_P4_WATERING_AMOUNT, DEFAULT_WATERING_AMOUNT);
-  Serial.print("Load from prefs: P4, wateringAmount = ");
-  Serial.println(String(wateringAmount[3]));
+  LOG_D("Load from prefs: P4, wateringAmount = %u", wateringAmount[3]);
+  prefs.end();
+}
+
+void tankPrefKey(char* key, size_t size, const char* name, int tank) {
+//***************************************************************************************************
+//  the first tank uses the plain name as before, the others get their number appended, i.e. "rw2"
+//***************************************************************************************************
+  key[0] = '\0';
+  fmtAppend(key, size, name);
+  if(tank > 0) {
+    fmtAppendInt(key, size, tank + 1);
+  }
+}
+
+void saveTankPref(const char* name, int tank, uint32_t value) {
+//***************************************************************************************************
+//  savePref() with the key of the tank
+//***************************************************************************************************
+  char key[8];
+
+  tankPrefKey(key, sizeof(key), name, tank);
+  savePref(key, value);
+}
+
+void savePref(const char* key, uint32_t value) {
+//***************************************************************************************************
+//  single name value pair in name space "nanny"
+//***************************************************************************************************
+  prefs.begin("nanny", false);
+  prefs.putUInt(key, value);
   prefs.end();
+  metricsCount(METRIC_NVS_WRITES);
 }
 
+#if BUILD_DISPLAY
 void clearInfoBar() {
 //***************************************************************************************************
 //  time, nanny number, wifi, mqtt, water, battery
@@ -288,20 +569,20 @@ void clearStatusBar() {
 
 void clearTopBtn() {
 //***************************************************************************************************
-//  icon and text
+//  icon and text, in the pressed color while the button flashes
 //***************************************************************************************************
   tft.fillRect(LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH, 0,
                LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT / 2, 
-               COLOR_BG_TOP_BTN);
+               btnTFlashAt ? COLOR_BG_TOP_BTN_PRESS : COLOR_BG_TOP_BTN);
 }
 
 void clearBottomBtn() {
 //***************************************************************************************************
-//  icon and text
+//  icon and text, in the pressed color while the button flashes
 //***************************************************************************************************
   tft.fillRect(LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT / 2,
                LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT - (LAYOUT_LANDSCAPE_HEIGHT / 2), 
-               COLOR_BG_BOTTOM_BTN);
+               btnBFlashAt ? COLOR_BG_BOTTOM_BTN_PRESS : COLOR_BG_BOTTOM_BTN);
 }
 
 void showProgInfo() {
@@ -319,325 +600,1009 @@ void showProgInfo() {
   tft.drawString("Plant Nanny", xpos, ypos, GFXFF);
   ypos += tft.fontHeight(GFXFF);
   tft.setFreeFont(FSS9);
-  strcpy(temp, TEXT_BY);
-  strcat(temp, " Ingo Hoffmann");
+  temp[0] = '\0';
+  fmtAppend(temp, sizeof(temp), TEXT_BY);
+  fmtAppend(temp, sizeof(temp), " Ingo Hoffmann");
   tft.drawString(temp, xpos, ypos, GFXFF);
   
   tft.setTextColor(COLOR_FG_STATUS_BAR, COLOR_BG_STATUS_BAR);
   tft.setTextDatum(TL_DATUM);
   xpos = 8;
   ypos = LAYOUT_LANDSCAPE_HEIGHT - LAYOUT_STATUS_BAR_HEIGHT + 4;
-  strcpy(temp, TEXT_VERSION);
-  strcat(temp, " ");
-  strcat(temp, VERSION);
+  temp[0] = '\0';
+  fmtAppend(temp, sizeof(temp), TEXT_VERSION);
+  fmtAppendChar(temp, sizeof(temp), ' ');
+  fmtAppend(temp, sizeof(temp), VERSION);
   tft.setTextFont(0);
   tft.drawString(temp, xpos, ypos, GFXFF);
 }
+#endif
 
-void doTimedJobIfNecessary() {
+void pumpsInit() {
 //***************************************************************************************************
-//  update PREF_PX_NEXT_WATERING for each pump and check if it's watering time and if any pump is due
+//  relais are active low, switch them off before anything else
 //***************************************************************************************************
-  const int timerWindow = 30;   // to adjust for inaccuracies of timer
   int i;
 
-  // is it full hour?
-  if((minute() == 0) && (second() < timerWindow)) {
-    if(remainingWater < PUMP_RUNS_DRY) {
-      Serial.println("Water tank empty");
-    } else {
-      for(i = 0; i < NUMBER_OF_PUMPS; i++) {
-        // recalc nextWatering
-        nextWatering[i] -= 1;
-        // check if pump is due
-        if(nextWatering[i] <= 0) {
-          // set pump on
-          switch(i) {
-            case 0:
-              digitalWrite(PUMP_1, LOW);
-              break;
-            case 1:
-              digitalWrite(PUMP_2, LOW);
-              break;
-            case 2:
-              digitalWrite(PUMP_3, LOW);
-              break;
-            case 3:
-              digitalWrite(PUMP_4, LOW);
-              break;
-          }
-          // wait till amount is reached
-          delay(wateringAmount[i] * 1000);
-          // set pump off and write pref
-          switch(i) {
-            case 0:
-              digitalWrite(PUMP_1, HIGH);
-              break;
-            case 1:
-              digitalWrite(PUMP_2, HIGH);
-              break;
-            case 2:
-              digitalWrite(PUMP_3, HIGH);
-              break;
-            case 3:
-              digitalWrite(PUMP_4, HIGH);
-              break;
-          }
-          // wait a little
-          delay(100);
-          // adjust waterRemaining
-          remainingWater -= wateringAmount[i] * PUMP_BLACK;
-          // adjust nextWatering
-          nextWatering[i] = wateringFreq[i];
-        }
-      }
-      showAndPublishWaterLevel();;  
-      prefs.begin("nanny", false);
-      prefs.putUInt(PREF_P1_NEXT_WATERING, nextWatering[0]);
-      prefs.putUInt(PREF_P2_NEXT_WATERING, nextWatering[1]);
-      prefs.putUInt(PREF_P3_NEXT_WATERING, nextWatering[2]);
-      prefs.putUInt(PREF_P4_NEXT_WATERING, nextWatering[3]);
-      prefs.end();
-    }
-    setTimerAndGoToSleep();    
-  } 
+  esp_timer_create_args_t timerArgs = {};
+
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    digitalWrite(pumpPins[i], HIGH);
+    pinMode(pumpPins[i], OUTPUT);
+  }
+  timerArgs.callback = pumpOffTimerCallback;
+  timerArgs.name = "pumpoff";
+  esp_timer_create(&timerArgs, &pumpOffTimer);
 }
 
-void showScreen() {
+void pumpOffTimerCallback(void* arg) {
 //***************************************************************************************************
-//  show graphics and texts for each screen
+//  esp_timer task, only one pump runs at a time, so all go off. The job is booked by pumpJobStop()
+//  as soon as loop() comes by
 //***************************************************************************************************
-  int xpos = 10;  // left margin
-  int ypos = (LAYOUT_LANDSCAPE_HEIGHT - LAYOUT_BUTTON_WIDTH - LAYOUT_STATUS_BAR_HEIGHT) / 2 ;  // top margin
-  uint16_t color;
-  char temp[30];  // for string concatination
-  int16_t simRemainingWater;
-  int simHours;
-  uint16_t simNextWatering[NUMBER_OF_PUMPS];
   int i;
-  int simDays;
-  String tempString;
 
-  clearMainArea();
-  clearTopBtn();
-  clearBottomBtn();
-  switch(currentScreen) {
-    case scrMain:
-      // draw main area
-      tft.setTextColor(COLOR_FG_MAIN_AREA, COLOR_BG_MAIN_AREA);
-      tft.setTextDatum(TL_DATUM);
-      tft.setFreeFont(FSS9);
-      // simulate watering
-      simRemainingWater = remainingWater;
-      simHours = 0;
-      for(i=0; i < NUMBER_OF_PUMPS; i++) {
-        simNextWatering[i] = nextWatering[i];
-      }
-      while(simRemainingWater > PUMP_RUNS_DRY) {
-        for(i = 0; i < NUMBER_OF_PUMPS; i++) {
-          // recalc simNextWatering
-          simNextWatering[i] -= 1;
-          // check if pump is due
-          if(simNextWatering[i] <= 0) {
-            simRemainingWater -= wateringAmount[i] * PUMP_BLACK;
-            // adjust simNextWatering
-            simNextWatering[i] = wateringFreq[i];            
-          }
-        }
-        simHours += 1;
-      }
-      tft.drawString(TEXT_REMAINING, xpos, ypos, GFXFF);
-      simDays = simHours / 24;
-      tempString = String(simDays);
-      if(simDays > 1) {
-        tempString = TEXT_DAYS;
-      } else {
-        tempString = TEXT_DAY;
-      }
-      tft.drawString(String(simDays) + " " + tempString, xpos, ypos + 20, GFXFF);
-      // draw buttons
-      showButtonIcon(TOP_BUTTON, iconRefill, TFT_SKYBLUE);
-      break;
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    digitalWrite(pumpPins[i], HIGH);
   }
+  pumpTimedOutAt = millis();
+  pumpTimedOut = true;
 }
 
-void showButtonIcon(int button, const uint8_t* icon, uint16_t fgcolor) {
+void setPump(int pump, bool on) {
 //***************************************************************************************************
-//  
+//  pump counts from 0
 //***************************************************************************************************
-  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH + ((LAYOUT_BUTTON_WIDTH - iconWidthBig) / 2);
-  int ypos;
-  uint16_t bgcolor;
+  digitalWrite(pumpPins[pump], on ? LOW : HIGH);
+}
 
-  switch(button) {
-    case TOP_BUTTON:
-      ypos = ((LAYOUT_LANDSCAPE_HEIGHT / 2) - iconHeightBig) / 2;
-      if(btnTClicked) {
-        bgcolor = COLOR_BG_TOP_BTN_PRESS;
-      } else {
-        bgcolor = COLOR_BG_TOP_BTN;
-      }
+void manualWateringIfRequested() {
+//***************************************************************************************************
+//  woken by a button that is still held after MANUAL_HOLD_MS: the pump of that button runs as long
+//  as the button is held, at most MANUAL_WATERING_MAX seconds. A short press only shows the screen.
+//  Runs before wifi, time and tft, so the time from wake up to pump on is mostly boot time.
+//***************************************************************************************************
+  int pin;
+  int pump;
+  unsigned long onAt;
+
+  switch(esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_EXT0:
+      pin = BTN_BOTTOM;
+      pump = MANUAL_PUMP_BOTTOM;
       break;
-    case BOTTOM_BUTTON:
-      ypos = (((LAYOUT_LANDSCAPE_HEIGHT / 2) - iconHeightBig) / 2) + (LAYOUT_LANDSCAPE_HEIGHT / 2);
-      if(btnBClicked) {
-        bgcolor = COLOR_BG_BOTTOM_BTN_PRESS;
-      } else {
-        bgcolor = COLOR_BG_BOTTOM_BTN;
-      }
+    case ESP_SLEEP_WAKEUP_EXT1:
+      pin = BTN_TOP;
+      pump = MANUAL_PUMP_TOP;
       break;
+    default:
+      return;
+  }
+  pinMode(pin, INPUT_PULLUP);
+  while(digitalRead(pin) == LOW && millis() < MANUAL_HOLD_MS) {
+    delay(1);
   }
-  tft.drawXBitmap(xpos, ypos, icon, iconWidthBig, iconHeightBig, fgcolor, bgcolor);    
+  if(digitalRead(pin) != LOW) {
+    return;
+  }
+  if(tankEmpty(pumpTank[pump])) {
+    LOG_W("Water tank %d empty", pumpTank[pump] + 1);
+    metricsCount(METRIC_TANK_EMPTY);
+    return;
+  }
+  setPump(pump, true);
+  onAt = millis();
+  // millis() starts with the application, add the boot loader for the full button to pump time
+  metricsObserve(HISTOGRAM_MANUAL_LATENCY_MS, onAt);
+  while(digitalRead(pin) == LOW && millis() - onAt < MANUAL_WATERING_MAX * 1000UL) {
+    delay(10);
+  }
+  setPump(pump, false);
+  manualPumpMs = millis() - onAt;
+  manualPump = pump;
+  metricsCount(METRIC_MANUAL_WATERINGS);
+  metricsAddPumpTime(pump, manualPumpMs);
+  ledgerConsume(pumpTank[pump], manualPumpMs);
+  saveTankPref(PREF_REMAINING_WATER, pumpTank[pump], remainingWater[pumpTank[pump]]);
+  LOG_I("Manual watering: pump %d on after %lu ms for %lu ms", pump + 1, onAt, (unsigned long)manualPumpMs);
 }
 
-void showBtnTClicked() {
+void manualWateringLog() {
 //***************************************************************************************************
-//  
+//  event log entry of the manual watering, once the network time is known
 //***************************************************************************************************
-  tft.fillRect(LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH, 0,
-               LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT / 2, 
-               COLOR_BG_TOP_BTN_PRESS);
-  switch(currentScreen) {
-    case scrMain:
-      showButtonIcon(TOP_BUTTON, iconRefill, TFT_SKYBLUE);
-      break;
+  event_t event;
+
+  if(manualPump < 0) {
+    return;
   }
-  delay(200);
-  tft.fillRect(LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH, 0,
-               LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT / 2, 
-               COLOR_BG_TOP_BTN);
-  btnTClicked = false;
-  switch(currentScreen) {
-    case scrMain:
-      showButtonIcon(TOP_BUTTON, iconRefill, TFT_SKYBLUE);
-      break;
+  memset(&event, 0, sizeof(event));
+  event.time = time(NULL) - (millis() / 1000);
+  event.type = EVENT_WATERING;
+  event.pump = manualPump;
+  event.tank = pumpTank[manualPump];
+  eventSetDuration(&event, manualPumpMs);
+  event.ml = ledgerPredict(pumpTank[manualPump], manualPumpMs);
+  event.batteryMv = batteryMilliVolts;
+  eventLogAppend(&event);
+  manualPump = -1;
+}
+
+void doTimedJobIfNecessary() {
+//***************************************************************************************************
+//  update PREF_PX_NEXT_WATERING for each pump and check if it's watering time and if any pump is due,
+//  due pumps are queued and the system goes to sleep when the queue is done. The system sleeps
+//  through the hours without a due pump, they are caught up with the hours since lastJobHour.
+//***************************************************************************************************
+  const int timerWindow = 30;   // to adjust for inaccuracies of timer
+  uint32_t elapsed;
+  int i;
+
+  jobHourStart();
+  // is it full hour or woken late for it? not before the clock is synchronised
+  if(!clockSyncing() && clockValid() && jobHour() != lastJobHour && !sleepWhenIdle &&
+     (hourSeconds() < timerWindow || timedJobDue)) {
+    timedJobDue = false;
+    sleepWhenIdle = true;
+    elapsed = jobHour() - lastJobHour;
+    lastJobHour = jobHour();
+    for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+      if(wateringFreq[i] == WATERING_FREQ_OFF) {
+        continue;
+      }
+      // an empty tank only stops the pumps in it
+      if(tankEmpty(pumpTank[i])) {
+        LOG_W("Water tank %d empty, pump %d stopped", pumpTank[i] + 1, i + 1);
+        metricsCount(METRIC_TANK_EMPTY);
+        continue;
+      }
+      // recalc nextWatering, a 0 from command-next means now
+      nextWatering[i] -= min(elapsed, (uint32_t)nextWatering[i]);
+      // check if pump is due
+      if(nextWatering[i] == 0) {
+        pumpJobAdd(i, wateringAmount[i] * 1000UL, jobSourceTimed);
+        // adjust nextWatering
+        nextWatering[i] = wateringFreq[i];
+      }
+      savePref(prefNextWatering[i], nextWatering[i]);
+    }
+  }
+  if(sleepWhenIdle && pumpJobsIdle()) {
+    eventLogCompact(time(NULL));
+    setTimerAndGoToSleep();
   }
 }
 
-void showBtnBClicked() {
+bool clockValid() {
 //***************************************************************************************************
-//  
+//  the clock was synchronised once, BUILD_MINIMAL has no network and counts from power on
 //***************************************************************************************************
-  tft.fillRect(LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT / 2,
-               LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT - (LAYOUT_LANDSCAPE_HEIGHT / 2), 
-               COLOR_BG_BOTTOM_BTN_PRESS);
-  delay(200);
-  tft.fillRect(LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT / 2,
-               LAYOUT_BUTTON_WIDTH, LAYOUT_LANDSCAPE_HEIGHT - (LAYOUT_LANDSCAPE_HEIGHT / 2), 
-               COLOR_BG_BOTTOM_BTN);
-  btnBClicked = false;
+#if BUILD_NETWORK
+  return sntpTimeValid();
+#else
+  return true;
+#endif
 }
 
-void getNetworkTime() {
+bool clockSyncing() {
 //***************************************************************************************************
-//  get network time according to time zone, needs wifi connection
+//  SNTP request of this wake still open, the RTC time may be off until the reply
 //***************************************************************************************************
-  waitForSync();                    // Wait for ezTime to get its time synchronized
-  myTZ.setLocation(F(timezone));
-  setInterval(uint16_t(86400));      // 86400 = 60 * 60 * 24, set NTP polling interval to daily
-  setDebug(NONE);                   // NONE = set ezTime to quiet
+#if BUILD_NETWORK
+  return sntpBusy;
+#else
+  return false;
+#endif
 }
 
-void showTime() {
+uint32_t jobHour() {
 //***************************************************************************************************
-//  left aligned on info bar at the top
+//  hours since 1.1.1970 UTC, shifted by WAKE_OFFSET
 //***************************************************************************************************
-  int xpos = 8;  // left margin
-  int ypos = 8;   // top margin
+  return (time(NULL) - WAKE_OFFSET) / 3600;
+}
 
-  tft.setTextColor(COLOR_FG_INFO_BAR, COLOR_BG_INFO_BAR);
-  tft.setTextDatum(TL_DATUM);
-  
-  tft.setTextFont(0);
-  tft.drawString(String(myTZ.dateTime("H:i")), xpos, ypos, GFXFF);  
+void jobHourStart() {
+//***************************************************************************************************
+//  the hours of the timed jobs count from the first valid clock, from then on the hours slept
+//  before the first job are caught up. Not a 0 in lastJobHour, BUILD_MINIMAL starts with hour 0.
+//***************************************************************************************************
+  if(!lastJobHourValid && !clockSyncing() && clockValid()) {
+    lastJobHour = jobHour();
+    lastJobHourValid = true;
+  }
 }
 
-void showSystemNumber() {
+int hoursToNextJob() {
 //***************************************************************************************************
-//  taken from settings, to distinguish more than one plant nanny, used in mqtt messages
+//  hours from the current to the next hour with a due pump, at most SLEEP_MAX_HOURS
 //***************************************************************************************************
-  const int posFromRight = 5;
-  const int radius = 9;
-  
-  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) + radius - LAYOUT_X_POS_ADJUST;
-  int ypos = LAYOUT_INFO_BAR_HEIGHT / 2;
+  int32_t hours = SLEEP_MAX_HOURS;
+  int32_t passed = lastJobHourValid ? jobHour() - lastJobHour : 0;
+  int i;
 
-  tft.fillCircle(xpos, ypos, radius, COLOR_CIRCLE);
-  tft.setTextColor(COLOR_FG_INFO_BAR, COLOR_CIRCLE);
-  tft.setTextDatum(MC_DATUM);
-  
-  tft.setTextFont(0);
-  tft.drawString(String(NANNY_NUMBER), xpos, ypos, GFXFF);  
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    if(wateringFreq[i] != WATERING_FREQ_OFF && nextWatering[i] - passed < hours) {
+      hours = nextWatering[i] - passed;
+    }
+  }
+  return max(hours, (int32_t)1);
 }
 
-void connectAndShowWifiStatus() {
+void scheduleSetFreq(int pump, uint16_t hours) {
 //***************************************************************************************************
-//  stacked to the right of the info bar at the top
+//  every hours, WATERING_FREQ_OFF stops the pump. The next watering comes no later than that, as on
+//  the screen.
 //***************************************************************************************************
-  const int posFromRight = 4;
+  wateringFreq[pump] = hours;
+  savePref(prefWateringFreq[pump], wateringFreq[pump]);
+  if(hours != WATERING_FREQ_OFF && nextWatering[pump] > hours) {
+    scheduleSetNext(pump, hours);
+  }
+}
 
-  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
-  int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
+void scheduleSetNext(int pump, uint16_t hours) {
+//***************************************************************************************************
+//  hours from the last timed job, 0 is the next one
+//***************************************************************************************************
+  nextWatering[pump] = hours;
+  savePref(prefNextWatering[pump], nextWatering[pump]);
+}
 
-  int wifiRetries = 0;
-  uint16_t color;
+void scheduleSetAmount(int pump, uint16_t seconds) {
+//***************************************************************************************************
+//  pump time of each timed watering
+//***************************************************************************************************
+  wateringAmount[pump] = seconds;
+  savePref(prefWateringAmount[pump], wateringAmount[pump]);
+}
 
-  // connecting to WiFi network
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(SECRET_WIFI_SSID, SECRET_WIFI_PASSWORD);
-  while ((WiFi.status() != WL_CONNECTED) && wifiRetries < 8) {
-    delay(800);
-    wifiRetries++;
+void scheduleFromNeed(int pump, int32_t mlPerDay) {
+//***************************************************************************************************
+//  the least frequent preset whose single watering fits into SCHEDULE_MAX_AMOUNT seconds, so the
+//  pump is due in few wakes. Its first watering joins the wakes of a pump with a matching frequency.
+//***************************************************************************************************
+  const uint16_t frequencies[] = {WATERING_FREQ_VERY_SELDOM, WATERING_FREQ_SELDOM,
+                                  WATERING_FREQ_NORMAL, WATERING_FREQ_OFTEN};
+  uint16_t freq = WATERING_FREQ_OFTEN;
+  uint32_t seconds = 0;
+  uint16_t next;
+  int i;
+
+  for(i = 0; i < (int)(sizeof(frequencies) / sizeof(frequencies[0])); i++) {
+    freq = frequencies[i];
+    seconds = (ledgerDurationMs(pumpTank[pump], mlPerDay * freq / 24) + 500) / 1000;
+    if(seconds <= SCHEDULE_MAX_AMOUNT) {
+      break;
+    }
   }
-  if(WiFi.status() == WL_CONNECTED) {
-    wifiConnected = true;
-    color = TFT_GREEN;
-  } else {
-    Serial.println(F("WiFi not connected"));
-    wifiConnected = false;
-    color = TFT_RED;
+  seconds = constrain(seconds, 1, SCHEDULE_MAX_AMOUNT);
+  next = min(nextWatering[pump], freq);
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    if(i != pump && wateringFreq[i] != WATERING_FREQ_OFF &&
+       (freq % wateringFreq[i] == 0 || wateringFreq[i] % freq == 0)) {
+      next = nextWatering[i] % min(freq, wateringFreq[i]);
+      if(next == 0) {
+        next = min(freq, wateringFreq[i]);
+      }
+      break;
+    }
   }
-  
-  tft.drawXBitmap(xpos, ypos, iconWifi, iconWidthSmall, iconHeightSmall, color, COLOR_BG_INFO_BAR);    
+  wateringFreq[pump] = freq;
+  wateringAmount[pump] = seconds;
+  nextWatering[pump] = next;
+  savePref(prefWateringFreq[pump], freq);
+  savePref(prefWateringAmount[pump], seconds);
+  savePref(prefNextWatering[pump], next);
+  LOG_I("Pump %d: %ld ml per day, every %u hours for %lu s, next in %u hours",
+        pump + 1, (long)mlPerDay, freq, (unsigned long)seconds, next);
 }
 
-void connectAndShowMQTTStatus() {
+int forecastHoursToDry(int tank) {
 //***************************************************************************************************
-//  stacked to the right on info bar at the top
+//  hours till the tank is below its dry threshold, the hourly job simulated with the current
+//  schedule and correction. FORECAST_MAX_DAYS * 24 if it doesn't get there, i.e. all its pumps are off.
 //***************************************************************************************************
-  const int posFromRight = 3;
-
-  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
-  int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
-
-  uint16_t color;
+  int32_t simRemainingWater = remainingWater[tank];
+  int32_t simNextWatering[NUMBER_OF_PUMPS];
+  int hours = 0;
+  int i;
 
-  mqttClient.setServer(SECRET_MQTT_BROKER, SECRET_MQTT_PORT);
-  mqttClient.setCallback(mqttCallback);
-  if (mqttClient.connect(mqttClientID, SECRET_MQTT_USER, SECRET_MQTT_PASSWORD)) {
-    mqttConnected = true;
-    color = TFT_GREEN;
-    mqttSubscribeToTopics();
-  } else {
-    Serial.println(F("MQTT not connected"));
-    mqttConnected = false;
-    color = TFT_RED;
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    simNextWatering[i] = nextWatering[i];
+  }
+  while(simRemainingWater > tankRunsDry[tank] && hours < FORECAST_MAX_DAYS * 24) {
+    for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+      if(wateringFreq[i] == WATERING_FREQ_OFF || pumpTank[i] != tank) {
+        continue;
+      }
+      if(simNextWatering[i] > 0) {
+        simNextWatering[i] -= 1;
+      }
+      if(simNextWatering[i] == 0) {
+        simRemainingWater -= ledgerPredict(tank, wateringAmount[i] * 1000UL);
+        simNextWatering[i] = wateringFreq[i];
+      }
+    }
+    hours += 1;
   }
+  return hours;
+}
 
-  tft.drawXBitmap(xpos, ypos, iconMQTT, iconWidthSmall, iconHeightSmall, color, COLOR_BG_INFO_BAR);
+bool tankEmpty(int tank) {
+//***************************************************************************************************
+//  below the dry threshold of the tank
+//***************************************************************************************************
+  return remainingWater[tank] < tankRunsDry[tank];
 }
 
-void showAndPublishBatteryVoltage() {
+uint16_t hourSeconds() {
 //***************************************************************************************************
-//  
+//  seconds since the last full hour plus WAKE_OFFSET, the systems of a fleet don't wake all at once
 //***************************************************************************************************
-  const int posFromRight = 2;
+  return (time(NULL) + 3600 - WAKE_OFFSET) % 3600;
+}
 
-  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
-  int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
+bool pumpJobAdd(int pump, uint32_t ms, uint8_t source) {
+//***************************************************************************************************
+//  queued behind the running job, safe to call from the MQTT callback
+//***************************************************************************************************
+  pumpJob_t* job;
 
-  uint16_t color;
+  if(ms > EVENT_DURATION_MAX_MS) {
+    LOG_W("Pump %d: %lu ms is too long, not queued", pump + 1, (unsigned long)ms);
+    return false;
+  }
+  if(pumpQueueCount >= PUMP_QUEUE_SIZE) {
+    LOG_W("Pump queue full, pump %d not queued", pump + 1);
+    return false;
+  }
+  job = &pumpQueue[(pumpQueueHead + pumpQueueCount) % PUMP_QUEUE_SIZE];
+  job->pump = pump;
+  job->source = source;
+  job->ms = ms;
+  pumpQueueCount++;
+  LOG_D("Pump %d queued for %lu ms", pump + 1, (unsigned long)ms);
+  return true;
+}
+
+bool pumpJobsIdle() {
+//***************************************************************************************************
+//  no pump running and nothing queued
+//***************************************************************************************************
+  return !pumpRunning && pumpQueueCount == 0;
+}
+
+void pumpJobLoop() {
+//***************************************************************************************************
+//  called from loop(), switches the pump of the oldest job on, pumpOffTimer switches it off again
+//  even if loop() is held up by the network. Never waits.
+//***************************************************************************************************
+  pumpJob_t* job = &pumpQueue[pumpQueueHead];
+
+  if(pumpRunning) {
+    if(pumpTimedOut || millis() - pumpSwitchedAt >= job->ms) {
+      pumpJobStop();
+    }
+    return;
+  }
+  if(pumpQueueCount == 0 || millis() - pumpSwitchedAt < PUMP_PAUSE_MS) {
+    return;
+  }
+  if(tankEmpty(pumpTank[job->pump])) {
+    LOG_W("Water tank %d empty, pump %d not started", pumpTank[job->pump] + 1, job->pump + 1);
+    metricsCount(METRIC_TANK_EMPTY);
+    pumpQueueHead = (pumpQueueHead + 1) % PUMP_QUEUE_SIZE;
+    pumpQueueCount--;
+    return;
+  }
+  pumpTimedOut = false;
+  setPump(job->pump, true);
+  pumpSwitchedAt = millis();
+  pumpRunning = true;
+  esp_timer_start_once(pumpOffTimer, (uint64_t)job->ms * 1000);
+}
+
+void pumpJobStop() {
+//***************************************************************************************************
+//  switches the running pump off, books the real on-time and publishes the completion:
+//  pump,requested ms,on ms,remaining water of its tank,source
+//***************************************************************************************************
+  pumpJob_t* job = &pumpQueue[pumpQueueHead];
+  int tank = pumpTank[job->pump];
+  uint32_t onMs;
+  event_t event;
+#if BUILD_NETWORK
+  char temp[48];
+#endif
+
+  esp_timer_stop(pumpOffTimer);
+  setPump(job->pump, false);
+  onMs = (pumpTimedOut ? pumpTimedOutAt : millis()) - pumpSwitchedAt;
+  pumpSwitchedAt = millis();
+  pumpRunning = false;
+  pumpTimedOut = false;
+  metricsAddPumpTime(job->pump, onMs);
+  // log pump run
+  memset(&event, 0, sizeof(event));
+  event.time = time(NULL) - onMs / 1000;
+  event.type = EVENT_WATERING;
+  event.pump = job->pump;
+  event.tank = tank;
+  eventSetDuration(&event, onMs);
+  event.ml = ledgerPredict(tank, onMs);
+  event.batteryMv = batteryMilliVolts;
+  eventLogAppend(&event);
+  // adjust waterRemaining
+  ledgerConsume(tank, onMs);
+
+#if BUILD_NETWORK
+  temp[0] = '\0';
+  fmtAppendInt(temp, sizeof(temp), job->pump + 1);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppendInt(temp, sizeof(temp), job->ms);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppendInt(temp, sizeof(temp), onMs);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppendInt(temp, sizeof(temp), remainingWater[tank]);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppend(temp, sizeof(temp), job->source == jobSourceRemote ? "remote" : "timed");
+  mqttPublishValue(mqttTopicWaterDone, temp);
+#endif
+  LOG_I("Pump %d done after %lu ms", job->pump + 1, (unsigned long)onMs);
+
+  pumpQueueHead = (pumpQueueHead + 1) % PUMP_QUEUE_SIZE;
+  pumpQueueCount--;
+  if(pumpQueueCount == 0) {
+    showAndPublishWaterLevel();
+  }
+}
+
+uint32_t ledgerDurationMs(int tank, int32_t ml) {
+//***************************************************************************************************
+//  pump time for the given amount, the inverse of ledgerPredict()
+//***************************************************************************************************
+  return (int64_t)ml * 1000 * LEDGER_CORRECTION_NONE / ((int32_t)pumpThroughput * waterCorrection[tank]);
+}
+
+#if BUILD_DISPLAY
+void showScreen() {
+//***************************************************************************************************
+//  show graphics and texts for each screen
+//***************************************************************************************************
+  int xpos = 10;  // left margin
+  int ypos = (LAYOUT_LANDSCAPE_HEIGHT - LAYOUT_BUTTON_WIDTH - LAYOUT_STATUS_BAR_HEIGHT) / 2 ;  // top margin
+  char temp[30];  // for string concatination
+  int simDays;
+  int tank;
+
+  clearMainArea();
+  clearTopBtn();
+  clearBottomBtn();
+  switch(currentScreen) {
+    case scrMain:
+      // draw main area
+      tft.setTextColor(COLOR_FG_MAIN_AREA, COLOR_BG_MAIN_AREA);
+      tft.setTextDatum(TL_DATUM);
+      tft.setFreeFont(FSS9);
+      tft.drawString(TEXT_REMAINING, xpos, ypos, GFXFF);
+      // the tank that runs dry first
+      simDays = FORECAST_MAX_DAYS;
+      for(tank = 0; tank < NUMBER_OF_TANKS; tank++) {
+        simDays = min(simDays, forecastHoursToDry(tank) / 24);
+      }
+      temp[0] = '\0';
+      fmtAppendInt(temp, sizeof(temp), simDays);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      if(simDays > 1) {
+        fmtAppend(temp, sizeof(temp), TEXT_DAYS);
+      } else {
+        fmtAppend(temp, sizeof(temp), TEXT_DAY);
+      }
+      tft.drawString(temp, xpos, ypos + 20, GFXFF);
+      break;
+    default:
+      uiInvalidate();
+      showScreenWidgets();
+      break;
+  }
+  showTopButton();
+  showBottomButton();
+}
+
+void showScreenWidgets() {
+//***************************************************************************************************
+//  rows of the screens besides the main one, uiWidget() draws only those that changed
+//***************************************************************************************************
+  char temp[UI_TEXT_LENGTH];
+  int i;
+
+  uiRefreshedAt = millis();
+  switch(currentScreen) {
+    case scrPumps:
+      uiWidget(tft, 0, TEXT_UI_PUMPS, false);
+      for(i = 0; i < NUMBER_OF_PUMPS && i + 1 < UI_WIDGETS; i++) {
+        // P1: 2 s / 24 h, 5 h
+        temp[0] = '\0';
+        fmtAppendChar(temp, sizeof(temp), 'P');
+        fmtAppendInt(temp, sizeof(temp), i + 1);
+        fmtAppend(temp, sizeof(temp), ": ");
+        if(wateringFreq[i] == WATERING_FREQ_OFF) {
+          fmtAppend(temp, sizeof(temp), TEXT_UI_OFF);
+        } else {
+          fmtAppendUnit(temp, sizeof(temp), wateringAmount[i], 0, "s / ");
+          fmtAppendUnit(temp, sizeof(temp), wateringFreq[i], 0, "h, ");
+          fmtAppendUnit(temp, sizeof(temp), nextWatering[i], 0, "h");
+        }
+        uiWidget(tft, i + 1, temp, i == uiPump);
+      }
+      break;
+    case scrPump:
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_PUMP);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendInt(temp, sizeof(temp), uiPump + 1);
+      uiWidget(tft, 0, temp, uiField == 0);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_INTERVAL);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      if(wateringFreq[uiPump] == WATERING_FREQ_OFF) {
+        fmtAppend(temp, sizeof(temp), TEXT_UI_OFF);
+      } else {
+        fmtAppendUnit(temp, sizeof(temp), wateringFreq[uiPump], 0, "h");
+      }
+      uiWidget(tft, 1, temp, uiField == 1);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_AMOUNT);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), wateringAmount[uiPump], 0, "s");
+      uiWidget(tft, 2, temp, uiField == 2);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_NEXT);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), nextWatering[uiPump], 0, "h");
+      uiWidget(tft, 3, temp, uiField == 3);
+      break;
+    case scrTank:
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_TANK);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendInt(temp, sizeof(temp), uiTank + 1);
+      uiWidget(tft, 0, temp, uiField == 0);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_SIZE);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), containerSize[uiTank], 0, "ml");
+      uiWidget(tft, 1, temp, uiField == 1);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_WATER);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), remainingWater[uiTank], 0, "ml");
+      uiWidget(tft, 2, temp, false);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_CORRECTION);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), waterCorrection[uiTank], 1, "%");
+      uiWidget(tft, 3, temp, false);
+      temp[0] = '\0';
+      fmtAppendInt(temp, sizeof(temp), forecastHoursToDry(uiTank) / 24);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppend(temp, sizeof(temp), TEXT_DAYS);
+      uiWidget(tft, 4, temp, false);
+      break;
+    case scrDiag:
+      uiWidget(tft, 0, TEXT_UI_DIAG, false);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_VERSION);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppend(temp, sizeof(temp), VERSION);
+      uiWidget(tft, 1, temp, false);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_BATTERY);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), batteryMilliVolts, 3, "V");
+      uiWidget(tft, 2, temp, false);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), "WiFi ");
+      if(wifiConnected) {
+        fmtAppendUnit(temp, sizeof(temp), WiFi.RSSI(), 0, "dBm");
+      } else {
+        fmtAppendChar(temp, sizeof(temp), '-');
+      }
+      uiWidget(tft, 3, temp, false);
+      temp[0] = '\0';
+      fmtAppend(temp, sizeof(temp), TEXT_UI_AWAKE);
+      fmtAppendChar(temp, sizeof(temp), ' ');
+      fmtAppendUnit(temp, sizeof(temp), millis() / 1000, 0, "s");
+      uiWidget(tft, 4, temp, false);
+      break;
+  }
+}
+
+void showTopButton() {
+//***************************************************************************************************
+//  refill icon on the main screen, the others only show where the top button leads
+//***************************************************************************************************
+  if(currentScreen == scrMain) {
+    showButtonIcon(TOP_BUTTON, iconRefill, TFT_SKYBLUE);
+  } else {
+    showButtonLabel(TOP_BUTTON, TEXT_BUTTON_NEXT);
+  }
+}
+
+void showBottomButton() {
+//***************************************************************************************************
+//  refill amount on the main screen, "+" where the bottom button changes something
+//***************************************************************************************************
+  if(currentScreen == scrMain) {
+    showRefillSelection();
+  } else if(currentScreen != scrDiag) {
+    showButtonLabel(BOTTOM_BUTTON, TEXT_BUTTON_CHANGE);
+  }
+}
+
+void showButtonLabel(int button, const char* label) {
+//***************************************************************************************************
+//  centered on the button
+//***************************************************************************************************
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - (LAYOUT_BUTTON_WIDTH / 2);
+
+  tft.setTextDatum(MC_DATUM);
+  tft.setFreeFont(FSS12);
+  if(button == TOP_BUTTON) {
+    tft.setTextColor(COLOR_FG_INFO_BAR, btnTFlashAt ? COLOR_BG_TOP_BTN_PRESS : COLOR_BG_TOP_BTN);
+    tft.drawString(label, xpos, LAYOUT_LANDSCAPE_HEIGHT / 4, GFXFF);
+  } else {
+    tft.setTextColor(COLOR_FG_INFO_BAR, btnBFlashAt ? COLOR_BG_BOTTOM_BTN_PRESS : COLOR_BG_BOTTOM_BTN);
+    tft.drawString(label, xpos, LAYOUT_LANDSCAPE_HEIGHT - (LAYOUT_LANDSCAPE_HEIGHT / 4), GFXFF);
+  }
+}
+
+void uiNextField() {
+//***************************************************************************************************
+//  long press of the top button on scrPump and scrTank
+//***************************************************************************************************
+  if(currentScreen == scrPump) {
+    uiField = (uiField + 1) % 4;
+  } else if(currentScreen == scrTank) {
+    uiField = (uiField + 1) % 2;
+  }
+  showScreenWidgets();
+}
+
+void uiChange() {
+//***************************************************************************************************
+//  bottom button, next value of the selected row. Changes are live at once and saved before sleep
+//***************************************************************************************************
+  const int freqChoices = sizeof(uiFreqChoices) / sizeof(uiFreqChoices[0]);
+  const int containerChoices = sizeof(uiContainerChoices) / sizeof(uiContainerChoices[0]);
+  int i;
+
+  switch(currentScreen) {
+    case scrMain:
+      refillSelection = (refillSelection + 1) % (NUMBER_OF_TANKS * REFILL_CHOICES);
+      showRefillSelection();
+      return;
+    case scrPumps:
+      uiPump = (uiPump + 1) % NUMBER_OF_PUMPS;
+      break;
+    case scrPump:
+      if(uiField == 0) {
+        uiPump = (uiPump + 1) % NUMBER_OF_PUMPS;
+        break;
+      }
+      if(uiField == 1) {
+        for(i = 0; i < freqChoices && uiFreqChoices[i] != wateringFreq[uiPump]; i++);
+        wateringFreq[uiPump] = uiFreqChoices[(i + 1) % freqChoices];
+        if(wateringFreq[uiPump] != WATERING_FREQ_OFF && nextWatering[uiPump] > wateringFreq[uiPump]) {
+          nextWatering[uiPump] = wateringFreq[uiPump];
+        }
+      } else if(uiField == 2) {
+        wateringAmount[uiPump] = wateringAmount[uiPump] % SCHEDULE_MAX_AMOUNT + 1;
+      } else {
+        nextWatering[uiPump] = nextWatering[uiPump] % max((int)wateringFreq[uiPump], 1) + 1;
+      }
+      uiPumpEdited[uiPump] = true;
+      break;
+    case scrTank:
+      if(uiField == 0) {
+        uiTank = (uiTank + 1) % NUMBER_OF_TANKS;
+        break;
+      }
+      for(i = 0; i < containerChoices && uiContainerChoices[i] != containerSize[uiTank]; i++);
+      containerSize[uiTank] = uiContainerChoices[(i + 1) % containerChoices];
+      uiTankEdited[uiTank] = true;
+      if(uiTank == 0) {
+        showContainerSize();
+      }
+      break;
+    default:
+      return;
+  }
+  showScreenWidgets();
+}
+
+void uiResponse() {
+//***************************************************************************************************
+//  the screen shows the result of the last button event
+//***************************************************************************************************
+  metricsObserve(HISTOGRAM_UI_RESPONSE_MS, millis() - btnEventAt);
+}
+
+void uiLoop() {
+//***************************************************************************************************
+//  ends the flash of a pressed button and refreshes the rows of the screen
+//***************************************************************************************************
+  if(btnTFlashAt != 0 && millis() - btnTFlashAt > UI_FLASH_MS) {
+    btnTFlashAt = 0;
+    clearTopBtn();
+    showTopButton();
+  }
+  if(btnBFlashAt != 0 && millis() - btnBFlashAt > UI_FLASH_MS) {
+    btnBFlashAt = 0;
+    clearBottomBtn();
+    showBottomButton();
+  }
+  if(currentScreen != scrMain && millis() - uiRefreshedAt > UI_REFRESH_MS) {
+    showScreenWidgets();
+  }
+}
+
+void uiSaveEdits() {
+//***************************************************************************************************
+//  once before sleep, each edited pump and tank
+//***************************************************************************************************
+  int i;
+
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    if(uiPumpEdited[i]) {
+      uiPumpEdited[i] = false;
+      savePref(prefWateringFreq[i], wateringFreq[i]);
+      savePref(prefWateringAmount[i], wateringAmount[i]);
+      savePref(prefNextWatering[i], nextWatering[i]);
+      LOG_I("Screen edit: pump %d, every %u h, %u s, next in %u h",
+            i + 1, wateringFreq[i], wateringAmount[i], nextWatering[i]);
+    }
+  }
+  for(i = 0; i < NUMBER_OF_TANKS; i++) {
+    if(uiTankEdited[i]) {
+      uiTankEdited[i] = false;
+      saveTankPref(PREF_CONTAINER_SIZE, i, containerSize[i]);
+      LOG_I("Screen edit: tank %d, container %u ml", i + 1, containerSize[i]);
+    }
+  }
+}
+
+void showButtonIcon(int button, const uint8_t* icon, uint16_t fgcolor) {
+//***************************************************************************************************
+//  
+//***************************************************************************************************
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH + ((LAYOUT_BUTTON_WIDTH - iconWidthBig) / 2);
+  int ypos;
+  uint16_t bgcolor;
+
+  switch(button) {
+    case TOP_BUTTON:
+      ypos = ((LAYOUT_LANDSCAPE_HEIGHT / 2) - iconHeightBig) / 2;
+      if(btnTFlashAt) {
+        bgcolor = COLOR_BG_TOP_BTN_PRESS;
+      } else {
+        bgcolor = COLOR_BG_TOP_BTN;
+      }
+      break;
+    case BOTTOM_BUTTON:
+      ypos = (((LAYOUT_LANDSCAPE_HEIGHT / 2) - iconHeightBig) / 2) + (LAYOUT_LANDSCAPE_HEIGHT / 2);
+      if(btnBFlashAt) {
+        bgcolor = COLOR_BG_BOTTOM_BTN_PRESS;
+      } else {
+        bgcolor = COLOR_BG_BOTTOM_BTN;
+      }
+      break;
+  }
+  iconDraw(tft, xpos, ypos, icon, iconWidthBig, iconHeightBig, fgcolor, bgcolor);    
+}
+
+void showBtnTClicked() {
+//***************************************************************************************************
+//  pressed color at once, uiLoop() ends the flash after UI_FLASH_MS without blocking
+//***************************************************************************************************
+  btnTFlashAt = millis() | 1;
+  clearTopBtn();
+  showTopButton();
+}
+
+void showBtnBClicked() {
+//***************************************************************************************************
+//  pressed color at once, uiLoop() ends the flash after UI_FLASH_MS without blocking
+//***************************************************************************************************
+  btnBFlashAt = millis() | 1;
+  clearBottomBtn();
+  showBottomButton();
+}
+
+void showRefillSelection() {
+//***************************************************************************************************
+//  refill amount for the next long press of the top button, centered on the bottom button,
+//  with more than one tank preceded by the tank number
+//***************************************************************************************************
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - (LAYOUT_BUTTON_WIDTH / 2);
+  int ypos = LAYOUT_LANDSCAPE_HEIGHT - (LAYOUT_LANDSCAPE_HEIGHT / 4);
+  char temp[8];
 
+  temp[0] = '\0';
+  if(NUMBER_OF_TANKS > 1) {
+    fmtAppendInt(temp, sizeof(temp), refillSelection / REFILL_CHOICES + 1);
+    fmtAppendChar(temp, sizeof(temp), ':');
+  }
+  fmtAppendInt(temp, sizeof(temp), refillPercentages[refillSelection % REFILL_CHOICES]);
+  fmtAppendChar(temp, sizeof(temp), '%');
+  tft.setTextColor(COLOR_FG_INFO_BAR, btnBFlashAt ? COLOR_BG_BOTTOM_BTN_PRESS : COLOR_BG_BOTTOM_BTN);
+  tft.setTextDatum(MC_DATUM);
+  tft.setFreeFont(FSS9);
+  tft.drawString(temp, xpos, ypos, GFXFF);
+}
+
+void localRefill() {
+//***************************************************************************************************
+//  tank refilled on site with the selected amount, no network needed
+//***************************************************************************************************
+  int tank = refillSelection / REFILL_CHOICES;
+  uint8_t percent = refillPercentages[refillSelection % REFILL_CHOICES];
+
+  if(percent >= 100) {
+    ledgerRefill(tank, 0);      // poured amount unknown, no reconciliation
+  } else {
+    ledgerAdd(tank, (int32_t)containerSize[tank] * percent / 100);
+  }
+  LOG_I("Local refill: tank %d, %u%%, remaining water %d ml", tank + 1, percent, remainingWater[tank]);
+  refillSelection = 0;
+  showAndPublishWaterLevel();
+  showScreen();
+}
+#endif
+
+#if BUILD_NETWORK
+void getNetworkTime() {
+//***************************************************************************************************
+//  starts the SNTP sync, needs wifi connection. The clock is set in loop() with the first reply,
+//  only without any time from the RTC it waits here, at most SNTP_TIMEOUT_MS
+//***************************************************************************************************
+  if(!sntpBegin()) {
+    LOG_W("SNTP: no request sent");
+    return;
+  }
+  if(!sntpTimeValid()) {
+    while(sntpPoll()) {
+      delay(10);
+    }
+  }
+}
+#endif
+
+#if BUILD_DISPLAY
+void showTime() {
+//***************************************************************************************************
+//  left aligned on info bar at the top
+//***************************************************************************************************
+  int xpos = 8;  // left margin
+  int ypos = 8;   // top margin
+  char temp[6];   // hh:mm
+  time_t now = time(NULL);
+  struct tm local;
+
+  localtime_r(&now, &local);
+  shownMinute = now / 60;
+
+  tft.setTextColor(COLOR_FG_INFO_BAR, COLOR_BG_INFO_BAR);
+  tft.setTextDatum(TL_DATUM);
+  
+  tft.setTextFont(0);
+  temp[0] = '\0';
+  fmtAppendPadded(temp, sizeof(temp), local.tm_hour, 2);
+  fmtAppendChar(temp, sizeof(temp), ':');
+  fmtAppendPadded(temp, sizeof(temp), local.tm_min, 2);
+  tft.drawString(temp, xpos, ypos, GFXFF);  
+}
+
+void showSystemNumber() {
+//***************************************************************************************************
+//  taken from settings, to distinguish more than one plant nanny, used in mqtt messages
+//***************************************************************************************************
+  const int posFromRight = 5;
+  const int radius = 9;
+  
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) + radius - LAYOUT_X_POS_ADJUST;
+  int ypos = LAYOUT_INFO_BAR_HEIGHT / 2;
+  const char temp[2] = {NANNY_NUMBER, '\0'};
+
+  tft.fillCircle(xpos, ypos, radius, COLOR_CIRCLE);
+  tft.setTextColor(COLOR_FG_INFO_BAR, COLOR_CIRCLE);
+  tft.setTextDatum(MC_DATUM);
+  
+  tft.setTextFont(0);
+  tft.drawString(temp, xpos, ypos, GFXFF);  
+}
+#endif
+
+#if BUILD_NETWORK
+void connectAndShowWifiStatus() {
+//***************************************************************************************************
+//  stacked to the right of the info bar at the top
+//***************************************************************************************************
+#if BUILD_DISPLAY
+  const int posFromRight = 4;
+
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
+  int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
+#endif
+
+  int wifiRetries = 0;
+  unsigned long startTime = millis();
+
+  // connecting to WiFi network
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(SECRET_WIFI_SSID, SECRET_WIFI_PASSWORD);
+  while ((WiFi.status() != WL_CONNECTED) && wifiRetries < 8) {
+    delay(800);
+    wifiRetries++;
+  }
+  if(WiFi.status() == WL_CONNECTED) {
+    metricsObserve(HISTOGRAM_WIFI_CONNECT_MS, millis() - startTime);
+    wifiConnected = true;
+  } else {
+    LOG_E("WiFi not connected");
+    metricsCount(METRIC_WIFI_FAILURES);
+    wifiConnected = false;
+  }
+  
+#if BUILD_DISPLAY
+  iconDraw(tft, xpos, ypos, iconWifi, iconWidthSmall, iconHeightSmall, wifiConnected ? TFT_GREEN : TFT_RED,
+           COLOR_BG_INFO_BAR);
+#endif
+}
+
+void connectAndShowMQTTStatus() {
+//***************************************************************************************************
+//  stacked to the right on info bar at the top
+//***************************************************************************************************
+#if BUILD_DISPLAY
+  const int posFromRight = 3;
+
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
+  int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
+#endif
+
+  unsigned long startTime = millis();
+
+#if MQTT_TLS
+  mqttTlsClient.setCACert(SECRET_MQTT_CA_CERT);
+  mqttTlsClient.setHandshakeTimeout(MQTT_TLS_TIMEOUT_S);
+#endif
+  mqttClient.setServer(SECRET_MQTT_BROKER, SECRET_MQTT_PORT);
+  mqttClient.setCallback(mqttCallback);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+  if (mqttConnect()) {
+    metricsObserve(HISTOGRAM_MQTT_CONNECT_MS, millis() - startTime);
+    mqttConnected = true;
+    // on every connect, a broker restarted without persistence has lost the session and
+    // PubSubClient doesn't tell whether the session was present
+    mqttSubscribeToTopics();
+  } else {
+    LOG_E("MQTT not connected");
+    mqttConnected = false;
+  }
+
+#if BUILD_DISPLAY
+  iconDraw(tft, xpos, ypos, iconMQTT, iconWidthSmall, iconHeightSmall, mqttConnected ? TFT_GREEN : TFT_RED,
+           COLOR_BG_INFO_BAR);
+#endif
+}
+#endif
+
+void readBatteryVoltage() {
+//***************************************************************************************************
+//  early in setup, the status frame needs it before MQTT
+//***************************************************************************************************
   esp_adc_cal_characteristics_t adc_chars;
   esp_adc_cal_value_t val_type = esp_adc_cal_characterize((adc_unit_t)ADC_UNIT_1, 
                                                           (adc_atten_t)ADC1_CHANNEL_6, 
@@ -646,67 +1611,234 @@ void showAndPublishBatteryVoltage() {
                                                           &adc_chars);
 
   uint16_t v = analogRead(ADC_PIN);
-  float batteryVoltage = ((float)v / 4095.0) * 2.0 * 3.3 * (ADC_VREF / 1100.0);
+  // same as (v / 4095) * 2 * 3.3V * (ADC_VREF / 1100) but in milli volt and without float
+  batteryMilliVolts = ((int32_t)v * 2 * 3300 / 4095) * ADC_VREF / 1100;
+
+  metricsSet(GAUGE_BATTERY_MV, batteryMilliVolts);
+}
+
+#if BUILD_NETWORK
+void showAndPublishBatteryVoltage() {
+//***************************************************************************************************
+//  
+//***************************************************************************************************
+  char temp[8];
+#if BUILD_DISPLAY
+  const int posFromRight = 2;
 
-  if(batteryVoltage < BATTERY_VERY_LOW) {
+  int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
+  int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
+
+  uint16_t color;
+
+  if(batteryMilliVolts < BATTERY_VERY_LOW * 1000) {
     color = TFT_RED;
-  } else if(batteryVoltage < BATTERY_LOW) {
+  } else if(batteryMilliVolts < BATTERY_LOW * 1000) {
     color = TFT_YELLOW;
   } else {
     color = TFT_GREEN;
   }
   
-  tft.drawXBitmap(xpos, ypos, iconBattery, iconWidthSmall, iconHeightSmall, color, COLOR_BG_INFO_BAR);
+  iconDraw(tft, xpos, ypos, iconBattery, iconWidthSmall, iconHeightSmall, color, COLOR_BG_INFO_BAR);
+#endif
 
-  mqttPublishValue(mqttTopicBatVoltage, String(batteryVoltage));
+  // two decimals like before
+  temp[0] = '\0';
+  fmtAppendFixed(temp, sizeof(temp), batteryMilliVolts / 10, 2);
+  mqttPublishValue(mqttTopicBatVoltage, temp);
 }
+#endif
 
 void showAndPublishWaterLevel() {
 //***************************************************************************************************
-//  
+//  the icon shows the emptiest tank, every tank publishes its level, correction and forecast
 //***************************************************************************************************
+  int tank;
+#if BUILD_NETWORK
+  char temp[8];
+  char subTopic[MQTT_TOPIC_LENGTH];
+#endif
+#if BUILD_DISPLAY
   const int posFromRight = 1;
 
   int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
   int ypos = (LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2;
 
   uint16_t color;
+  int32_t fill = 1000;
 
-  int percent;
-
-  percent = containerSize / remainingWater * 100;
-  if(percent < 10) {
+  for(tank = 0; tank < NUMBER_OF_TANKS; tank++) {
+    fill = min(fill, ledgerFillPerMille(tank));
+  }
+  if(fill < 100) {
     color = TFT_RED;
-  } else if(percent < 30) {
+  } else if(fill < 300) {
     color = TFT_YELLOW;
   } else {
     color = TFT_GREEN;
   }
-  tft.drawXBitmap(xpos, ypos, iconContainer, iconWidthSmall, iconHeightSmall, color, COLOR_BG_INFO_BAR);
-  
-  mqttPublishValue(mqttTopicWaterLevel, String(remainingWater));
+  iconDraw(tft, xpos, ypos, iconContainer, iconWidthSmall, iconHeightSmall, color, COLOR_BG_INFO_BAR);
+#endif
+
+  metricsSet(GAUGE_REMAINING_WATER, remainingWater[0]);
+  metricsSet(GAUGE_WATER_CORRECTION, waterCorrection[0]);
+  for(tank = 0; tank < NUMBER_OF_TANKS; tank++) {
+#if BUILD_NETWORK
+    temp[0] = '\0';
+    fmtAppendInt(temp, sizeof(temp), remainingWater[tank]);
+    tankTopic(subTopic, sizeof(subTopic), mqttTopicWaterLevel, tank);
+    mqttPublishValue(subTopic, temp);
+    temp[0] = '\0';
+    fmtAppendFixed(temp, sizeof(temp), waterCorrection[tank], 3);
+    tankTopic(subTopic, sizeof(subTopic), mqttTopicCorrection, tank);
+    mqttPublishValue(subTopic, temp);
+    publishForecast(tank);
+#endif
+
+    saveTankPref(PREF_REMAINING_WATER, tank, remainingWater[tank]);
+  }
+}
 
-  prefs.begin("nanny", false);
-  prefs.putUInt(PREF_REMAINING_WATER, remainingWater);
-  prefs.end();  
+void tankTopic(char* subTopic, size_t size, const char* name, int tank) {
+//***************************************************************************************************
+//  the first tank uses the plain topics as before, the others are prefixed, i.e. "tank2/water-level"
+//***************************************************************************************************
+  subTopic[0] = '\0';
+  if(tank > 0) {
+    fmtAppend(subTopic, size, "tank");
+    fmtAppendInt(subTopic, size, tank + 1);
+    fmtAppendChar(subTopic, size, '/');
+  }
+  fmtAppend(subTopic, size, name);
+}
+
+int32_t ledgerPredict(int tank, uint32_t ms) {
+//***************************************************************************************************
+//  milli liter a pump delivers in the given time, corrected by what the refills of its tank have shown
+//***************************************************************************************************
+  return (int64_t)ms * pumpThroughput * waterCorrection[tank] / (1000 * LEDGER_CORRECTION_NONE);
+}
+
+void ledgerConsume(int tank, uint32_t ms) {
+//***************************************************************************************************
+//  after each pump run
+//***************************************************************************************************
+  remainingWater[tank] -= ledgerPredict(tank, ms);
+  consumedSinceRefill[tank] += (int64_t)ms * pumpThroughput / 1000;
+  saveTankPref(PREF_CONSUMED_SINCE_REFILL, tank, consumedSinceRefill[tank]);
+}
+
+void ledgerRefill(int tank, int32_t pouredMl) {
+//***************************************************************************************************
+//  the tank was filled up to containerSize with pouredMl. That is what really left the tank since
+//  the last refill, compared to the pump time based prediction it gives the correction factor for
+//  evaporation, leaks and pump wear. Smoothed over refills, small refills are not reconciled.
+//***************************************************************************************************
+  int32_t ratio;
+  event_t event;
+
+  if(pouredMl > 0 && consumedSinceRefill[tank] >= LEDGER_MIN_CONSUMPTION) {
+    ratio = (pouredMl + refilledSinceRefill[tank]) * LEDGER_CORRECTION_NONE / consumedSinceRefill[tank];
+    ratio = constrain(ratio, LEDGER_CORRECTION_MIN, LEDGER_CORRECTION_MAX);
+    waterCorrection[tank] = (3 * (int32_t)waterCorrection[tank] + ratio) / 4;
+    saveTankPref(PREF_WATER_CORRECTION, tank, waterCorrection[tank]);
+    LOG_I("Water ledger: tank %d, refill %ld ml, predicted %ld ml, correction %u", tank + 1,
+          (long)pouredMl, (long)consumedSinceRefill[tank], waterCorrection[tank]);
+  }
+  consumedSinceRefill[tank] = 0;
+  saveTankPref(PREF_CONSUMED_SINCE_REFILL, tank, consumedSinceRefill[tank]);
+  refilledSinceRefill[tank] = 0;
+  saveTankPref(PREF_REFILLED_SINCE_REFILL, tank, refilledSinceRefill[tank]);
+  remainingWater[tank] = containerSize[tank];
+  saveTankPref(PREF_REMAINING_WATER, tank, remainingWater[tank]);
+
+  memset(&event, 0, sizeof(event));
+  event.time = time(NULL);
+  event.type = EVENT_REFILL;
+  event.pump = EVENT_NO_PUMP;
+  event.tank = tank;
+  event.ml = constrain(pouredMl, 0, UINT16_MAX);
+  event.batteryMv = batteryMilliVolts;
+  eventLogAppend(&event);
 }
 
+void ledgerAdd(int tank, int32_t addedMl) {
+//***************************************************************************************************
+//  partial refill, counted as consumption in the reconciliation of the next full refill
+//***************************************************************************************************
+  event_t event;
+
+  // only what went into the tank, the rest overflowed
+  addedMl = min(addedMl, (int32_t)containerSize[tank] - max((int32_t)remainingWater[tank], (int32_t)0));
+  remainingWater[tank] = constrain(remainingWater[tank] + addedMl, 0, (int32_t)containerSize[tank]);
+  saveTankPref(PREF_REMAINING_WATER, tank, remainingWater[tank]);
+  refilledSinceRefill[tank] += addedMl;
+  saveTankPref(PREF_REFILLED_SINCE_REFILL, tank, refilledSinceRefill[tank]);
+
+  memset(&event, 0, sizeof(event));
+  event.time = time(NULL);
+  event.type = EVENT_REFILL;
+  event.pump = EVENT_NO_PUMP;
+  event.tank = tank;
+  event.ml = constrain(addedMl, 0, UINT16_MAX);
+  event.batteryMv = batteryMilliVolts;
+  eventLogAppend(&event);
+}
+
+void ledgerSetLevel(int tank, int32_t ml) {
+//***************************************************************************************************
+//  the level was measured. A full tank without known amount starts a new ledger period without
+//  reconciliation.
+//***************************************************************************************************
+  remainingWater[tank] = constrain(ml, 0, (int32_t)containerSize[tank]);
+  saveTankPref(PREF_REMAINING_WATER, tank, remainingWater[tank]);
+  if(ml >= containerSize[tank]) {
+    consumedSinceRefill[tank] = 0;
+    saveTankPref(PREF_CONSUMED_SINCE_REFILL, tank, consumedSinceRefill[tank]);
+    refilledSinceRefill[tank] = 0;
+    saveTankPref(PREF_REFILLED_SINCE_REFILL, tank, refilledSinceRefill[tank]);
+  }
+}
+
+void ledgerSetContainer(int tank, uint16_t ml) {
+//***************************************************************************************************
+//  another container, the water left can't be more than it holds
+//***************************************************************************************************
+  containerSize[tank] = ml;
+  saveTankPref(PREF_CONTAINER_SIZE, tank, containerSize[tank]);
+  if(remainingWater[tank] > containerSize[tank]) {
+    remainingWater[tank] = containerSize[tank];
+    saveTankPref(PREF_REMAINING_WATER, tank, remainingWater[tank]);
+  }
+}
+
+int32_t ledgerFillPerMille(int tank) {
+//***************************************************************************************************
+//  0 .. 1000
+//***************************************************************************************************
+  if(containerSize[tank] == 0 || remainingWater[tank] <= 0) {
+    return 0;
+  }
+  return constrain((int32_t)remainingWater[tank] * 1000 / containerSize[tank], 0, 1000);
+}
+
+#if BUILD_DISPLAY
 void showContainerSize() {
 //***************************************************************************************************
-//  
+//  of the first tank
 //***************************************************************************************************
   const int posFromRight = 0;
 
   int xpos = LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - (posFromRight * LAYOUT_INFO_BAR_HEIGHT) - LAYOUT_X_POS_ADJUST;
   int ypos = ((LAYOUT_INFO_BAR_HEIGHT - iconHeightSmall) / 2) + 8;
 
-  String containerChar;
+  const char* containerChar;
 
-  if(containerSize == CONTAINER_SIZE_SMALL){
+  if(containerSize[0] == CONTAINER_SIZE_SMALL){
     containerChar = "S";
-  } else if (containerSize == CONTAINER_SIZE_TALL){
+  } else if (containerSize[0] == CONTAINER_SIZE_TALL){
     containerChar ="T";
-  } else if (containerSize == CONTAINER_SIZE_FLAT){
+  } else if (containerSize[0] == CONTAINER_SIZE_FLAT){
     containerChar ="F";
   } else {
     containerChar ="B";
@@ -716,230 +1848,616 @@ void showContainerSize() {
   tft.setTextFont(0);
   tft.drawString(containerChar, xpos, ypos, FONT2);  
 }
+#endif
 
+#if BUILD_NETWORK
 void mqttSubscribeToTopics() {
 //***************************************************************************************************
-//  to avoid feedback loops we subscribe to command messages and send status messages
+//  to avoid feedback loops we subscribe to command messages and send status messages. QoS 1 and
+//  the persistent session let the broker keep commands sent while the system sleeps.
 //***************************************************************************************************
-  String baseCommand;
-  String temp1;
-  String temp2;
-
-  baseCommand.concat(mqttMainTopic);
-  baseCommand.concat("/");
-  baseCommand.concat(NANNY_NUMBER);
-  baseCommand.concat("/");
+  const char* pumpCommands[] = {mqttCmndFreq, mqttCmndNext, mqttCmndAmount, mqttCmndWaterNow,
+                                mqttCmndNeed};
+  const char* tankCommands[] = {mqttCmndContainer, mqttCmndWater, mqttCmndRefill};
+  char topic[MQTT_TOPIC_LENGTH];
+  char pumpCommand[MQTT_TOPIC_LENGTH];
+  int i;
+  int j;
 
-  temp1 = baseCommand;
-  temp1.concat(mqttCmndContainer);
-  mqttClient.subscribe(temp1.c_str());
-  temp1 = baseCommand;
-  temp1.concat(mqttCmndWater);
-  mqttClient.subscribe(temp1.c_str());
+  for(i = 0; i < NUMBER_OF_TANKS; i++) {
+    for(j = 0; j < (int)(sizeof(tankCommands) / sizeof(tankCommands[0])); j++) {
+      tankTopic(pumpCommand, sizeof(pumpCommand), tankCommands[j], i);
+      mqttBuildTopic(topic, sizeof(topic), pumpCommand);
+      mqttClient.subscribe(topic, 1);
+    }
+  }
+  mqttBuildTopic(topic, sizeof(topic), mqttCmndLog);
+  mqttClient.subscribe(topic, 1);
+  mqttBuildTopic(topic, sizeof(topic), mqttCmndOta);
+  mqttClient.subscribe(topic, 1);
+  mqttBuildTopic(topic, sizeof(topic), mqttCmndHistory);
+  mqttClient.subscribe(topic, 1);
   
-  for(int i = 1; i <= NUMBER_OF_PUMPS; i++) {
-    temp1 = baseCommand;
-    temp1.concat(char(48 + i));    // 48 = ASCII '0'
-    temp1.concat("/");
-    temp2 =temp1;
-    temp2.concat(mqttCmndFreq);
-    mqttClient.subscribe(temp2.c_str());
-    temp2 = temp1;
-    temp2.concat(mqttCmndNext);
-    mqttClient.subscribe(temp2.c_str());
-    temp2 = temp1;
-    temp2.concat(mqttCmndAmount);
-    mqttClient.subscribe(temp2.c_str());
+  for(i = 1; i <= NUMBER_OF_PUMPS; i++) {
+    for(j = 0; j < (int)(sizeof(pumpCommands) / sizeof(pumpCommands[0])); j++) {
+      pumpCommand[0] = '\0';
+      fmtAppendInt(pumpCommand, sizeof(pumpCommand), i);
+      fmtAppendChar(pumpCommand, sizeof(pumpCommand), '/');
+      fmtAppend(pumpCommand, sizeof(pumpCommand), pumpCommands[j]);
+      mqttBuildTopic(topic, sizeof(topic), pumpCommand);
+      mqttClient.subscribe(topic, 1);
+    }
   }
 }
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
 //***************************************************************************************************
-//  there are general and pump specific commands
+//  there are general, tank specific ("tank2/command-refill", without prefix for the first tank)
+//  and pump specific commands
 //***************************************************************************************************
-  String topicPrefix;
-  int topicPrefixLength;
-  String topicString;
-  String shortenedTopic;
+  char topicPrefix[MQTT_TOPIC_LENGTH];
+  size_t topicPrefixLength;
+  const char* shortenedTopic;
+  int tank = 0;
   int pump;
-  String shortenedPumpTopic;
-  
-  topicPrefix = mqttMainTopic;
-  topicPrefix.concat("/");
-  topicPrefix.concat(NANNY_NUMBER);
-  topicPrefix.concat("/");
-  topicPrefixLength = topicPrefix.length(); 
-  topicString = topic;
-  shortenedTopic = topicString.substring(topicPrefixLength);
-
-  payload[length] = '\0';
-  String stringValue = String((char*) payload);
-
-  Serial.print("MQTT callback:   ");
-  Serial.print(topicString);
-  Serial.print(" = ");
-  Serial.println(stringValue);
-
-  if(shortenedTopic == mqttCmndContainer) {
-    prefs.begin("nanny", false);
-    prefs.putUInt(PREF_CONTAINER_SIZE, stringValue.toInt());
-    prefs.end();
+  const char* shortenedPumpTopic;
+  char stringValue[MQTT_VALUE_LENGTH];
+  long value;
+
+  if(mqttFaultLoss()) {
+    return;
+  }
+  mqttBuildTopic(topicPrefix, sizeof(topicPrefix), "");
+  topicPrefixLength = strlen(topicPrefix); 
+  if(strncmp(topic, topicPrefix, topicPrefixLength) != 0) {
+    LOG_W("MQTT callback:   foreign topic = %s", topic);
+    return;
+  }
+  shortenedTopic = topic + topicPrefixLength;
+  if(strncmp(shortenedTopic, "tank", 4) == 0) {
+    tank = atoi(shortenedTopic + 4) - 1;
+    if(tank < 0 || tank >= NUMBER_OF_TANKS || shortenedTopic[5] != '/') {
+      LOG_W("MQTT callback:   tank not recognized = %s", shortenedTopic);
+      return;
+    }
+    shortenedTopic += 6;                // single digit tank number and '/'
+  }
+
+  if(length >= sizeof(stringValue)) {
+    length = sizeof(stringValue) - 1;
+  }
+  memcpy(stringValue, payload, length);
+  stringValue[length] = '\0';
+  value = atol(stringValue);
+
+  LOG_I("MQTT callback:   %s = %s", topic, stringValue);
+
+  if(strcmp(shortenedTopic, mqttCmndContainer) == 0) {
+    ledgerSetContainer(tank, constrain(value, 0, UINT16_MAX));
+    levelChanged = true;
+  } else if(strcmp(shortenedTopic, mqttCmndRefill) == 0) {
+    refillTank = tank;
+    refillPouredMl = value;
+    refillRequested = true;
+  } else if(strcmp(shortenedTopic, mqttCmndOta) == 0) {
+    otaRequest(stringValue);
+  } else if(strcmp(shortenedTopic, mqttCmndLog) == 0) {
+    logDumpRequested = true;
+  } else if(strcmp(shortenedTopic, mqttCmndHistory) == 0) {
+    // from-to in seconds since 1.1.1970 UTC, without to until now
+    char* rest;
+    historyFrom = strtoul(stringValue, &rest, 10);
+    historyTo = (*rest == '-') ? strtoul(rest + 1, NULL, 10) : UINT32_MAX;
+    historyRequested = true;
   } else {
-    if(shortenedTopic == mqttCmndWater) {
-      prefs.begin("nanny", false);
-      prefs.putUInt(PREF_REMAINING_WATER, stringValue.toInt());
-      prefs.end();
+    if(strcmp(shortenedTopic, mqttCmndWater) == 0) {
+      ledgerSetLevel(tank, value);
+      levelChanged = true;
     } else {
-      pump = shortenedTopic.toInt();    // returns 0 if no number is found
-      if(pump <= 0 || pump > NUMBER_OF_PUMPS) {
-        Serial.print("MQTT callback:   command not recognized = ");
-        Serial.println(shortenedTopic);
+      pump = atoi(shortenedTopic);      // returns 0 if no number is found
+      if(pump <= 0 || pump > NUMBER_OF_PUMPS || shortenedTopic[1] != '/') {
+        LOG_W("MQTT callback:   command not recognized = %s", shortenedTopic);
       } else {
-        shortenedPumpTopic = shortenedTopic.substring(2);   // single digit pump number and '/'
-        if(shortenedPumpTopic == mqttCmndFreq) {
-          prefs.begin("nanny", false);
-          switch(pump) {
-            case 1:
-              prefs.putUInt(PREF_P1_WATERING_FREQ, stringValue.toInt());        
-              break;
-            case 2:
-              prefs.putUInt(PREF_P2_WATERING_FREQ, stringValue.toInt());        
-              break;
-            case 3:
-              prefs.putUInt(PREF_P3_WATERING_FREQ, stringValue.toInt());        
-              break;
-            case 4:
-              prefs.putUInt(PREF_P4_WATERING_FREQ, stringValue.toInt());        
-              break;
+        shortenedPumpTopic = shortenedTopic + 2;        // single digit pump number and '/'
+        if(strcmp(shortenedPumpTopic, mqttCmndFreq) == 0) {
+          scheduleSetFreq(pump - 1, constrain(value, 0, UINT16_MAX));
+          scheduleChanged = true;
+        } else if(strcmp(shortenedPumpTopic, mqttCmndNext) == 0) {
+          scheduleSetNext(pump - 1, constrain(value, 0, UINT16_MAX));
+          scheduleChanged = true;
+        } else if(strcmp(shortenedPumpTopic, mqttCmndAmount) == 0 &&
+                  (value < 0 || value > EVENT_DURATION_MAX_MS / 1000)) {
+          LOG_W("MQTT callback:   pump %d, amount %ld s out of range", pump, value);
+        } else if(strcmp(shortenedPumpTopic, mqttCmndAmount) == 0) {
+          scheduleSetAmount(pump - 1, value);
+          scheduleChanged = true;
+        } else if(strcmp(shortenedPumpTopic, mqttCmndNeed) == 0) {
+          if(value > 0) {
+            scheduleFromNeed(pump - 1, value);
+            scheduleChanged = true;
           }
-          prefs.end();
-        } else if(shortenedPumpTopic == mqttCmndNext) {
-          prefs.begin("nanny", false);
-          switch(pump) {
-            case 1:
-              prefs.putUInt(PREF_P1_NEXT_WATERING, stringValue.toInt());        
-              break;
-            case 2:
-              prefs.putUInt(PREF_P2_NEXT_WATERING, stringValue.toInt());        
-              break;
-            case 3:
-              prefs.putUInt(PREF_P3_NEXT_WATERING, stringValue.toInt());        
-              break;
-            case 4:
-              prefs.putUInt(PREF_P4_NEXT_WATERING, stringValue.toInt());        
-              break;
+        } else if(strcmp(shortenedPumpTopic, mqttCmndWaterNow) == 0) {
+          // seconds, or milli liter with suffix "ml"
+          uint32_t ms = (strstr(stringValue, "ml") != NULL) ? ledgerDurationMs(pumpTank[pump - 1], value) : value * 1000UL;
+          if(ms > WATER_NOW_MAX * 1000UL) {
+            ms = WATER_NOW_MAX * 1000UL;
           }
-          prefs.end();  
-        } else if(shortenedPumpTopic == mqttCmndAmount) {
-          prefs.begin("nanny", false);
-          switch(pump) {
-            case 1:
-              prefs.putUInt(PREF_P1_WATERING_AMOUNT, stringValue.toInt());        
-              break;
-            case 2:
-              prefs.putUInt(PREF_P2_WATERING_AMOUNT, stringValue.toInt());        
-              break;
-            case 3:
-              prefs.putUInt(PREF_P3_WATERING_AMOUNT, stringValue.toInt());        
-              break;
-            case 4:
-              prefs.putUInt(PREF_P4_WATERING_AMOUNT, stringValue.toInt());        
-              break;
+          if(value > 0) {
+            pumpJobAdd(pump - 1, ms, jobSourceRemote);
           }
-          prefs.end();  
         } else {
-          Serial.print("MQTT callback:   pump ");
-          Serial.print(pump);
-          Serial.print(", command not recognized = ");
-          Serial.println(shortenedPumpTopic);        
+          LOG_W("MQTT callback:   pump %d, command not recognized = %s", pump, shortenedPumpTopic);
         }
       }
     }
   }
 }
 
+bool mqttConnect() {
+//***************************************************************************************************
+//  no clean session, the broker keeps the subscriptions and queued QoS 1 commands for mqttClientID.
+//  With MQTT_TLS the handshake is done here, so it is measured on its own, PubSubClient then uses
+//  the connected client
+//***************************************************************************************************
+#if MQTT_TLS
+  unsigned long startTime;
+
+  if(!mqttTlsClient.connected()) {
+    startTime = millis();
+    if(!mqttTlsClient.connect(SECRET_MQTT_BROKER, SECRET_MQTT_PORT)) {
+      LOG_E("MQTT: TLS handshake with %s failed", SECRET_MQTT_BROKER);
+      return false;
+    }
+    metricsObserve(mqttTlsClient.resumed() ? HISTOGRAM_TLS_RESUMED_MS : HISTOGRAM_TLS_HANDSHAKE_MS,
+                   millis() - startTime);
+  }
+#endif
+  return mqttClient.connect(mqttClientID, SECRET_MQTT_USER, SECRET_MQTT_PASSWORD, NULL, 0, false, NULL, false);
+}
+
 void mqttReconnect() {
 //***************************************************************************************************
+//  one attempt, the next not before MQTT_RECONNECT_MS. Never waits, loop() keeps running the pumps.
+//***************************************************************************************************
+  if(mqttReconnectAt != 0 && millis() - mqttReconnectAt < MQTT_RECONNECT_MS) {
+    return;
+  }
+  mqttReconnectAt = millis();
+  metricsCount(METRIC_MQTT_RECONNECTS);
+  if (mqttConnect()) {
+    // resubscribe
+    mqttSubscribeToTopics();
+    mqttReconnectAt = 0;
+  } else {
+    LOG_E("MQTT failed, rc=%d try again in %d ms", mqttClient.state(), MQTT_RECONNECT_MS);
+  }
+}
+
+bool mqttFaultLoss() {
+//***************************************************************************************************
+//  true for MQTT_FAULT_LOSS percent of all messages in and out, to test how the system copes
+//***************************************************************************************************
+#if MQTT_FAULT_LOSS > 0
+  if(random(100) < MQTT_FAULT_LOSS) {
+    LOG_W("MQTT message dropped on purpose");
+    return true;
+  }
+#endif
+  return false;
+}
+
+void mqttBuildTopic(char* topic, size_t size, const char* subTopic) {
+//***************************************************************************************************
+//  mqttMainTopic/NANNY_NUMBER/subTopic
+//***************************************************************************************************
+  topic[0] = '\0';
+  fmtAppend(topic, size, mqttMainTopic);
+  fmtAppendChar(topic, size, '/');
+  fmtAppendChar(topic, size, NANNY_NUMBER);
+  fmtAppendChar(topic, size, '/');
+  if(!fmtAppend(topic, size, subTopic)) {
+    LOG_E("MQTT topic too long: %s", topic);
+  }
+}
+
+void mqttPublishValue(const char* topic, const char* value) {
+//***************************************************************************************************
 //  
 //***************************************************************************************************
-  int mqttRetries = 0;
+  char completeTopic[MQTT_TOPIC_LENGTH];
 
-  // try 5 times to reconnect
-  while (!mqttClient.connected() && mqttRetries < 5) {
-    // Attempt to connect
-    if (mqttClient.connect(mqttClientID + NANNY_NUMBER, SECRET_MQTT_USER, SECRET_MQTT_PASSWORD)) {
-      // resubscribe
-      mqttSubscribeToTopics();
-    } else {
-      Serial.print("MQTT failed, rc=");
-      Serial.print(mqttClient.state());
-      Serial.println(" try again in 5 seconds");
-      // Wait 5 seconds before retrying
-      delay(5000);
-      mqttRetries++;
+  if(mqttFaultLoss()) {
+    return;
+  }
+#if MQTT_SERIAL_LOOPBACK && LOG_LEVEL > LOG_LEVEL_NONE
+  Serial.printf("< %s %s\n", topic, value);
+#endif
+
+  if(statusUdpOnly) {
+    return;
+  }
+  if(!mqttClient.connected()) {
+    mqttReconnect();
+    if(!mqttClient.connected()) {
+      LOG_W("MQTT not connected, %s not published", topic);
+      return;
     }
   }
+  mqttClient.loop();
+  mqttBuildTopic(completeTopic, sizeof(completeTopic), topic);
+  mqttClient.publish(completeTopic, value);
+  LOG_D("MQTT publishing: %s = %s", completeTopic, value);
 }
 
-void mqttPublishValue(String topic, String value) {
+void mqttPublishBinary(const char* topic, const uint8_t* data, size_t length) {
 //***************************************************************************************************
-//  
+//  like mqttPublishValue but for raw bytes
 //***************************************************************************************************
-  String completeTopic;
+  char completeTopic[MQTT_TOPIC_LENGTH];
 
+  if(mqttFaultLoss()) {
+    return;
+  }
+#if MQTT_SERIAL_LOOPBACK && LOG_LEVEL > LOG_LEVEL_NONE
+  Serial.printf("< %s %u bytes\n", topic, (unsigned)length);
+#endif
+  if(statusUdpOnly) {
+    return;
+  }
   if(!mqttClient.connected()) {
     mqttReconnect();
+    if(!mqttClient.connected()) {
+      LOG_W("MQTT not connected, %s not published", topic);
+      return;
+    }
+  }
+  mqttClient.loop();
+  mqttBuildTopic(completeTopic, sizeof(completeTopic), topic);
+  mqttClient.publish(completeTopic, data, length);
+  LOG_D("MQTT publishing: %s = %u bytes", completeTopic, (unsigned)length);
+}
+
+void mqttPublishHistoryBatch(const uint8_t* data, size_t length) {
+//***************************************************************************************************
+//  up to EVENT_LOG_BATCH event_t records as is, see eventlog.h, an empty message ends the history
+//***************************************************************************************************
+  mqttPublishBinary(mqttTopicHistory, data, length);
+}
+
+void mqttPublishLog() {
+//***************************************************************************************************
+//  one message per record of the log ring, oldest first
+//***************************************************************************************************
+  char line[LOG_LINE_LENGTH + 32];
+  uint16_t i;
+
+  logRingPaused = true;
+  for(i = 0; logFormatRecord(i, line, sizeof(line)); i++) {
+    mqttPublishValue(mqttTopicLog, line);
+  }
+  logRingPaused = false;
+}
+
+void publishHeapStats() {
+//***************************************************************************************************
+//  free, minimum free this wake, minimum free ever, largest block, net allocations, loop and idle
+//  task stack left, allocations after setup, all in one comma separated message
+//***************************************************************************************************
+  heapStats_t stats;
+  char temp[88];
+  int32_t values[8];
+  int i;
+
+  heapStatsGet(&stats);
+  values[0] = stats.freeHeap;
+  values[1] = stats.minFreeHeap;
+  values[2] = stats.minFreeHeapEver;
+  values[3] = stats.largestBlock;
+  values[4] = stats.allocations;
+  values[5] = stats.loopStack;
+  values[6] = stats.idleStack;
+  values[7] = stats.steadyAllocations;
+  temp[0] = '\0';
+  for(i = 0; i < 8; i++) {
+    if(i > 0) {
+      fmtAppendChar(temp, sizeof(temp), ',');
+    }
+    fmtAppendInt(temp, sizeof(temp), values[i]);
+  }
+  LOG_I("Heap: free %lu, largest block %lu, allocations %ld", 
+        (unsigned long)stats.freeHeap, (unsigned long)stats.largestBlock, (long)stats.allocations);
+#if STATIC_MEMORY_MODE
+  if(stats.steadyAllocations > 0) {
+    LOG_E("Heap: %ld allocations after setup", (long)stats.steadyAllocations);
+  }
+#endif
+  mqttPublishValue(mqttTopicHeap, temp);
+}
+
+void publishMetrics() {
+//***************************************************************************************************
+//  as many messages as needed for all sections, see metrics.h for the layout
+//***************************************************************************************************
+  char temp[MQTT_BUFFER_SIZE - MQTT_TOPIC_LENGTH];
+  int section = 0;
+
+  do {
+    section = metricsFormat(temp, sizeof(temp), section);
+    mqttPublishValue(mqttTopicMetrics, temp);
+  } while(section != 0);
+}
+
+void publishForecast(int tank) {
+//***************************************************************************************************
+//  hours till dry and the time the tank runs dry in seconds since 1.1.1970 UTC, 0 if not known
+//***************************************************************************************************
+  char temp[24];
+  char subTopic[MQTT_TOPIC_LENGTH];
+  int hours = forecastHoursToDry(tank);
+
+  temp[0] = '\0';
+  fmtAppendInt(temp, sizeof(temp), hours);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  if(sntpTimeValid() && hours < FORECAST_MAX_DAYS * 24) {
+    fmtAppendInt(temp, sizeof(temp), time(NULL) - hourSeconds() + hours * 3600L);
+  } else {
+    fmtAppendInt(temp, sizeof(temp), 0);
   }
+  tankTopic(subTopic, sizeof(subTopic), mqttTopicForecast, tank);
+  mqttPublishValue(subTopic, temp);
+}
+
+bool otaYield() {
+//***************************************************************************************************
+//  between the reads of a download: MQTT is served, a pump job ends the download of this wake
+//***************************************************************************************************
   mqttClient.loop();
-  completeTopic = mqttMainTopic;
-  completeTopic.concat('/');
-  completeTopic.concat(NANNY_NUMBER);
-  completeTopic.concat('/');
-  completeTopic.concat(topic);
-  mqttClient.publish(completeTopic.c_str(), value.c_str());
-  Serial.print("MQTT publishing: ");
-  Serial.print(completeTopic.c_str());
-  Serial.print(" = ");
-  Serial.println(value.c_str());
+  return pumpJobsIdle();
+}
+
+void otaStep() {
+//***************************************************************************************************
+//  one part of the firmware download per wake, at most OTA_WAKE_BUDGET_MS, publishes the progress:
+//  version,bytes,size,state
+//***************************************************************************************************
+  const char* states[] = {"idle", "running", "done", "failed"};
+  char temp[MQTT_VALUE_LENGTH + 32];
+  char version[MQTT_VALUE_LENGTH];
+  int state;
+
+  version[0] = '\0';
+  fmtAppend(version, sizeof(version), otaState.version);
+  otaStepped = true;
+  state = otaContinue(otaClient, OTA_WAKE_BUDGET_MS, otaYield);
+  temp[0] = '\0';
+  fmtAppend(temp, sizeof(temp), version);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppendInt(temp, sizeof(temp), otaState.offset);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppendInt(temp, sizeof(temp), otaState.size);
+  fmtAppendChar(temp, sizeof(temp), ',');
+  fmtAppend(temp, sizeof(temp), states[state]);
+  mqttPublishValue(mqttTopicOta, temp);
+  if(state == OTA_DONE) {
+    LOG_I("OTA: restarting with %s", version);
+    mqttClient.disconnect();
+    delay(100);
+    ESP.restart();
+  }
+}
+
+bool statusUdpWake() {
+//***************************************************************************************************
+//  with STATUS_UDP a timer wake skips MQTT, its status frame goes over UDP before it sleeps, see
+//  statusUdpSend(). Every STATUS_UDP_MAX_WAKES wakes one uses MQTT, see statusudp.h
+//***************************************************************************************************
+  if(!STATUS_UDP || esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER ||
+     statusUdpWakes >= STATUS_UDP_MAX_WAKES) {
+    statusUdpWakes = 0;
+    return false;
+  }
+  statusUdpOnly = true;
+  return true;
 }
 
+bool statusUdpSend() {
+//***************************************************************************************************
+//  the status frame of a UDP wake, built after the pumps as the one over MQTT. False if commands
+//  wait or the gateway does not answer, the wake then connects MQTT and stays awake until idle.
+//***************************************************************************************************
+  unsigned long startTime = millis();
+
+  buildStatusFrame();
+  if(statusUdpExchange(&statusFrame) == STATUS_UDP_DONE) {
+    metricsObserve(HISTOGRAM_STATUS_UDP_MS, millis() - startTime);
+    statusUdpWakes++;
+    return true;
+  }
+  statusUdpWakes = 0;
+  statusUdpOnly = false;
+  sleepWhenIdle = false;
+  connectAndShowMQTTStatus();
+  timeStamp = millis();
+  return false;
+}
+
+void publishStatusFrame() {
+//***************************************************************************************************
+//  see statusframe.h
+//***************************************************************************************************
+  buildStatusFrame();
+  mqttPublishBinary(mqttTopicStatus, (const uint8_t*)&statusFrame, sizeof(statusFrame));
+}
+
+void buildStatusFrame() {
+//***************************************************************************************************
+//  into statusFrame, for MQTT or UDP
+//***************************************************************************************************
+  esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+  int i;
+
+  memset(&statusFrame, 0, sizeof(statusFrame));
+  statusFrame.version = STATUS_FRAME_VERSION;
+  statusFrame.nanny = NANNY_NUMBER - '0';
+  statusFrame.time = time(NULL);
+  statusFrame.batteryMv = batteryMilliVolts;
+  statusFrame.remainingWater = remainingWater[0];
+  statusFrame.containerSize = containerSize[0];
+  statusFrame.waterCorrection = waterCorrection[0];
+  for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+    statusFrame.nextWatering[i] = nextWatering[i];
+  }
+  for(i = 0; i < NUMBER_OF_TANKS; i++) {
+    if(tankEmpty(i)) {
+      statusFrame.flags |= STATUS_FLAG_TANK_EMPTY;
+    }
+  }
+  if(cause == ESP_SLEEP_WAKEUP_TIMER) {
+    statusFrame.flags |= STATUS_FLAG_TIMER_WAKE;
+  } else if(cause == ESP_SLEEP_WAKEUP_EXT0 || cause == ESP_SLEEP_WAKEUP_EXT1) {
+    statusFrame.flags |= STATUS_FLAG_BUTTON_WAKE;
+  }
+  if(!sntpTimeValid()) {
+    statusFrame.flags |= STATUS_FLAG_NO_TIME;
+  }
+  statusFrame.hoursToDry = forecastHoursToDry(0);
+  statusFrame.crc = eventLogCrc(&statusFrame, sizeof(statusFrame) - 1);
+}
+
+void publishProfile() {
+//***************************************************************************************************
+//  time and cycles per phase of this wake, see profile.h for the layout
+//***************************************************************************************************
+  char temp[2 * PROFILE_PHASES * 11];
+
+  profileFormat(temp, sizeof(temp));
+  mqttPublishValue(mqttTopicProfile, temp);
+}
+#endif
+
+void serialCommandLoop() {
+//***************************************************************************************************
+//  'l' dumps the log ring, in every BUILD_VARIANT. With MQTT_SERIAL_LOOPBACK a line "> subTopic payload"
+//  is handled like a message from the broker, i.e. "> 1/command-water-now 3", and every publish is
+//  echoed with "< ". So the commands can be tried without a broker.
+//***************************************************************************************************
+  int c;
+
+  while((c = Serial.read()) >= 0) {
+    if(serialLineLength == 0 && c == 'l') {
+      logDump(Serial);
+    } else if(c == '\n' || c == '\r') {
+      serialLine[serialLineLength] = '\0';
+#if MQTT_SERIAL_LOOPBACK && BUILD_NETWORK
+      char topic[MQTT_TOPIC_LENGTH];
+      char* payload;
+
+      if(serialLine[0] == '>' && serialLine[1] == ' ') {
+        payload = strchr(serialLine + 2, ' ');
+        if(payload != NULL) {
+          *payload++ = '\0';
+          mqttBuildTopic(topic, sizeof(topic), serialLine + 2);
+          mqttCallback(topic, (byte*)payload, strlen(payload));
+        }
+      }
+#endif
+      serialLineLength = 0;
+    } else if(serialLineLength < sizeof(serialLine) - 1) {
+      serialLine[serialLineLength++] = c;
+    }
+  }
+}
+
+#if BUILD_DISPLAY
 void buttonsInit() {
 //***************************************************************************************************
 //  
 //***************************************************************************************************
   btnT.setPressedHandler([](Button2 & b) {
-    Serial.println("Top button clicked");
+    LOG_D("Top button clicked");
     btnTClicked = true;
   });
 
+  btnT.setReleasedHandler([](Button2 & b) {
+    if(b.wasPressedFor() < REFILL_LONG_PRESS_MS) {
+      btnEventAt = millis();
+      btnTReleased = true;
+    }
+  });
+
+  btnT.setLongClickTime(REFILL_LONG_PRESS_MS);
+  btnT.setLongClickHandler([](Button2 & b) {
+    LOG_D("Top button long clicked");
+    btnEventAt = millis();
+    btnTLongClicked = true;
+  });
+
   btnB.setPressedHandler([](Button2 & b) {
-    Serial.println("Bottom button clicked");
+    LOG_D("Bottom button clicked");
+    btnEventAt = millis();
     btnBClicked = true;
   });  
 }
+#endif
 
 void setTimerAndGoToSleep() {
 //***************************************************************************************************
-//  set alarm clock to the next full hour (if no internet connection exists then just 1 hour)
+//  set alarm clock to the full hour plus WAKE_OFFSET when the next pump is due, at most SLEEP_MAX_HOURS
+//  (if the time is not known then just 1 hour)
 //***************************************************************************************************
   const unsigned long uSToSecondsFactor = 1000000;
   unsigned long sleepingSeconds = 60 * 60;          // one hour
+  int hours = 1;
 
-  if(wifiConnected) {
-    sleepingSeconds = (59 - minute()) * 60 + (59 - second());
-    Serial.print("going to sleep for ");
-    Serial.print(sleepingSeconds + TIMER_DRIFT_COMPENSATION);
-    Serial.println(" seconds");
-  } else {
-    Serial.println("going to sleep for one hour");
+  if(pumpRunning) {
+    pumpJobStop();
+  }
+#if BUILD_DISPLAY
+  uiSaveEdits();
+#endif
+#if BUILD_NETWORK
+  if(statusUdpOnly && !statusUdpSend()) {
+    return;                             // loop() goes on with MQTT
+  }
+#endif
+
+  jobHourStart();
+  if(clockValid()) {
+    hours = hoursToNextJob();
+    sleepingSeconds = 3599 - hourSeconds() + (hours - 1) * 3600UL;
+  }
+  profileMark(PROFILE_LOOP);
+  if(timedJobDue) {
+    LOG_W("Watering window missed");
+    metricsCount(METRIC_MISSED_SCHEDULES);
+  }
+  metricsSet(GAUGE_AWAKE_MS, millis());
+#if BUILD_NETWORK
+  if(mqttClient.connected()) {
+    publishHeapStats();
+    if(metricsExportDue()) {
+      publishMetrics();
+    }
+#if PROFILE_WAKE
+    publishProfile();
+#endif
+    publishStatusFrame();
   }
+#endif
+  sleepingSeconds += TIMER_DRIFT_COMPENSATION * hours;
+  LOG_I("awake for %lu ms, going to sleep for %lu seconds", millis(), sleepingSeconds);
 
+#if BUILD_DISPLAY
   tft.writecommand(TFT_DISPOFF);
   tft.writecommand(TFT_SLPIN);
-  int err = esp_wifi_stop();
+#endif
+#if BUILD_NETWORK
+  esp_wifi_stop();
+#endif
   // wakeup on timer
-  esp_sleep_enable_timer_wakeup((sleepingSeconds + TIMER_DRIFT_COMPENSATION) * uSToSecondsFactor);
-  // also wakeup on top button
-  esp_sleep_enable_ext1_wakeup(GPIO_SEL_35, ESP_EXT1_WAKEUP_ALL_LOW);
+  esp_sleep_enable_timer_wakeup(sleepingSeconds * uSToSecondsFactor);
+  // also wakeup on both buttons, ext0 for the bottom and ext1 for the top one tells them apart
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)BTN_BOTTOM, 0);
+  esp_sleep_enable_ext1_wakeup(1ULL << BTN_TOP, ESP_EXT1_WAKEUP_ALL_LOW);
   esp_deep_sleep_start();
 }
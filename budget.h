@@ -0,0 +1,72 @@
+//***************************************************************************************************
+//  budget:       Memory used by the sketch's own buffers, per subsystem. Sizes are known at compile
+//                time, in STATIC_MEMORY_MODE the build fails if they don't fit into RAM_BUDGET and
+//                RTC_BUDGET. Add new buffers here, this file is included after all others
+//                and after the globals of the sketch.
+//                Subsystems left out by BUILD_VARIANT count 0.
+//***************************************************************************************************
+
+#ifndef budget_h
+#define budget_h
+
+// RAM
+#define BUDGET_PROFILE            (sizeof(profile))
+#if BUILD_NETWORK
+#define BUDGET_MQTT               (MQTT_BUFFER_SIZE)       // allocated once while connecting
+#define BUDGET_OTA                (sizeof(otaBuffer) + sizeof(otaCopyBuffer))
+#else
+#define BUDGET_MQTT               0
+#define BUDGET_OTA                0
+#endif
+#if BUILD_DISPLAY
+#define BUDGET_ICON_BLIT          (sizeof(iconBlitBuffer))
+#define BUDGET_UI                 (sizeof(uiShown) + sizeof(uiShownSelected))
+#else
+#define BUDGET_ICON_BLIT          0
+#define BUDGET_UI                 0
+#endif
+#define BUDGET_RAM_TOTAL          (BUDGET_MQTT + BUDGET_PROFILE + BUDGET_OTA + BUDGET_ICON_BLIT + BUDGET_UI)
+
+// RTC slow memory, survives deep sleep
+#define BUDGET_SKETCH             (sizeof(lastJobHour) + sizeof(lastJobHourValid))
+#define BUDGET_LOG                (sizeof(logRing) + 3 * sizeof(uint16_t) + sizeof(logImage))
+#define BUDGET_HEAPSTATS          (sizeof(heapMinFreeEver))
+#define BUDGET_METRICS            (sizeof(metrics))
+#define BUDGET_EVENTLOG           (sizeof(eventLogCompactDay))
+#if BUILD_NETWORK
+#define BUDGET_OTA_STATE          (sizeof(otaState))
+#define BUDGET_STATUS_UDP         (sizeof(statusUdpWakes))
+#define BUDGET_SNTP               (sizeof(sntpAddresses))
+#else
+#define BUDGET_OTA_STATE          0
+#define BUDGET_STATUS_UDP         0
+#define BUDGET_SNTP               0
+#endif
+#if BUILD_NETWORK && MQTT_TLS
+#define BUDGET_TLS                (sizeof(tlsSession) + sizeof(tlsSessionLength))
+#else
+#define BUDGET_TLS                0
+#endif
+#define BUDGET_RTC_TOTAL          (BUDGET_SKETCH + BUDGET_LOG + BUDGET_HEAPSTATS + BUDGET_METRICS + \
+                                   BUDGET_EVENTLOG + BUDGET_OTA_STATE + BUDGET_STATUS_UDP + BUDGET_SNTP + BUDGET_TLS)
+
+#if STATIC_MEMORY_MODE
+static_assert(BUDGET_RAM_TOTAL <= RAM_BUDGET, "buffers exceed RAM_BUDGET, see settings.h and budget.h");
+static_assert(BUDGET_RTC_TOTAL <= RTC_BUDGET, "buffers exceed RTC_BUDGET, see settings.h and budget.h");
+#endif
+
+void budgetReport() {
+//***************************************************************************************************
+//  once per wake at debug level
+//***************************************************************************************************
+  LOG_D("RAM budget: mqtt %u, profile %u, ota %u, icons %u, ui %u, total %u of %u bytes",
+        (unsigned)BUDGET_MQTT, (unsigned)BUDGET_PROFILE, (unsigned)BUDGET_OTA, (unsigned)BUDGET_ICON_BLIT,
+        (unsigned)BUDGET_UI, (unsigned)BUDGET_RAM_TOTAL, (unsigned)RAM_BUDGET);
+  LOG_D("RTC budget: sketch %u, log %u, heapstats %u, metrics %u, eventlog %u, ota %u, status udp %u, "
+        "sntp %u, tls %u, total %u of %u bytes",
+        (unsigned)BUDGET_SKETCH, (unsigned)BUDGET_LOG, (unsigned)BUDGET_HEAPSTATS, (unsigned)BUDGET_METRICS,
+        (unsigned)BUDGET_EVENTLOG, (unsigned)BUDGET_OTA_STATE, (unsigned)BUDGET_STATUS_UDP, (unsigned)BUDGET_SNTP,
+        (unsigned)BUDGET_TLS, (unsigned)BUDGET_RTC_TOTAL, (unsigned)RTC_BUDGET);
+}
+
+#endif
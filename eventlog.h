@@ -0,0 +1,354 @@
+//***************************************************************************************************
+//  eventlog:     Append-only log of pump runs and refills in LittleFS (spiffs partition).
+//                Fixed 16 byte records are written to EVENT_LOG_BLOCKS files of
+//                EVENT_LOG_BLOCK_RECORDS records each, used round robin, so the log never grows
+//                and no single file is rewritten over and over. Once a day the records of the
+//                previous days are summed up into daily aggregates, which outlive the raw records.
+//                Each record carries a CRC, records torn by a power loss are skipped when reading.
+//                A lost head file is found again by the newest record. The duration has 24 bits,
+//                the high byte was reserved and is 0 in older records.
+//***************************************************************************************************
+
+#ifndef eventlog_h
+#define eventlog_h
+
+#include <LittleFS.h>
+
+#define EVENT_WATERING            1
+#define EVENT_REFILL              2
+#define EVENT_NO_PUMP             0xFF
+#define EVENT_DURATION_MAX_MS     0xFFFFFF        // 4.6 hours, longer pump runs are not accepted
+
+#define EVENT_LOG_HEAD_FILE       "/evhead"
+#define EVENT_LOG_DAILY_FILE      "/evdaily.bin"
+#define EVENT_LOG_DAILY_OLD_FILE  "/evdaily.old"
+#define EVENT_LOG_COMPACT_DAYS    7     // days caught up at most after a long time without network
+
+typedef struct __attribute__((packed)) {
+  uint32_t time;                        // UTC, seconds since 1.1.1970
+  uint8_t type;                         // EVENT_WATERING or EVENT_REFILL
+  uint8_t pump;                         // counts from 0, EVENT_NO_PUMP for tank events
+  uint16_t durationMs;                  // low 16 bits, see eventSetDuration()
+  uint16_t ml;                          // estimated for watering, poured for refills
+  uint16_t batteryMv;                   // when the event started
+  uint8_t tank;                         // counts from 0
+  uint8_t durationMsHigh;               // bits 16 to 23 of the duration
+  uint8_t reserved;
+  uint8_t crc;                          // over all bytes before
+} event_t;
+
+typedef struct __attribute__((packed)) {
+  uint16_t day;                         // days since 1.1.1970
+  uint8_t runs[NUMBER_OF_PUMPS];
+  uint16_t ml[NUMBER_OF_PUMPS];
+  uint16_t refilledMl;
+  uint8_t crc;                          // over all bytes before
+} dailyEvents_t;
+
+static_assert(sizeof(event_t) == 16, "event_t is part of the history message format");
+
+RTC_DATA_ATTR uint16_t eventLogCompactDay = 0;    // day of the last compaction
+
+bool eventLogMounted = false;
+uint8_t eventLogHead;                   // block that is written to
+
+uint8_t eventLogCrc(const void* data, size_t length) {
+//***************************************************************************************************
+//  CRC-8, polynomial 0x31
+//***************************************************************************************************
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint8_t crc = 0xFF;
+  int bit;
+
+  while(length-- > 0) {
+    crc ^= *bytes++;
+    for(bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+void eventSetDuration(event_t* event, uint32_t ms) {
+//***************************************************************************************************
+//  pumpJobAdd() keeps runs within EVENT_DURATION_MAX_MS, a longer one is cut
+//***************************************************************************************************
+  if(ms > EVENT_DURATION_MAX_MS) {
+    ms = EVENT_DURATION_MAX_MS;
+  }
+  event->durationMs = ms & 0xFFFF;
+  event->durationMsHigh = ms >> 16;
+}
+
+uint32_t eventDuration(const event_t* event) {
+//***************************************************************************************************
+//  in milli seconds
+//***************************************************************************************************
+  return ((uint32_t)event->durationMsHigh << 16) | event->durationMs;
+}
+
+void eventLogBlockName(char* path, size_t size, uint8_t block) {
+//***************************************************************************************************
+//  /ev0.bin, /ev1.bin, ...
+//***************************************************************************************************
+  path[0] = '\0';
+  fmtAppend(path, size, "/ev");
+  fmtAppendInt(path, size, block);
+  fmtAppend(path, size, ".bin");
+}
+
+bool eventLogRead(File& file, event_t* event) {
+//***************************************************************************************************
+//  next record with a valid CRC, false at the end of the file
+//***************************************************************************************************
+  while(file.read((uint8_t*)event, sizeof(event_t)) == sizeof(event_t)) {
+    if(eventLogCrc(event, sizeof(event_t) - 1) == event->crc) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void eventLogWriteHead() {
+//***************************************************************************************************
+//  eventLogHead to the head file
+//***************************************************************************************************
+  File file;
+
+  file = LittleFS.open(EVENT_LOG_HEAD_FILE, "w");
+  if(file) {
+    file.write(&eventLogHead, 1);
+    file.close();
+  }
+}
+
+uint8_t eventLogFindHead() {
+//***************************************************************************************************
+//  the block with the newest last record, 0 for an empty log
+//***************************************************************************************************
+  uint32_t newest = 0;
+  uint8_t head = 0;
+  event_t event;
+  char path[16];
+  File file;
+  int i;
+
+  for(i = 0; i < EVENT_LOG_BLOCKS; i++) {
+    eventLogBlockName(path, sizeof(path), i);
+    file = LittleFS.open(path, "r");
+    if(!file) {
+      continue;
+    }
+    if(file.size() >= sizeof(event_t)) {
+      file.seek((file.size() / sizeof(event_t) - 1) * sizeof(event_t), SeekSet);
+      if(eventLogRead(file, &event) && event.time >= newest) {
+        newest = event.time;
+        head = i;
+      }
+    }
+    file.close();
+  }
+  return head;
+}
+
+bool eventLogMount() {
+//***************************************************************************************************
+//  in setup, later calls return at once. Formats the partition if it can't be mounted
+//***************************************************************************************************
+  File file;
+
+  if(eventLogMounted) {
+    return true;
+  }
+  if(!LittleFS.begin(true)) {
+    LOG_E("Event log: LittleFS not mounted");
+    return false;
+  }
+  eventLogHead = EVENT_LOG_BLOCKS;
+  file = LittleFS.open(EVENT_LOG_HEAD_FILE, "r");
+  if(file) {
+    file.read(&eventLogHead, 1);
+    file.close();
+  }
+  if(eventLogHead >= EVENT_LOG_BLOCKS) {
+    // first mount, or the head file was torn by a power loss in eventLogRotate()
+    eventLogHead = eventLogFindHead();
+    eventLogWriteHead();
+  }
+  eventLogMounted = true;
+  return true;
+}
+
+void eventLogRotate() {
+//***************************************************************************************************
+//  next block becomes head, its old records are dropped
+//***************************************************************************************************
+  char path[16];
+
+  eventLogHead = (eventLogHead + 1) % EVENT_LOG_BLOCKS;
+  eventLogBlockName(path, sizeof(path), eventLogHead);
+  LittleFS.remove(path);
+  eventLogWriteHead();
+}
+
+bool eventLogAppend(event_t* event) {
+//***************************************************************************************************
+//  sets the CRC and writes the record behind the last complete record of the head block
+//***************************************************************************************************
+  char path[16];
+  File file;
+  size_t count;
+
+  if(!eventLogMount()) {
+    return false;
+  }
+  event->crc = eventLogCrc(event, sizeof(event_t) - 1);
+  eventLogBlockName(path, sizeof(path), eventLogHead);
+  count = 0;
+  file = LittleFS.open(path, "r");
+  if(file) {
+    count = file.size() / sizeof(event_t);
+    file.close();
+  }
+  if(count >= EVENT_LOG_BLOCK_RECORDS) {
+    eventLogRotate();
+    eventLogBlockName(path, sizeof(path), eventLogHead);
+    count = 0;
+  }
+  // "r+" keeps the content, a partly written record at the end is overwritten
+  file = LittleFS.open(path, count > 0 ? "r+" : "w");
+  if(!file) {
+    LOG_E("Event log: can't open %s", path);
+    return false;
+  }
+  file.seek(count * sizeof(event_t), SeekSet);
+  count = file.write((const uint8_t*)event, sizeof(event_t));
+  file.close();
+  return count == sizeof(event_t);
+}
+
+void eventLogStream(uint32_t from, uint32_t to, void (*send)(const uint8_t* data, size_t length)) {
+//***************************************************************************************************
+//  all records with from <= time <= to, oldest block first, in batches of EVENT_LOG_BATCH records,
+//  an empty batch marks the end
+//***************************************************************************************************
+  event_t batch[EVENT_LOG_BATCH];
+  int count = 0;
+  char path[16];
+  File file;
+  int i;
+
+  if(eventLogMount()) {
+    for(i = 1; i <= EVENT_LOG_BLOCKS; i++) {
+      eventLogBlockName(path, sizeof(path), (eventLogHead + i) % EVENT_LOG_BLOCKS);
+      file = LittleFS.open(path, "r");
+      if(!file) {
+        continue;
+      }
+      while(eventLogRead(file, &batch[count])) {
+        if(batch[count].time >= from && batch[count].time <= to) {
+          count++;
+          if(count == EVENT_LOG_BATCH) {
+            send((const uint8_t*)batch, sizeof(batch));
+            count = 0;
+          }
+        }
+      }
+      file.close();
+    }
+  }
+  if(count > 0) {
+    send((const uint8_t*)batch, count * sizeof(event_t));
+  }
+  send(NULL, 0);
+}
+
+void eventLogCompact(uint32_t now) {
+//***************************************************************************************************
+//  appends one aggregate for each finished day since the last one, run once per day
+//***************************************************************************************************
+  dailyEvents_t days[EVENT_LOG_COMPACT_DAYS];
+  dailyEvents_t last;
+  uint16_t today = now / 86400;
+  uint16_t firstDay;
+  uint16_t day;
+  event_t event;
+  char path[16];
+  File file;
+  size_t count;
+  int i;
+
+  if(today == eventLogCompactDay || !eventLogMount()) {
+    return;
+  }
+  eventLogCompactDay = today;
+  // first day without aggregate
+  firstDay = today - 1;
+  file = LittleFS.open(EVENT_LOG_DAILY_FILE, "r");
+  if(file) {
+    if(file.size() >= sizeof(dailyEvents_t)) {
+      file.seek((file.size() / sizeof(dailyEvents_t) - 1) * sizeof(dailyEvents_t), SeekSet);
+      if(file.read((uint8_t*)&last, sizeof(last)) == sizeof(last) &&
+         eventLogCrc(&last, sizeof(last) - 1) == last.crc) {
+        firstDay = last.day + 1;
+      }
+    }
+    file.close();
+  }
+  if(firstDay >= today) {
+    return;
+  }
+  if(today - firstDay > EVENT_LOG_COMPACT_DAYS) {
+    firstDay = today - EVENT_LOG_COMPACT_DAYS;
+  }
+
+  memset(days, 0, sizeof(days));
+  for(i = 0; i < EVENT_LOG_BLOCKS; i++) {
+    eventLogBlockName(path, sizeof(path), i);
+    file = LittleFS.open(path, "r");
+    if(!file) {
+      continue;
+    }
+    while(eventLogRead(file, &event)) {
+      day = event.time / 86400;
+      if(day < firstDay || day >= today) {
+        continue;
+      }
+      if(event.type == EVENT_WATERING && event.pump < NUMBER_OF_PUMPS) {
+        days[day - firstDay].runs[event.pump]++;
+        days[day - firstDay].ml[event.pump] += event.ml;
+      } else if(event.type == EVENT_REFILL) {
+        days[day - firstDay].refilledMl += event.ml;
+      }
+    }
+    file.close();
+  }
+
+  // a full daily file is kept as .old and a new one is started
+  count = 0;
+  file = LittleFS.open(EVENT_LOG_DAILY_FILE, "r");
+  if(file) {
+    count = file.size() / sizeof(dailyEvents_t);
+    file.close();
+  }
+  if(count + (today - firstDay) > EVENT_LOG_DAYS) {
+    LittleFS.remove(EVENT_LOG_DAILY_OLD_FILE);
+    LittleFS.rename(EVENT_LOG_DAILY_FILE, EVENT_LOG_DAILY_OLD_FILE);
+    count = 0;
+  }
+  file = LittleFS.open(EVENT_LOG_DAILY_FILE, count > 0 ? "r+" : "w");
+  if(!file) {
+    LOG_E("Event log: can't open %s", EVENT_LOG_DAILY_FILE);
+    return;
+  }
+  file.seek(count * sizeof(dailyEvents_t), SeekSet);
+  for(day = firstDay; day < today; day++) {
+    days[day - firstDay].day = day;
+    days[day - firstDay].crc = eventLogCrc(&days[day - firstDay], sizeof(dailyEvents_t) - 1);
+    file.write((const uint8_t*)&days[day - firstDay], sizeof(dailyEvents_t));
+  }
+  file.close();
+  LOG_I("Event log: %d days compacted", today - firstDay);
+}
+
+#endif
@@ -0,0 +1,128 @@
+//***************************************************************************************************
+//  format:       Number and text formatting into fixed size buffers, no String and no heap.
+//                Every function appends to the zero terminated text already in the buffer, never
+//                writes past size bytes and returns false if the text had to be cut.
+//***************************************************************************************************
+
+#ifndef format_h
+#define format_h
+
+bool fmtAppend(char* buffer, size_t size, const char* text) {
+//***************************************************************************************************
+//  plain text
+//***************************************************************************************************
+  size_t length;
+
+  if(size == 0) {
+    return false;                       // not even room for the terminator
+  }
+  length = strlen(buffer);
+  while(*text != '\0') {
+    if(length + 1 >= size) {
+      buffer[length] = '\0';
+      return false;
+    }
+    buffer[length++] = *text++;
+  }
+  buffer[length] = '\0';
+  return true;
+}
+
+bool fmtAppendChar(char* buffer, size_t size, char c) {
+//***************************************************************************************************
+//  single character
+//***************************************************************************************************
+  char text[2] = {c, '\0'};
+
+  return fmtAppend(buffer, size, text);
+}
+
+bool fmtAppendPadded(char* buffer, size_t size, int32_t value, uint8_t width) {
+//***************************************************************************************************
+//  integer with leading zeros up to width digits, i.e. 7 with width 2 gives "07"
+//***************************************************************************************************
+  char digits[12];                      // 10 digits, sign and terminator
+  uint32_t magnitude;
+  int i = sizeof(digits) - 1;
+
+  digits[i] = '\0';
+  magnitude = (value < 0) ? (uint32_t)(-(value + 1)) + 1 : (uint32_t)value;
+  do {
+    digits[--i] = '0' + (magnitude % 10);
+    magnitude /= 10;
+  } while(magnitude > 0);
+  while((int)(sizeof(digits) - 1 - i) < width && i > 1) {
+    digits[--i] = '0';
+  }
+  if(value < 0) {
+    digits[--i] = '-';
+  }
+  return fmtAppend(buffer, size, &digits[i]);
+}
+
+bool fmtAppendUInt(char* buffer, size_t size, uint32_t value) {
+//***************************************************************************************************
+//  unsigned integer without padding, for counters past 2^31
+//***************************************************************************************************
+  char digits[11];                      // 10 digits and terminator
+  int i = sizeof(digits) - 1;
+
+  digits[i] = '\0';
+  do {
+    digits[--i] = '0' + (value % 10);
+    value /= 10;
+  } while(value > 0);
+  return fmtAppend(buffer, size, &digits[i]);
+}
+
+bool fmtAppendInt(char* buffer, size_t size, int32_t value) {
+//***************************************************************************************************
+//  integer without padding
+//***************************************************************************************************
+  return fmtAppendPadded(buffer, size, value, 1);
+}
+
+bool fmtAppendFixed(char* buffer, size_t size, int32_t value, uint8_t decimals) {
+//***************************************************************************************************
+//  fixed point, value is in units of 10^-decimals, i.e. 3712 with 3 decimals gives "3.712",
+//  at most 9 decimals
+//***************************************************************************************************
+  int32_t divisor = 1;
+  int32_t integral;
+  int32_t fraction;
+  uint8_t i;
+
+  if(decimals > 9) {
+    return false;                       // 10^10 is past int32_t
+  }
+  for(i = 0; i < decimals; i++) {
+    divisor *= 10;
+  }
+  integral = value / divisor;
+  fraction = value % divisor;
+  if(fraction < 0) {
+    fraction = -fraction;
+  }
+  if(value < 0 && integral == 0) {
+    if(!fmtAppendChar(buffer, size, '-')) {
+      return false;
+    }
+  }
+  if(!fmtAppendInt(buffer, size, integral)) {
+    return false;
+  }
+  if(decimals == 0) {
+    return true;
+  }
+  return fmtAppendChar(buffer, size, '.') && fmtAppendPadded(buffer, size, fraction, decimals);
+}
+
+bool fmtAppendUnit(char* buffer, size_t size, int32_t value, uint8_t decimals, const char* unit) {
+//***************************************************************************************************
+//  fixed point followed by a blank and the unit, i.e. "3.71 V"
+//***************************************************************************************************
+  return fmtAppendFixed(buffer, size, value, decimals) && fmtAppendChar(buffer, size, ' ') &&
+         fmtAppend(buffer, size, unit);
+}
+
+#endif
@@ -0,0 +1,109 @@
+//***************************************************************************************************
+//  heapstats:    Heap and stack figures of the current wake. The minimum free heap is also kept
+//                over all wakes in RTC memory, so slow fragmentation shows up in the telemetry.
+//                Allocations after setup: with CONFIG_HEAP_USE_HOOKS in the sdkconfig every malloc of
+//                the loop task is counted by the heap hook, also a malloc/free pair or a String
+//                temporary. Without the hooks only the net growth of allocated blocks is seen, that is
+//                a leak check and misses allocations that are freed again. The host tests run the same
+//                hooks on top of tests/alloccount.cpp, which counts every malloc and free.
+//                HEAP_STEADY_ABORT turns the first allocation after setup into an abort with the
+//                backtrace, that is how tests/nanny.py runs the whole sketch.
+//***************************************************************************************************
+
+#ifndef heapstats_h
+#define heapstats_h
+
+#include "esp_heap_caps.h"
+
+typedef struct {
+  uint32_t freeHeap;                    // bytes free right now
+  uint32_t minFreeHeap;                 // lowest free heap during this wake
+  uint32_t minFreeHeapEver;             // lowest free heap since power on
+  uint32_t largestBlock;                // biggest block malloc can still hand out
+  int32_t allocations;                  // net number of blocks allocated since heapStatsBegin()
+  int32_t steadyAllocations;            // allocations of the loop task since heapStatsSetupDone(),
+                                        // net number of blocks without CONFIG_HEAP_USE_HOOKS
+  uint32_t loopStack;                   // unused stack of the loop task in bytes
+  uint32_t idleStack;                   // unused stack of the idle task in bytes
+} heapStats_t;
+
+RTC_DATA_ATTR uint32_t heapMinFreeEver = UINT32_MAX;
+
+size_t heapBlocksAtBoot = 0;
+size_t heapBlocksAfterSetup = 0;
+bool heapSetupDone = false;
+
+#if CONFIG_HEAP_USE_HOOKS
+TaskHandle_t heapLoopTask = NULL;
+volatile uint32_t heapSteadyMallocs = 0;
+
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+//***************************************************************************************************
+//  called by the heap for every allocation of every task, the WiFi tasks allocate all the time
+//***************************************************************************************************
+  if(heapLoopTask != NULL && xTaskGetCurrentTaskHandle() == heapLoopTask) {
+    heapSteadyMallocs++;
+#if HEAP_STEADY_ABORT
+    abort();
+#endif
+  }
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void* ptr) {
+}
+#endif
+
+void heapStatsBegin() {
+//***************************************************************************************************
+//  first thing in setup, everything allocated before belongs to the libraries' constructors
+//***************************************************************************************************
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  heapBlocksAtBoot = info.allocated_blocks;
+}
+
+void heapStatsSetupDone() {
+//***************************************************************************************************
+//  last thing in setup, from here on the sketch should not need more heap
+//***************************************************************************************************
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  heapBlocksAfterSetup = info.allocated_blocks;
+  heapSetupDone = true;
+#if CONFIG_HEAP_USE_HOOKS
+  heapSteadyMallocs = 0;
+  heapLoopTask = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+void heapStatsGet(heapStats_t* stats) {
+//***************************************************************************************************
+//  snapshot of the heap and of both task stacks
+//***************************************************************************************************
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  stats->freeHeap = info.total_free_bytes;
+  stats->minFreeHeap = info.minimum_free_bytes;
+  stats->largestBlock = info.largest_free_block;
+  stats->allocations = (int32_t)info.allocated_blocks - (int32_t)heapBlocksAtBoot;
+  if(heapSetupDone) {
+#if CONFIG_HEAP_USE_HOOKS
+    stats->steadyAllocations = heapSteadyMallocs;
+#else
+    stats->steadyAllocations = (int32_t)info.allocated_blocks - (int32_t)heapBlocksAfterSetup;
+#endif
+  } else {
+    stats->steadyAllocations = 0;
+  }
+  if(stats->minFreeHeap < heapMinFreeEver) {
+    heapMinFreeEver = stats->minFreeHeap;
+  }
+  stats->minFreeHeapEver = heapMinFreeEver;
+  stats->loopStack = uxTaskGetStackHighWaterMark(NULL);
+  stats->idleStack = uxTaskGetStackHighWaterMark(xTaskGetIdleTaskHandle());
+}
+
+#endif
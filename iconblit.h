@@ -0,0 +1,76 @@
+//***************************************************************************************************
+//  iconblit:     Draws the xbm icons of icons.h as whole blocks. drawXBitmap() writes pixel by
+//                pixel, each with its own address window, 13 bytes over SPI per pixel. Here the
+//                bits are expanded into RGB565 lines of ICON_BLIT_LINES rows and sent with DMA in
+//                one address window per block, 2 bytes per pixel plus 11 per block. While one
+//                block goes out the next is expanded into the other buffer.
+//                The icons stay 1 bit in flash, so their colors are still chosen when drawing.
+//                ICON_DRAW_US in the metrics holds the time per icon, ICON_BLIT 0 draws as before
+//                for comparison.
+//***************************************************************************************************
+
+#ifndef iconblit_h
+#define iconblit_h
+
+#define ICON_BLIT_LINES           8     // rows per DMA block
+#define ICON_BLIT_MAX_WIDTH       32    // widest icon
+
+uint16_t iconBlitBuffer[2][ICON_BLIT_MAX_WIDTH * ICON_BLIT_LINES];
+
+void iconBlitBegin(TFT_eSPI& display) {
+//***************************************************************************************************
+//  after display.init()
+//***************************************************************************************************
+#if ICON_BLIT
+  display.initDMA();
+#endif
+}
+
+void iconDraw(TFT_eSPI& display, int32_t x, int32_t y, const uint8_t* bits, uint16_t width, uint16_t height,
+              uint16_t fgcolor, uint16_t bgcolor) {
+//***************************************************************************************************
+//  same as display.drawXBitmap() with background color
+//***************************************************************************************************
+  uint32_t startedAt = micros();
+#if ICON_BLIT
+  // the display takes the high byte first
+  uint16_t fg = (fgcolor >> 8) | (fgcolor << 8);
+  uint16_t bg = (bgcolor >> 8) | (bgcolor << 8);
+  uint16_t bytesPerRow = (width + 7) / 8;
+  uint16_t* buffer;
+  uint16_t row;
+  uint16_t rows;
+  uint16_t line;
+  uint16_t column;
+  uint8_t block = 0;
+
+  if(width > ICON_BLIT_MAX_WIDTH) {
+    display.drawXBitmap(x, y, bits, width, height, fgcolor, bgcolor);
+    return;
+  }
+  display.startWrite();
+  for(row = 0; row < height; row += rows) {
+    rows = min((uint16_t)ICON_BLIT_LINES, (uint16_t)(height - row));
+    // pushImageDMA() waits for the previous block, so the one before that is done with this buffer
+    buffer = iconBlitBuffer[block++ & 1];
+    for(line = 0; line < rows; line++) {
+      for(column = 0; column < width; column++) {
+        // xbm: least significant bit first, rows padded to full bytes
+        if(pgm_read_byte(bits + (row + line) * bytesPerRow + column / 8) & (1 << (column % 8))) {
+          buffer[line * width + column] = fg;
+        } else {
+          buffer[line * width + column] = bg;
+        }
+      }
+    }
+    display.pushImageDMA(x, y + row, width, rows, buffer);
+  }
+  display.dmaWait();
+  display.endWrite();
+#else
+  display.drawXBitmap(x, y, bits, width, height, fgcolor, bgcolor);
+#endif
+  metricsObserve(HISTOGRAM_ICON_DRAW_US, micros() - startedAt);
+}
+
+#endif
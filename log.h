@@ -0,0 +1,216 @@
+//***************************************************************************************************
+//  log:          Compile time filtered logging. Messages at or below LOG_LEVEL (see settings.h)
+//                are printed to serial and stored as binary records in a ring buffer in RTC memory,
+//                which survives deep sleep. Disabled levels expand to nothing, not even the
+//                format strings are compiled in. Format strings stay in flash, a ring record only
+//                keeps a pointer to its format string and the first numeric arguments.
+//                The pointers are only valid in the image that wrote them: the first digits of its
+//                ELF SHA-256 are kept next to the ring, a wake of any other image clears the ring.
+//***************************************************************************************************
+
+#ifndef log_h
+#define log_h
+
+#include "esp_ota_ops.h"
+
+#define LOG_LEVEL_NONE            0
+#define LOG_LEVEL_ERROR           1
+#define LOG_LEVEL_WARN            2
+#define LOG_LEVEL_INFO            3
+#define LOG_LEVEL_DEBUG           4
+
+#define LOG_RING_ARGS             2     // numeric arguments kept per ring record
+#define LOG_LINE_LENGTH           96    // longest line printed to serial
+#define LOG_IMAGE_LENGTH          17    // hex digits of the ELF SHA-256 kept and the terminator
+
+typedef struct {
+  uint16_t wake;                        // wake counter when the record was written
+  uint8_t level;
+  uint8_t argCount;
+  uint32_t ms;                          // millis() since wake
+  const char* format;                   // points into flash, valid as long as the image is the same
+  int32_t args[LOG_RING_ARGS];          // integers as is, floats in thousandths, strings as 0
+} logRecord_t;
+
+// RTC memory keeps its content during deep sleep and is initialised on power on
+RTC_DATA_ATTR logRecord_t logRing[LOG_RING_SIZE];
+RTC_DATA_ATTR uint16_t logRingHead = 0;
+RTC_DATA_ATTR uint16_t logRingCount = 0;
+RTC_DATA_ATTR uint16_t logWakeCount = 0;
+RTC_DATA_ATTR char logImage[LOG_IMAGE_LENGTH] = "";      // of the image the ring records belong to
+
+bool logRingPaused = false;             // set while dumping, so the dump doesn't overwrite itself
+
+void logWrite(uint8_t level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+  #define LOG_E(format, ...)      logWrite(LOG_LEVEL_ERROR, PSTR(format), ##__VA_ARGS__)
+#else
+  #define LOG_E(format, ...)      do {} while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+  #define LOG_W(format, ...)      logWrite(LOG_LEVEL_WARN, PSTR(format), ##__VA_ARGS__)
+#else
+  #define LOG_W(format, ...)      do {} while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+  #define LOG_I(format, ...)      logWrite(LOG_LEVEL_INFO, PSTR(format), ##__VA_ARGS__)
+#else
+  #define LOG_I(format, ...)      do {} while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  #define LOG_D(format, ...)      logWrite(LOG_LEVEL_DEBUG, PSTR(format), ##__VA_ARGS__)
+#else
+  #define LOG_D(format, ...)      do {} while(0)
+#endif
+
+void logBegin() {
+//***************************************************************************************************
+//  once per wake, serial is only started if anything can be logged at all
+//***************************************************************************************************
+  char image[LOG_IMAGE_LENGTH];
+
+  esp_ota_get_app_elf_sha256(image, sizeof(image));
+  if(strcmp(image, logImage) != 0) {
+    logRingHead = 0;
+    logRingCount = 0;
+    memcpy(logImage, image, sizeof(logImage));
+  }
+#if LOG_LEVEL > LOG_LEVEL_NONE
+  Serial.begin(115200);
+  Serial.println();
+#endif
+  logWakeCount++;
+}
+
+void logStore(uint8_t level, const char* format, va_list args) {
+//***************************************************************************************************
+//  walks the format string to fetch the arguments with their correct type
+//***************************************************************************************************
+  logRecord_t* record;
+  const char* p;
+  int longs;
+
+  if(logRingPaused) {
+    return;
+  }
+  record = &logRing[logRingHead];
+  record->wake = logWakeCount;
+  record->level = level;
+  record->argCount = 0;
+  record->ms = millis();
+  record->format = format;
+  for(p = format; *p != '\0'; p++) {
+    if(*p != '%') {
+      continue;
+    }
+    p++;
+    if(*p == '%') {
+      continue;
+    }
+    // flags, width and precision
+    while(*p != '\0' && strchr("-+ #0123456789.*", *p) != NULL) {
+      if(*p == '*') {
+        va_arg(args, int);
+      }
+      p++;
+    }
+    // length modifiers
+    longs = 0;
+    while(*p == 'l' || *p == 'h' || *p == 'z') {
+      if(*p == 'l') {
+        longs++;
+      }
+      p++;
+    }
+    if(*p == '\0') {
+      break;
+    }
+    int32_t value = 0;
+    bool known = true;
+    switch(*p) {
+      case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        if(longs >= 2) {
+          value = (int32_t)va_arg(args, long long);
+        } else if(longs == 1) {
+          value = (int32_t)va_arg(args, long);
+        } else {
+          value = va_arg(args, int);
+        }
+        break;
+      case 'f': case 'e': case 'g':
+        value = (int32_t)(va_arg(args, double) * 1000.0);
+        break;
+      case 's': case 'p':
+        va_arg(args, void*);
+        break;
+      default:
+        known = false;
+        break;
+    }
+    if(!known) {
+      break;    // unknown conversion, stop looking at arguments
+    }
+    if(record->argCount < LOG_RING_ARGS) {
+      record->args[record->argCount++] = value;
+    }
+  }
+  logRingHead = (logRingHead + 1) % LOG_RING_SIZE;
+  if(logRingCount < LOG_RING_SIZE) {
+    logRingCount++;
+  }
+}
+
+void logWrite(uint8_t level, const char* format, ...) {
+//***************************************************************************************************
+//  used by the LOG_x macros only
+//***************************************************************************************************
+  char line[LOG_LINE_LENGTH];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  Serial.println(line);
+
+  va_start(args, format);
+  logStore(level, format, args);
+  va_end(args);
+}
+
+bool logFormatRecord(uint16_t index, char* line, size_t size) {
+//***************************************************************************************************
+//  index 0 is the oldest record, returns false if there is no such record
+//***************************************************************************************************
+  const char levelChars[] = "-EWID";
+  logRecord_t* record;
+  int length;
+  int i;
+
+  if(index >= logRingCount) {
+    return false;
+  }
+  record = &logRing[(logRingHead + LOG_RING_SIZE - logRingCount + index) % LOG_RING_SIZE];
+  length = snprintf(line, size, "%u +%lu %c %s", record->wake, (unsigned long)record->ms,
+                    levelChars[record->level], record->format);
+  for(i = 0; i < record->argCount && length > 0 && (size_t)length < size; i++) {
+    length += snprintf(line + length, size - length, i == 0 ? " | %ld" : ", %ld", (long)record->args[i]);
+  }
+  return true;
+}
+
+void logDump(Print& out) {
+//***************************************************************************************************
+//  oldest record first, one line per record
+//***************************************************************************************************
+  char line[LOG_LINE_LENGTH + 32];
+  uint16_t i;
+
+  logRingPaused = true;
+  for(i = 0; logFormatRecord(i, line, sizeof(line)); i++) {
+    out.println(line);
+  }
+  logRingPaused = false;
+}
+
+#endif
@@ -0,0 +1,205 @@
+//***************************************************************************************************
+//  metrics:      Counters, gauges and histograms kept in RTC memory, so they add up over deep sleep
+//                until the next power on. All metrics are registered at compile time in the lists
+//                below, the registry uses no heap. metricsFormat() writes them into compact messages
+//                of whole sections:
+//                  first ':' section ; section ...
+//                first is the number of the first section in the message, the sections are
+//                  0 counters, 1 pump on-time per pump in ms, 2 gauges, 3... one per histogram
+//                Values within a section are separated by ',' and in the order of the lists. What does
+//                not fit into one message goes into the next, the sections of all messages of one
+//                export together are the complete set. Counters, on-times and buckets are unsigned.
+//***************************************************************************************************
+
+#ifndef metrics_h
+#define metrics_h
+
+// counters only go up
+#define METRIC_COUNTER_LIST(X) \
+  X(WAKE_POWER_ON)                      /* wake causes */ \
+  X(WAKE_TIMER) \
+  X(WAKE_BUTTON) \
+  X(WAKE_OTHER) \
+  X(NVS_WRITES) \
+  X(MISSED_SCHEDULES)                   /* timer wake outside of the watering window */ \
+  X(TANK_EMPTY)                         /* watering skipped because the tank was empty */ \
+  X(WIFI_FAILURES) \
+  X(MQTT_RECONNECTS) \
+  X(MANUAL_WATERINGS)
+
+// gauges keep the last value
+#define METRIC_GAUGE_LIST(X) \
+  X(BATTERY_MV) \
+  X(REMAINING_WATER) \
+  X(WATER_CORRECTION)                   /* per mille */ \
+  X(AWAKE_MS)                           /* of the previous wake */
+
+// histograms count values in logarithmic buckets
+#define METRIC_HISTOGRAM_LIST(X) \
+  X(WIFI_CONNECT_MS) \
+  X(MQTT_CONNECT_MS)                    /* including the TLS handshake */ \
+  X(TLS_HANDSHAKE_MS)                   /* full, after power on or an expired ticket */ \
+  X(TLS_RESUMED_MS)                     /* resumed session, see tlsclient.h */ \
+  X(STATUS_UDP_MS)                      /* status frame over UDP, compare with MQTT_CONNECT_MS */ \
+  X(MANUAL_LATENCY_MS)                  /* boot to pump on of a manual watering */ \
+  X(ICON_DRAW_US)                       /* per icon, see iconblit.h */ \
+  X(UI_RESPONSE_MS)                     /* button event to screen updated */
+
+#define METRICS_BUCKETS           10    // bucket 0 is below 16, bucket n below 2^(n+4), the last is open
+
+#define METRIC_ENUM_COUNTER(name)   METRIC_##name,
+#define METRIC_ENUM_GAUGE(name)     GAUGE_##name,
+#define METRIC_ENUM_HISTOGRAM(name) HISTOGRAM_##name,
+
+enum metricCounter_t { METRIC_COUNTER_LIST(METRIC_ENUM_COUNTER) METRIC_COUNTERS };
+enum metricGauge_t { METRIC_GAUGE_LIST(METRIC_ENUM_GAUGE) METRIC_GAUGES };
+enum metricHistogram_t { METRIC_HISTOGRAM_LIST(METRIC_ENUM_HISTOGRAM) METRIC_HISTOGRAMS };
+
+typedef struct {
+  uint32_t counters[METRIC_COUNTERS];
+  uint32_t pumpMs[NUMBER_OF_PUMPS];
+  int32_t gauges[METRIC_GAUGES];
+  uint16_t histograms[METRIC_HISTOGRAMS][METRICS_BUCKETS];
+  uint16_t wakesSinceExport;
+} metrics_t;
+
+RTC_DATA_ATTR metrics_t metrics;
+
+void metricsCount(metricCounter_t counter, uint32_t n = 1) {
+//***************************************************************************************************
+//  add n to a counter
+//***************************************************************************************************
+  metrics.counters[counter] += n;
+}
+
+void metricsSet(metricGauge_t gauge, int32_t value) {
+//***************************************************************************************************
+//  overwrite a gauge
+//***************************************************************************************************
+  metrics.gauges[gauge] = value;
+}
+
+void metricsObserve(metricHistogram_t histogram, uint32_t value) {
+//***************************************************************************************************
+//  buckets saturate instead of wrapping around
+//***************************************************************************************************
+  int bucket = 0;
+
+  value >>= 4;
+  while(value > 0 && bucket < METRICS_BUCKETS - 1) {
+    value >>= 1;
+    bucket++;
+  }
+  if(metrics.histograms[histogram][bucket] < UINT16_MAX) {
+    metrics.histograms[histogram][bucket]++;
+  }
+}
+
+void metricsAddPumpTime(int pump, uint32_t ms) {
+//***************************************************************************************************
+//  pump counts from 0
+//***************************************************************************************************
+  metrics.pumpMs[pump] += ms;
+}
+
+void metricsWake(esp_sleep_wakeup_cause_t cause) {
+//***************************************************************************************************
+//  once per wake
+//***************************************************************************************************
+  switch(cause) {
+    case ESP_SLEEP_WAKEUP_UNDEFINED:
+      metricsCount(METRIC_WAKE_POWER_ON);
+      break;
+    case ESP_SLEEP_WAKEUP_TIMER:
+      metricsCount(METRIC_WAKE_TIMER);
+      break;
+    case ESP_SLEEP_WAKEUP_EXT0:
+    case ESP_SLEEP_WAKEUP_EXT1:
+      metricsCount(METRIC_WAKE_BUTTON);
+      break;
+    default:
+      metricsCount(METRIC_WAKE_OTHER);
+      break;
+  }
+  metrics.wakesSinceExport++;
+}
+
+bool metricsExportDue() {
+//***************************************************************************************************
+//  true once every METRICS_EXPORT_WAKES wakes
+//***************************************************************************************************
+  return metrics.wakesSinceExport >= METRICS_EXPORT_WAKES;
+}
+
+#define METRICS_SECTIONS          (3 + METRIC_HISTOGRAMS)
+
+bool metricsFormatSection(char* buffer, size_t size, int section) {
+//***************************************************************************************************
+//  values of one section, false if they did not fit
+//***************************************************************************************************
+  bool fits = true;
+  int i;
+
+  switch(section) {
+    case 0:
+      for(i = 0; i < METRIC_COUNTERS; i++) {
+        fits = fits && (i == 0 || fmtAppendChar(buffer, size, ',')) &&
+               fmtAppendUInt(buffer, size, metrics.counters[i]);
+      }
+      break;
+    case 1:
+      for(i = 0; i < NUMBER_OF_PUMPS; i++) {
+        fits = fits && (i == 0 || fmtAppendChar(buffer, size, ',')) &&
+               fmtAppendUInt(buffer, size, metrics.pumpMs[i]);
+      }
+      break;
+    case 2:
+      for(i = 0; i < METRIC_GAUGES; i++) {
+        fits = fits && (i == 0 || fmtAppendChar(buffer, size, ',')) &&
+               fmtAppendInt(buffer, size, metrics.gauges[i]);
+      }
+      break;
+    default:
+      for(i = 0; i < METRICS_BUCKETS; i++) {
+        fits = fits && (i == 0 || fmtAppendChar(buffer, size, ',')) &&
+               fmtAppendUInt(buffer, size, metrics.histograms[section - 3][i]);
+      }
+      break;
+  }
+  return fits;
+}
+
+int metricsFormat(char* buffer, size_t size, int first) {
+//***************************************************************************************************
+//  one message with the sections from first on, see top of file for the layout. Returns the first
+//  section of the next message, 0 after the last one, that also restarts the export interval.
+//  A section longer than a whole message is sent cut and flagged with '~' at the end.
+//***************************************************************************************************
+  size_t mark;
+  int section;
+
+  buffer[0] = '\0';
+  fmtAppendInt(buffer, size, first);
+  fmtAppendChar(buffer, size, ':');
+  for(section = first; section < METRICS_SECTIONS; section++) {
+    mark = strlen(buffer);
+    if((section == first || fmtAppendChar(buffer, size, ';')) && metricsFormatSection(buffer, size, section)) {
+      continue;
+    }
+    if(section == first) {
+      buffer[size - 2] = '~';
+      buffer[size - 1] = '\0';
+      section++;
+    } else {
+      buffer[mark] = '\0';             // whole sections only
+    }
+    break;
+  }
+  if(section >= METRICS_SECTIONS) {
+    metrics.wakesSinceExport = 0;
+    return 0;
+  }
+  return section;
+}
+
+#endif
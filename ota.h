@@ -0,0 +1,415 @@
+//***************************************************************************************************
+//  ota:          Firmware update over the air from a local HTTP server, started by command-ota with
+//                the version as payload. With OTA_DELTA the first try is a patch against the running
+//                image, OTA_URL_PREFIX + version + "-" + the first 16 hex digits of the ELF SHA-256 of
+//                the running image + ".patch", made by tools/otadelta.py. If the server has none it is
+//                the full image, OTA_URL_PREFIX + version + ".bin". Each wake downloads for at most
+//                OTA_WAKE_BUDGET_MS straight into the other app partition, a patch copies the parts
+//                that did not change from the running partition. The position in the download and in
+//                the patch is kept in RTC memory and the next wake goes on with an HTTP range request.
+//                The complete image is checked by the boot loader before it is selected, so a patch
+//                against another image is never booted.
+//                A new image has to confirm itself with otaConfirm() in its first wake, after it
+//                reached the MQTT broker. If it crashes or fails to connect before, the boot loader
+//                rolls back to the previous image on the next reset. Only a boot loader built with
+//                CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE does that, the build warns without it: the
+//                prebuilt one of the Arduino core keeps booting a broken image.
+//                A patch, numbers are little endian:
+//                  "PNDP", size of the new image (4)
+//                  then operations until the image is complete:
+//                  1, offset (4), length (4)     copy from the running image
+//                  2, length (4), bytes          new bytes
+//***************************************************************************************************
+
+#ifndef ota_h
+#define ota_h
+
+#include <HTTPClient.h>
+#include "esp_ota_ops.h"
+#include "sdkconfig.h"
+
+#if !defined(CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE) && !defined(CONFIG_APP_ROLLBACK_ENABLE)
+  #warning "boot loader without CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE, a broken OTA image is not rolled back"
+#endif
+
+#define OTA_SECTOR_SIZE           4096
+#define OTA_BUFFER_SIZE           1024
+#define OTA_COPY_SIZE             512   // copied from the running image at a time
+#define OTA_STALL_MS              5000  // no data for that long ends the download of this wake
+
+#define OTA_IDLE                  0
+#define OTA_RUNNING               1     // goes on in the next wake
+#define OTA_DONE                  2     // restart to boot the new image
+#define OTA_FAILED                3
+
+#define OTA_PATCH_MAGIC           "PNDP"
+#define OTA_PATCH_HEADER_SIZE     8
+#define OTA_OP_COPY               1
+#define OTA_OP_COPY_SIZE          9
+#define OTA_OP_DATA               2
+#define OTA_OP_DATA_SIZE          5
+
+// where a patch is, see top of file
+#define OTA_PATCH_START           0     // in the header of the patch
+#define OTA_PATCH_NEXT            1     // in the header of an operation
+#define OTA_PATCH_COPY            2
+#define OTA_PATCH_DATA            3
+
+typedef struct {
+  char version[MQTT_VALUE_LENGTH];      // empty if no update is running
+  uint32_t offset;                      // bytes of the download used
+  uint32_t size;                        // of the download, 0 until the first response
+  uint32_t partitionAddress;            // the download started into this partition
+  uint32_t written;                     // bytes written to the partition
+  bool delta;                           // the download is a patch
+  uint8_t patchState;                   // OTA_PATCH_...
+  uint8_t headerLength;                 // bytes of header read, a header may span wakes
+  uint8_t header[OTA_OP_COPY_SIZE];
+  uint32_t imageSize;                   // from the header of the patch
+  uint32_t opOffset;                    // next byte copied from the running image
+  uint32_t opRemaining;                 // bytes left of the operation
+} otaState_t;
+
+RTC_DATA_ATTR otaState_t otaState;
+
+uint8_t otaBuffer[OTA_BUFFER_SIZE];
+uint8_t otaCopyBuffer[OTA_COPY_SIZE];
+unsigned long otaStepStartedAt;
+uint32_t otaStepBudgetMs;
+bool otaBusy = false;                   // in otaContinue(), the MQTT callback may run in between
+
+extern "C" bool verifyRollbackLater() {
+//***************************************************************************************************
+//  keeps the Arduino core from confirming a new image at start, see otaConfirm()
+//***************************************************************************************************
+  return true;
+}
+
+bool otaActive() {
+//***************************************************************************************************
+//  an update is requested or half way through
+//***************************************************************************************************
+  return otaState.version[0] != '\0';
+}
+
+void otaRequest(const char* version) {
+//***************************************************************************************************
+//  from the MQTT callback, the download starts in loop()
+//***************************************************************************************************
+  if(otaBusy) {
+    LOG_W("OTA: %s ignored, %s is downloading", version, otaState.version);
+    return;
+  }
+  memset(&otaState, 0, sizeof(otaState));
+  fmtAppend(otaState.version, sizeof(otaState.version), version);
+  otaState.delta = OTA_DELTA;
+}
+
+void otaConfirm() {
+//***************************************************************************************************
+//  the running image works, no rollback any more
+//***************************************************************************************************
+  esp_ota_img_states_t state;
+
+  if(esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK &&
+     state == ESP_OTA_IMG_PENDING_VERIFY) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    LOG_I("OTA: new image confirmed");
+  }
+}
+
+uint32_t otaRead32(const uint8_t* bytes) {
+//***************************************************************************************************
+//  little endian, as in a patch
+//***************************************************************************************************
+  return bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+bool otaTimeLeft() {
+//***************************************************************************************************
+//  of OTA_WAKE_BUDGET_MS in this wake
+//***************************************************************************************************
+  return millis() - otaStepStartedAt < otaStepBudgetMs;
+}
+
+int otaFailed() {
+//***************************************************************************************************
+//  the update is given up, a new command-ota starts over
+//***************************************************************************************************
+  otaState.version[0] = '\0';
+  return OTA_FAILED;
+}
+
+void otaStartOver(const esp_partition_t* partition) {
+//***************************************************************************************************
+//  from the first byte of the download, into partition
+//***************************************************************************************************
+  otaState.offset = 0;
+  otaState.size = 0;
+  otaState.written = 0;
+  otaState.patchState = OTA_PATCH_START;
+  otaState.headerLength = 0;
+  otaState.partitionAddress = partition->address;
+}
+
+bool otaWrite(const esp_partition_t* partition, const uint8_t* data, uint32_t length) {
+//***************************************************************************************************
+//  appends to the new image, at most a sector. A sector is erased when the first byte goes into it.
+//***************************************************************************************************
+  if(otaState.written + length > partition->size) {
+    LOG_E("OTA: image larger than the partition");
+    return false;
+  }
+  if(otaState.written % OTA_SECTOR_SIZE == 0 ||
+     otaState.written / OTA_SECTOR_SIZE != (otaState.written + length - 1) / OTA_SECTOR_SIZE) {
+    esp_partition_erase_range(partition, (otaState.written + length - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE,
+                              OTA_SECTOR_SIZE);
+  }
+  if(esp_partition_write(partition, otaState.written, data, length) != ESP_OK) {
+    LOG_E("OTA: flash write failed at %lu", (unsigned long)otaState.written);
+    return false;
+  }
+  otaState.written += length;
+  return true;
+}
+
+int32_t otaPatch(const esp_partition_t* partition, const uint8_t* data, uint32_t length) {
+//***************************************************************************************************
+//  applies the next length bytes of the patch, returns how many were used or -1 on an error. A copy
+//  stops when the time of this wake is up, the next call goes on with it, also with length 0.
+//***************************************************************************************************
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  uint32_t used = 0;
+  uint32_t n;
+
+  while(true) {
+    if(otaState.patchState == OTA_PATCH_COPY) {
+      if(!otaTimeLeft()) {
+        return used;
+      }
+      n = min(otaState.opRemaining, (uint32_t)sizeof(otaCopyBuffer));
+      if(esp_partition_read(running, otaState.opOffset, otaCopyBuffer, n) != ESP_OK ||
+         !otaWrite(partition, otaCopyBuffer, n)) {
+        return -1;
+      }
+      otaState.opOffset += n;
+      otaState.opRemaining -= n;
+      if(otaState.opRemaining == 0) {
+        otaState.patchState = OTA_PATCH_NEXT;
+      }
+      continue;
+    }
+    if(used == length) {
+      return used;
+    }
+    if(otaState.patchState == OTA_PATCH_DATA) {
+      n = min(otaState.opRemaining, length - used);
+      if(!otaWrite(partition, data + used, n)) {
+        return -1;
+      }
+      used += n;
+      otaState.opRemaining -= n;
+      if(otaState.opRemaining == 0) {
+        otaState.patchState = OTA_PATCH_NEXT;
+      }
+      continue;
+    }
+    // headers byte by byte, they may be split over reads and wakes
+    otaState.header[otaState.headerLength++] = data[used++];
+    if(otaState.patchState == OTA_PATCH_START) {
+      if(otaState.headerLength < OTA_PATCH_HEADER_SIZE) {
+        continue;
+      }
+      otaState.imageSize = otaRead32(&otaState.header[4]);
+      if(memcmp(otaState.header, OTA_PATCH_MAGIC, 4) != 0 || otaState.imageSize > partition->size) {
+        LOG_E("OTA: not a patch");
+        return -1;
+      }
+      otaState.patchState = OTA_PATCH_NEXT;
+    } else if(otaState.header[0] == OTA_OP_COPY) {
+      if(otaState.headerLength < OTA_OP_COPY_SIZE) {
+        continue;
+      }
+      otaState.opOffset = otaRead32(&otaState.header[1]);
+      otaState.opRemaining = otaRead32(&otaState.header[5]);
+      if(otaState.opOffset > running->size || otaState.opRemaining > running->size - otaState.opOffset) {
+        LOG_E("OTA: patch copies from outside the running image");
+        return -1;
+      }
+      otaState.patchState = otaState.opRemaining > 0 ? OTA_PATCH_COPY : OTA_PATCH_NEXT;
+    } else if(otaState.header[0] == OTA_OP_DATA) {
+      if(otaState.headerLength < OTA_OP_DATA_SIZE) {
+        continue;
+      }
+      otaState.opRemaining = otaRead32(&otaState.header[1]);
+      otaState.patchState = otaState.opRemaining > 0 ? OTA_PATCH_DATA : OTA_PATCH_NEXT;
+    } else {
+      LOG_E("OTA: unknown patch operation %u", otaState.header[0]);
+      return -1;
+    }
+    otaState.headerLength = 0;
+  }
+}
+
+void otaUrl(char* url, size_t size) {
+//***************************************************************************************************
+//  of the patch or the full image, see top of file
+//***************************************************************************************************
+  char sha[17];
+
+  url[0] = '\0';
+  fmtAppend(url, size, OTA_URL_PREFIX);
+  fmtAppend(url, size, otaState.version);
+  if(otaState.delta) {
+    esp_ota_get_app_elf_sha256(sha, sizeof(sha));
+    fmtAppendChar(url, size, '-');
+    fmtAppend(url, size, sha);
+    fmtAppend(url, size, ".patch");
+  } else {
+    fmtAppend(url, size, ".bin");
+  }
+}
+
+int otaGet(HTTPClient& http, WiFiClient& client, const char* url) {
+//***************************************************************************************************
+//  GET of url from otaState.offset on, returns the HTTP code
+//***************************************************************************************************
+  char range[24];
+
+  http.begin(client, url);
+  if(otaState.offset > 0) {
+    range[0] = '\0';
+    fmtAppend(range, sizeof(range), "bytes=");
+    fmtAppendInt(range, sizeof(range), otaState.offset);
+    fmtAppendChar(range, sizeof(range), '-');
+    http.addHeader("Range", range);
+  }
+  return http.GET();
+}
+
+int otaDownload(WiFiClient& client, bool (*keepGoing)()) {
+//***************************************************************************************************
+//  see otaContinue()
+//***************************************************************************************************
+  const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+  unsigned long dataAt;
+  HTTPClient http;
+  WiFiClient* stream;
+  char url[MQTT_TOPIC_LENGTH + MQTT_VALUE_LENGTH];
+  int32_t used;
+  int code;
+  int length;
+
+  if(partition == NULL) {
+    LOG_E("OTA: no update partition");
+    return otaFailed();
+  }
+  if(partition->address != otaState.partitionAddress) {
+    otaStartOver(partition);
+  }
+  // a copy the last wake had no time left for
+  if(otaState.delta && otaPatch(partition, NULL, 0) < 0) {
+    return otaFailed();
+  }
+
+  if((otaState.size == 0 || otaState.offset < otaState.size) && otaTimeLeft()) {
+    otaUrl(url, sizeof(url));
+    code = otaGet(http, client, url);
+    if(code == HTTP_CODE_NOT_FOUND && otaState.delta && otaState.size == 0) {
+      LOG_I("OTA: no patch for the running image, downloading all of it");
+      http.end();
+      otaState.delta = false;
+      otaUrl(url, sizeof(url));
+      code = otaGet(http, client, url);
+    }
+    if(code == HTTP_CODE_OK && otaState.offset > 0) {
+      LOG_W("OTA: server ignores ranges, starting over");
+      otaStartOver(partition);
+    } else if(code != HTTP_CODE_OK && code != HTTP_CODE_PARTIAL_CONTENT) {
+      LOG_E("OTA: %s, HTTP %d", url, code);
+      http.end();
+      return otaFailed();
+    }
+    if(otaState.size == 0) {
+      otaState.size = otaState.offset + http.getSize();
+      if(http.getSize() <= 0 || (!otaState.delta && otaState.size > partition->size)) {
+        LOG_E("OTA: download size %d does not fit", http.getSize());
+        http.end();
+        return otaFailed();
+      }
+    }
+
+    stream = http.getStreamPtr();
+    dataAt = millis();
+    while(otaState.offset < otaState.size && otaTimeLeft() && millis() - dataAt < OTA_STALL_MS && keepGoing()) {
+      if(stream->available() <= 0) {
+        if(!stream->connected()) {
+          break;
+        }
+        delay(1);
+        continue;
+      }
+      length = stream->read(otaBuffer, min((uint32_t)sizeof(otaBuffer), otaState.size - otaState.offset));
+      if(length <= 0) {
+        continue;
+      }
+      dataAt = millis();
+      if(otaState.delta) {
+        used = otaPatch(partition, otaBuffer, length);
+        if(used < 0) {
+          http.end();
+          return otaFailed();
+        }
+        otaState.offset += used;
+        if(used < length) {
+          break;                        // out of time in a copy, the rest is downloaded again
+        }
+      } else {
+        if(!otaWrite(partition, otaBuffer, length)) {
+          http.end();
+          return otaFailed();
+        }
+        otaState.offset += length;
+      }
+    }
+    http.end();
+  }
+  LOG_I("OTA: %s, %lu of %lu bytes of the %s", otaState.version, (unsigned long)otaState.offset,
+        (unsigned long)otaState.size, otaState.delta ? "patch" : "image");
+
+  if(otaState.offset < otaState.size || (otaState.delta && otaState.patchState == OTA_PATCH_COPY)) {
+    return OTA_RUNNING;
+  }
+  if(otaState.delta && otaState.written != otaState.imageSize) {
+    LOG_E("OTA: patch ends at %lu of %lu bytes", (unsigned long)otaState.written, (unsigned long)otaState.imageSize);
+    return otaFailed();
+  }
+  otaState.version[0] = '\0';
+  // checks the image, a broken one is never booted
+  if(esp_ota_set_boot_partition(partition) != ESP_OK) {
+    LOG_E("OTA: image not valid");
+    return OTA_FAILED;
+  }
+  return OTA_DONE;
+}
+
+int otaContinue(WiFiClient& client, uint32_t budgetMs, bool (*keepGoing)()) {
+//***************************************************************************************************
+//  downloads the next part of the update for at most budgetMs, keepGoing() is called between the
+//  reads and ends the part when it returns false. Returns OTA_IDLE, OTA_RUNNING, OTA_DONE or
+//  OTA_FAILED.
+//***************************************************************************************************
+  int state;
+
+  if(!otaActive()) {
+    return OTA_IDLE;
+  }
+  otaStepStartedAt = millis();
+  otaStepBudgetMs = budgetMs;
+  otaBusy = true;
+  state = otaDownload(client, keepGoing);
+  otaBusy = false;
+  return state;
+}
+
+#endif
@@ -0,0 +1,81 @@
+//***************************************************************************************************
+//  profile:      Where the time of one wake goes, from boot to deep sleep. profileMark() at the end
+//                of each phase books the micro seconds and CPU cycles since the previous mark to
+//                that phase. profileFormat() writes all phases into one message:
+//                  micro seconds per phase ; cycles per phase
+//                in the order of the list below, BOOT is the time before setup() and has no cycles.
+//                The cycle counter wraps after 17 s at 240 MHz, longer phases show too few cycles.
+//***************************************************************************************************
+
+#ifndef profile_h
+#define profile_h
+
+#define PROFILE_PHASE_LIST(X) \
+  X(BOOT)                               /* reset to setup(), boot loader not included */ \
+  X(START)                              /* log, prefs and manual watering */ \
+  X(DISPLAY) \
+  X(WIFI) \
+  X(TIME) \
+  X(MQTT) \
+  X(STATUS)                             /* publishing and first screen */ \
+  X(LOOP)                               /* pump jobs, commands and buttons till sleep */
+
+#define PROFILE_ENUM_PHASE(name)  PROFILE_##name,
+
+enum profilePhase_t { PROFILE_PHASE_LIST(PROFILE_ENUM_PHASE) PROFILE_PHASES };
+
+typedef struct {
+  uint32_t us[PROFILE_PHASES];
+  uint32_t cycles[PROFILE_PHASES];
+  uint32_t lastUs;
+  uint32_t lastCycles;
+} profile_t;
+
+profile_t profile;
+
+void profileBegin() {
+//***************************************************************************************************
+//  first thing in setup, everything before is boot
+//***************************************************************************************************
+  memset(&profile, 0, sizeof(profile));
+  profile.lastUs = micros();
+  profile.lastCycles = ESP.getCycleCount();
+  profile.us[PROFILE_BOOT] = profile.lastUs;
+}
+
+void profileMark(profilePhase_t phase) {
+//***************************************************************************************************
+//  end of a phase, a phase may be marked more than once, the times add up
+//***************************************************************************************************
+  uint32_t us = micros();
+  uint32_t cycles = ESP.getCycleCount();
+
+  profile.us[phase] += us - profile.lastUs;
+  profile.cycles[phase] += cycles - profile.lastCycles;
+  profile.lastUs = us;
+  profile.lastCycles = cycles;
+}
+
+void profileFormat(char* buffer, size_t size) {
+//***************************************************************************************************
+//  see top of file for the layout
+//***************************************************************************************************
+  int i;
+
+  buffer[0] = '\0';
+  for(i = 0; i < PROFILE_PHASES; i++) {
+    if(i > 0) {
+      fmtAppendChar(buffer, size, ',');
+    }
+    fmtAppendInt(buffer, size, profile.us[i]);
+  }
+  fmtAppendChar(buffer, size, ';');
+  for(i = 0; i < PROFILE_PHASES; i++) {
+    if(i > 0) {
+      fmtAppendChar(buffer, size, ',');
+    }
+    fmtAppendInt(buffer, size, profile.cycles[i]);
+  }
+}
+
+#endif
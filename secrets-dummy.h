@@ -8,8 +8,14 @@
 #define SECRET_WIFI_SSID      "your SSID"
 #define SECRET_WIFI_PASSWORD  "your wifi password"
 #define SECRET_MQTT_BROKER    "your mqtt server"
-#define SECRET_MQTT_PORT      1883
+#define SECRET_MQTT_PORT      1883          // 8883 with MQTT_TLS
 #define SECRET_MQTT_USER      "your mqtt user name"
 #define SECRET_MQTT_PASSWORD  "your mqtt user password"
+// CA that signed the broker certificate, PEM, only used with MQTT_TLS
+#define SECRET_MQTT_CA_CERT   "-----BEGIN CERTIFICATE-----\n" \
+                              "your CA certificate\n" \
+                              "-----END CERTIFICATE-----\n"
+// shared with the UDP gateway, only used with STATUS_UDP
+#define SECRET_STATUS_UDP_KEY "your status key"
 
 #endif
@@ -2,8 +2,19 @@
 //  settings:     Adapt to your liking.
 //***************************************************************************************************
 
+// build variant, the subsystems a variant does not use are not compiled
+#define BUILD_FULL                1     // display, screens, buttons and network
+#define BUILD_HEADLESS            2     // network without display, i.e. in a closed cabinet
+#define BUILD_MINIMAL             3     // pumps only, no display and no network. The schedule counts
+                                        // from power on, the RTC time is never set
+#define BUILD_VARIANT             BUILD_FULL
+#define BUILD_DISPLAY             (BUILD_VARIANT == BUILD_FULL)
+#define BUILD_NETWORK             (BUILD_VARIANT != BUILD_MINIMAL)
+
 // see texts.h for available options
 #define LANG                      'G'   // debug in english, tft as defined here
+#define USE_FONT_SUBSET           0     // 1: fonts.h made by tools/fontsubset.py, only the glyphs of the texts
+#define ICON_BLIT                 1     // 1: icons in blocks with DMA, 0: pixel by pixel, see iconblit.h
 
 #define NUMBER_OF_PUMPS           4
 
@@ -12,6 +23,7 @@
 #define PUMP_2                    22
 #define PUMP_3                    17
 #define PUMP_4                    2
+const uint8_t pumpPins[NUMBER_OF_PUMPS] = {PUMP_1, PUMP_2, PUMP_3, PUMP_4};
 
 // Pin connections for built-in hardware
 #define ADC_EN                    14
@@ -44,8 +56,12 @@ const int mqttPort =              SECRET_MQTT_PORT;
 const char* mqttUser =            SECRET_MQTT_USER;
 const char* mqttPassword =        SECRET_MQTT_PASSWORD;
 
-// timezone
-const char* timezone =            "Europe/Berlin";
+// timezone, POSIX TZ string (here Europe/Berlin)
+const char* timezone =            "CET-1CEST,M3.5.0,M10.5.0/3";
+
+// time servers, all are asked at once and the first valid reply wins, see sntp.h
+const char* sntpServers[] =       {"0.pool.ntp.org", "1.pool.ntp.org", "time.cloudflare.com"};
+#define SNTP_TIMEOUT_MS           1500
 
 // system number
 #define NANNY_NUMBER              '1'   // also change mqttClientID
@@ -59,9 +75,24 @@ const char* timezone =            "Europe/Berlin";
 // pump runs dry below this amount of water
 #define PUMP_RUNS_DRY             200
 
+// tanks, each with its own size, ledger and dry threshold. Tanks after the first one use their
+// number in the preference names and as topic prefix, i.e. "rw2" and "tank2/water-level".
+#define NUMBER_OF_TANKS           1     // up to 9
+const uint8_t pumpTank[NUMBER_OF_PUMPS] =       {0, 0, 0, 0};     // tank of each pump, counts from 0
+const uint16_t tankRunsDry[NUMBER_OF_TANKS] =   {PUMP_RUNS_DRY};  // ml per tank
+
 // water pump througput in milli liter / second
 #define PUMP_BLACK                69  // i.e. 250l/h
 
+// water ledger, correction factor for the pump time based consumption in per mille
+#define LEDGER_CORRECTION_NONE    1000
+#define LEDGER_CORRECTION_MIN     500
+#define LEDGER_CORRECTION_MAX     2000
+#define LEDGER_MIN_CONSUMPTION    500   // ml, smaller refills don't change the correction
+
+// forecast of the remaining water is simulated hour by hour up to this limit
+#define FORECAST_MAX_DAYS         365
+
 // watering frequencies
 #define WATERING_FREQ_OFF         0
 #define WATERING_FREQ_VERY_SELDOM 72    // every third day
@@ -79,6 +110,9 @@ const char* timezone =            "Europe/Berlin";
 #define PREF_CONTAINER_SIZE       "cs"
 #define PREF_REMAINING_WATER      "rw"
 #define PREF_PUMP_THROUGHPUT      "pt"
+#define PREF_WATER_CORRECTION     "wc"
+#define PREF_CONSUMED_SINCE_REFILL "cr"
+#define PREF_REFILLED_SINCE_REFILL "rr"
 #define PREF_P1_WATERING_FREQ     "p1wf"
 #define PREF_P2_WATERING_FREQ     "p2wf"
 #define PREF_P3_WATERING_FREQ     "p3wf"
@@ -91,27 +125,140 @@ const char* timezone =            "Europe/Berlin";
 #define PREF_P2_WATERING_AMOUNT   "p2wa"
 #define PREF_P3_WATERING_AMOUNT   "p3wa"
 #define PREF_P4_WATERING_AMOUNT   "p4wa"
+const char* prefWateringFreq[NUMBER_OF_PUMPS] =   {PREF_P1_WATERING_FREQ, PREF_P2_WATERING_FREQ,
+                                                   PREF_P3_WATERING_FREQ, PREF_P4_WATERING_FREQ};
+const char* prefNextWatering[NUMBER_OF_PUMPS] =   {PREF_P1_NEXT_WATERING, PREF_P2_NEXT_WATERING,
+                                                   PREF_P3_NEXT_WATERING, PREF_P4_NEXT_WATERING};
+const char* prefWateringAmount[NUMBER_OF_PUMPS] = {PREF_P1_WATERING_AMOUNT, PREF_P2_WATERING_AMOUNT,
+                                                   PREF_P3_WATERING_AMOUNT, PREF_P4_WATERING_AMOUNT};
+
+// schedule from the daily water need (command-need), longest single watering in seconds
+#define SCHEDULE_MAX_AMOUNT       6
 
 // default values
 #define DEFAULT_WATERING_FREQ     24    // every day
 #define DEFAULT_WATERING_AMOUNT   2.0   // 2 seconds
 
-// how many seconds of inactivity to go to sleep
+// manual watering: wake up with a button and keep holding it, the pump runs while the button is held
+#define MANUAL_PUMP_TOP           0     // pump 1
+#define MANUAL_PUMP_BOTTOM        1     // pump 2
+#define MANUAL_HOLD_MS            150   // since boot, shorter presses only wake the screen
+#define MANUAL_WATERING_MAX       30    // seconds
+
+// pump jobs, see pumpJobLoop()
+#define PUMP_QUEUE_SIZE           8
+#define PUMP_PAUSE_MS             100   // between two pump runs
+#define WATER_NOW_MAX             30    // seconds, longest run of a water-now command
+
+// local refill: long press of the top button, the bottom button selects the amount in percent
+#define REFILL_LONG_PRESS_MS      1000
+const uint8_t refillPercentages[] = {100, 75, 50, 25};
+#define REFILL_CHOICES            (sizeof(refillPercentages) / sizeof(refillPercentages[0]))
+
+// how many seconds of inactivity to go to sleep, edits on the screens are saved then
+#if BUILD_DISPLAY
 #define INACTIVITY_THRESHOLD      15
+#else
+#define INACTIVITY_THRESHOLD      3     // nobody looks, only time for commands and the pumps
+#endif
+
+// screens besides the main one, the top button switches to the next, see ui.h
+#define UI_FLASH_MS               150   // pressed color of a button
+#define UI_REFRESH_MS             500   // rows that changed are drawn again
+const uint16_t uiFreqChoices[] =      {WATERING_FREQ_OFF, WATERING_FREQ_OFTEN, WATERING_FREQ_NORMAL,
+                                       WATERING_FREQ_SELDOM, WATERING_FREQ_VERY_SELDOM};
+const uint16_t uiContainerChoices[] = {CONTAINER_SIZE_SMALL, CONTAINER_SIZE_TALL, CONTAINER_SIZE_FLAT,
+                                       CONTAINER_SIZE_BIG};
+
+// seconds after the full hour this system wakes up and waters, spreads the connects of a fleet
+#define WAKE_SPREAD               600
+#define WAKE_OFFSET               (((NANNY_NUMBER - '0') * 97) % WAKE_SPREAD)
+
+// the system sleeps till the next pump is due, but wakes at least every n hours to report
+#define SLEEP_MAX_HOURS           6
 
 // drift compensation for esp_sleep_enable_timer_wakeup for one hour in seconds
 #define TIMER_DRIFT_COMPENSATION  27
 
+// static memory mode: buffers of the sketch are sized at compile time and have to fit into
+// the budgets, see budget.h. Heap allocated after setup() is reported as error, with
+// CONFIG_HEAP_USE_HOOKS in the sdkconfig every single allocation, see heapstats.h
+#define STATIC_MEMORY_MODE        1
+#define RAM_BUDGET                4096  // bytes
+#define RTC_BUDGET                4096  // bytes, of 8 kB RTC slow memory
+#define HEAP_STEADY_ABORT         0     // debug: 1 aborts on the first allocation of the loop task after
+                                        // setup, needs CONFIG_HEAP_USE_HOOKS. The core allocates too on
+                                        // the ESP32, meant for the host harness, see tests/nanny.py
+
+// metrics are published every n wakes, see metrics.h
+#define METRICS_EXPORT_WAKES      24
+
+// publish time and cycles per phase of every wake, see profile.h
+#define PROFILE_WAKE              1
+
+// event log in flash, see eventlog.h
+#define EVENT_LOG_BLOCKS          8     // files used round robin
+#define EVENT_LOG_BLOCK_RECORDS   128   // 16 byte records per file
+#define EVENT_LOG_BATCH           16    // records per history message
+#define EVENT_LOG_DAYS            366   // daily aggregates per file
+
+// firmware update over the air, see ota.h. The image is OTA_URL_PREFIX + version + ".bin", a patch
+// against the running image OTA_URL_PREFIX + version + "-" + its ELF SHA-256 prefix + ".patch"
+#define OTA_URL_PREFIX            "http://192.168.1.10:8080/plant-nanny-"
+#define OTA_WAKE_BUDGET_MS        20000 // download time per wake, the rest follows in the next wakes
+#define OTA_DELTA                 1     // 1: a patch against the running image first, see tools/otadelta.py
+
+// logging, see log.h for available levels. LOG_LEVEL_NONE also leaves serial switched off
+#define LOG_LEVEL                 LOG_LEVEL_INFO
+#define LOG_RING_SIZE             64    // records kept in RTC memory, 20 bytes each
+
 // MQTT settings
+#define MQTT_TOPIC_LENGTH         64    // longest complete topic including the terminator
+#define MQTT_VALUE_LENGTH         24    // longest command payload that is evaluated
+#define MQTT_BUFFER_SIZE          384   // PubSubClient packet buffer, longer metrics are split, see metrics.h
+#define MQTT_RECONNECT_MS         5000  // between two reconnects, loop() goes on meanwhile
+#define MQTT_SERIAL_LOOPBACK      0     // 1: commands from and publishes to serial as well, see serialCommandLoop()
+#define MQTT_FAULT_LOSS           0     // percent of messages in and out dropped on purpose, 0 for production
+#define MQTT_TLS                  0     // 1: TLS to the broker, SECRET_MQTT_CA_CERT checks its certificate,
+                                        // the session is resumed across deep sleep.
+                                        // An ECDSA P-256 broker key makes the handshake several times
+                                        // faster than RSA 2048 on the ESP32
+#define MQTT_TLS_TIMEOUT_S        5     // handshake timeout
+#define MQTT_TLS_SESSION_SIZE     1024  // RTC bytes for the session resumed by the next wake, it holds the
+                                        // broker certificate, see tlsclient.h
+
+// status frame over UDP instead of MQTT on timer wakes, see statusudp.h
+#define STATUS_UDP                0     // 1: on, needs the gateway
+#define STATUS_UDP_GATEWAY        "192.168.1.10"
+#define STATUS_UDP_PORT           5683
+#define STATUS_UDP_TIMEOUT_MS     300   // per try
+#define STATUS_UDP_TRIES          3     // then the wake falls back to MQTT
+#define STATUS_UDP_MAX_WAKES      12    // UDP only wakes in a row, then one MQTT wake for text topics and metrics
 const char* mqttClientID =        "PlantNanny1";
 const char* mqttMainTopic =       "plant-nanny";          // followed by /NANNY_NUMBER
 const char* mqttTopicWaterLevel = "water-level";
 const char* mqttTopicBatVoltage = "battery-value";
+const char* mqttTopicHeap =       "heap";                 // heap and stack statistics, see publishHeapStats()
+const char* mqttTopicMetrics =    "metrics";              // all metrics, see metrics.h
+const char* mqttTopicCorrection = "water-correction";     // learned consumption factor, 1.000 = pump time only
+const char* mqttTopicHistory =    "history";              // event log records, see eventlog.h
+const char* mqttTopicLog =        "log";                  // one message per log ring record
+const char* mqttTopicForecast =   "forecast";             // hours till dry,time it runs dry (UTC seconds)
+const char* mqttTopicOta =        "ota";                  // update progress: version,bytes,size,state
+const char* mqttTopicStatus =     "status";               // binary, once per wake, see statusframe.h
+const char* mqttTopicProfile =    "profile";              // time and cycles per phase of the wake, see profile.h
+const char* mqttTopicWaterDone =  "water-done";           // per pump run: pump,requested ms,on ms,remaining water,source
 const char* mqttCmndFreq =        "command-freq";         // per pump command, sets watering-frequency
 const char* mqttCmndNext =        "command-next";         // per pump setting, sets next watering hour
 const char* mqttCmndAmount =      "command-amount";       // per pump command, sets watering-amount
+const char* mqttCmndNeed =        "command-need";         // per pump command, daily water need in ml, sets freq, amount and next
+const char* mqttCmndWaterNow =    "command-water-now";    // per pump command, runs the pump for seconds or "<n>ml"
 const char* mqttCmndContainer =   "command-container";    // sets new container size
 const char* mqttCmndWater =       "command-water";        // resets remaining water
+const char* mqttCmndRefill =      "command-refill";       // tank filled up, payload is the poured amount in ml
+const char* mqttCmndOta =         "command-ota";          // firmware update, payload is the version
+const char* mqttCmndLog =         "command-log";          // publishes the log ring
+const char* mqttCmndHistory =     "command-history";      // publishes the event log, payload from-to
 
 //***************************************************************************************************
 //  user interface
@@ -167,6 +314,8 @@ const char* mqttCmndWater =       "command-water";        // resets remaining wa
 #define COLOR_FG_INFO_BAR         TFT_WHITE
 #define COLOR_FG_STATUS_BAR       TFT_WHITE
 #define COLOR_FG_MAIN_AREA        TFT_BLACK
+#define COLOR_FG_SELECTED         TFT_WHITE                 // selected row of a screen
+#define COLOR_BG_SELECTED         TFT_BLACK
 
 // circle for system number
 #define COLOR_CIRCLE              TFT_NAVY
@@ -0,0 +1,182 @@
+//***************************************************************************************************
+//  sntp:         Minimal SNTP client. sntpBegin() sends one request to each of SNTP_SERVERS at once,
+//                sntpPoll() takes the first valid reply, corrects it by half the round trip and sets
+//                the system clock. After SNTP_TIMEOUT_MS without a valid reply it gives up, the wake
+//                then goes on with the time the RTC kept during deep sleep.
+//                The transmit timestamp of each request holds the send time in micros() and the
+//                server index, the server echoes it as originate timestamp. So a reply is matched to
+//                its request without any state on the wire and stale or forged replies are dropped.
+//                The addresses of the servers are kept in RTC memory, DNS is only asked after power
+//                on and after a wake without any reply. Resolving counts into SNTP_TIMEOUT_MS, no
+//                server is resolved once it has passed. A single lookup that hangs still takes as long
+//                as the DNS timeout of the core, that can happen at most once per failed sync.
+//                The requests go out after all lookups, none if they used up SNTP_TIMEOUT_MS, the
+//                addresses are then kept for the next wake.
+//***************************************************************************************************
+
+#ifndef sntp_h
+#define sntp_h
+
+#include <WiFiUdp.h>
+#include <sys/time.h>
+
+#define SNTP_PORT                 123
+#define SNTP_LOCAL_PORT           2390
+#define SNTP_PACKET_SIZE          48
+#define SNTP_UNIX_OFFSET          2208988800UL    // seconds from 1.1.1900 to 1.1.1970
+#define SNTP_VALID_AFTER          1577836800      // 1.1.2020, the clock is not set before
+
+#define SNTP_SERVER_COUNT         (sizeof(sntpServers) / sizeof(sntpServers[0]))
+
+RTC_DATA_ATTR uint32_t sntpAddresses[SNTP_SERVER_COUNT];     // resolved, 0 if not yet
+
+WiFiUDP sntpUdp;
+uint32_t sntpSentAt[SNTP_SERVER_COUNT];       // micros(), 0 if no request went out
+unsigned long sntpStartedAt;
+bool sntpBusy = false;
+
+uint32_t sntpRead32(const uint8_t* bytes) {
+//***************************************************************************************************
+//  big endian, as everything in NTP
+//***************************************************************************************************
+  return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+void sntpWrite32(uint8_t* bytes, uint32_t value) {
+//***************************************************************************************************
+//  big endian, as everything in NTP
+//***************************************************************************************************
+  bytes[0] = value >> 24;
+  bytes[1] = value >> 16;
+  bytes[2] = value >> 8;
+  bytes[3] = value;
+}
+
+int64_t sntpMicros(const uint8_t* bytes) {
+//***************************************************************************************************
+//  NTP timestamp, seconds since 1900 and 32 bit fraction, to micro seconds since 1970
+//***************************************************************************************************
+  int64_t seconds = (int64_t)sntpRead32(bytes) - SNTP_UNIX_OFFSET;
+  int64_t fraction = ((int64_t)sntpRead32(bytes + 4) * 1000000) >> 32;
+
+  return seconds * 1000000 + fraction;
+}
+
+bool sntpTimeValid() {
+//***************************************************************************************************
+//  system clock set by an earlier sync, it keeps running in deep sleep
+//***************************************************************************************************
+  return time(NULL) > SNTP_VALID_AFTER;
+}
+
+bool sntpBegin() {
+//***************************************************************************************************
+//  one request to every server, needs wifi connection
+//***************************************************************************************************
+  uint8_t packet[SNTP_PACKET_SIZE];
+  IPAddress address;
+  size_t i;
+  int sent = 0;
+
+  sntpStartedAt = millis();
+  if(!sntpUdp.begin(SNTP_LOCAL_PORT)) {
+    LOG_E("SNTP: no UDP socket");
+    return false;
+  }
+  for(i = 0; i < SNTP_SERVER_COUNT; i++) {
+    sntpSentAt[i] = 0;
+    if(sntpAddresses[i] == 0) {
+      if(millis() - sntpStartedAt > SNTP_TIMEOUT_MS) {
+        LOG_W("SNTP: %s not resolved, timeout", sntpServers[i]);
+        continue;
+      }
+      if(WiFi.hostByName(sntpServers[i], address) != 1) {
+        LOG_W("SNTP: %s not resolved", sntpServers[i]);
+        continue;
+      }
+      sntpAddresses[i] = (uint32_t)address;
+    }
+  }
+  // sent after all lookups, a reply waiting in the socket while the next one runs would have its
+  // round trip and the time taken from it off by the lookup
+  for(i = 0; i < SNTP_SERVER_COUNT; i++) {
+    if(sntpAddresses[i] == 0) {
+      continue;
+    }
+    if(millis() - sntpStartedAt > SNTP_TIMEOUT_MS) {
+      LOG_W("SNTP: no time left after DNS");
+      break;
+    }
+    address = IPAddress(sntpAddresses[i]);
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x23;                           // LI 0, version 4, mode 3 (client)
+    sntpSentAt[i] = micros() | 1;               // never 0
+    sntpWrite32(&packet[40], sntpSentAt[i]);
+    sntpWrite32(&packet[44], i);
+    sntpUdp.beginPacket(address, SNTP_PORT);
+    sntpUdp.write(packet, sizeof(packet));
+    if(sntpUdp.endPacket()) {
+      sent++;
+    } else {
+      sntpSentAt[i] = 0;
+    }
+  }
+  if(sent == 0) {
+    sntpUdp.stop();
+    return false;
+  }
+  sntpBusy = true;
+  return true;
+}
+
+bool sntpPoll() {
+//***************************************************************************************************
+//  call until it returns false, sets the clock with the first valid reply
+//***************************************************************************************************
+  uint8_t packet[SNTP_PACKET_SIZE];
+  uint32_t receivedAt;
+  uint32_t index;
+  int64_t serverReceive;
+  int64_t serverTransmit;
+  int64_t roundTrip;
+  int64_t unixMicros;
+  struct timeval now;
+
+  if(!sntpBusy) {
+    return false;
+  }
+  while(sntpUdp.parsePacket() > 0) {
+    receivedAt = micros();
+    if(sntpUdp.read(packet, sizeof(packet)) < SNTP_PACKET_SIZE) {
+      continue;
+    }
+    index = sntpRead32(&packet[28]);
+    if((packet[0] >> 6) == 3 || (packet[0] & 0x07) != 4 || packet[1] == 0 || packet[1] > 15 ||
+       index >= SNTP_SERVER_COUNT || sntpSentAt[index] == 0 || sntpRead32(&packet[24]) != sntpSentAt[index]) {
+      continue;                                 // unsynchronised, kiss of death or not our request
+    }
+    serverReceive = sntpMicros(&packet[32]);
+    serverTransmit = sntpMicros(&packet[40]);
+    roundTrip = (int64_t)(uint32_t)(receivedAt - sntpSentAt[index]) - (serverTransmit - serverReceive);
+    if(roundTrip < 0) {
+      roundTrip = 0;
+    }
+    unixMicros = serverTransmit + roundTrip / 2 + (uint32_t)(micros() - receivedAt);
+    now.tv_sec = unixMicros / 1000000;
+    now.tv_usec = unixMicros % 1000000;
+    settimeofday(&now, NULL);
+    sntpUdp.stop();
+    sntpBusy = false;
+    LOG_I("SNTP: time from %s, round trip %ld us", sntpServers[index], (long)roundTrip);
+    return false;
+  }
+  if(millis() - sntpStartedAt > SNTP_TIMEOUT_MS) {
+    sntpUdp.stop();
+    sntpBusy = false;
+    memset(sntpAddresses, 0, sizeof(sntpAddresses));     // servers may have moved, resolve next wake
+    LOG_W("SNTP: no reply, %s", sntpTimeValid() ? "keeping RTC time" : "time unknown");
+  }
+  return sntpBusy;
+}
+
+#endif
@@ -0,0 +1,37 @@
+//***************************************************************************************************
+//  statusframe:  Binary status message, published once per wake before going to sleep. It holds
+//                what the text topics report, so a collector needs one message per wake and system.
+//                Water figures are those of the first tank, the others report on their text topics.
+//                Little endian as the ESP32, new fields are only appended before the crc and the
+//                version counts up.
+//***************************************************************************************************
+
+#ifndef statusframe_h
+#define statusframe_h
+
+#define STATUS_FRAME_VERSION      2
+
+#define STATUS_FLAG_TANK_EMPTY    0x01  // any of the tanks
+#define STATUS_FLAG_TIMER_WAKE    0x02
+#define STATUS_FLAG_BUTTON_WAKE   0x04
+#define STATUS_FLAG_NO_TIME       0x08  // clock never synchronised, time is seconds since boot
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;                      // STATUS_FRAME_VERSION
+  uint8_t nanny;                        // system number
+  uint32_t time;                        // UTC, seconds since 1.1.1970
+  uint16_t batteryMv;
+  int16_t remainingWater;               // ml
+  uint16_t containerSize;               // ml
+  uint16_t waterCorrection;             // per mille
+  uint16_t nextWatering[NUMBER_OF_PUMPS];   // hours
+  uint8_t flags;                        // STATUS_FLAG_...
+  uint16_t hoursToDry;                  // since version 2, see forecastHoursToDry()
+  uint8_t crc;                          // CRC-8 as in eventlog.h, over all bytes before
+} statusFrame_t;
+
+static_assert(sizeof(statusFrame_t) == 18 + 2 * NUMBER_OF_PUMPS, "statusFrame_t is a message format");
+
+statusFrame_t statusFrame;              // filled by buildStatusFrame()
+
+#endif
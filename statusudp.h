@@ -0,0 +1,111 @@
+//***************************************************************************************************
+//  statusudp:    Status frame as one signed UDP datagram, instead of a TCP connection and MQTT on
+//                timer wakes. A gateway next to the broker answers each datagram and publishes the
+//                frame on the status topic of the system. The datagram is
+//                  'P' 'N' nonce(4) statusFrame_t mac(8)
+//                and the reply is
+//                  'P' 'N' nonce(4) flags(1) mac(8)
+//                with the nonce of the datagram. mac is the first 8 bytes of the HMAC-SHA256 with
+//                SECRET_STATUS_UDP_KEY over all bytes before, little endian as the status frame.
+//                The gateway drops datagrams whose frame time is not newer than the last one of that
+//                system. The datagram goes out right before the deep sleep, with the state after the
+//                pumps. STATUS_UDP_REPLY_COMMANDS tells that commands wait on the broker, the wake
+//                then connects MQTT and takes them from its persistent session as usual, so no
+//                command is carried twice. Without a reply after STATUS_UDP_TRIES the wake uses MQTT.
+//                tools/statusgateway.py is the gateway.
+//***************************************************************************************************
+
+#ifndef statusudp_h
+#define statusudp_h
+
+#include <WiFiUdp.h>
+#include "mbedtls/md.h"
+
+#define STATUS_UDP_LOCAL_PORT     2391
+#define STATUS_UDP_MAC_SIZE       8
+
+#define STATUS_UDP_REPLY_COMMANDS 0x01  // commands for this system are waiting on the broker
+
+#define STATUS_UDP_NO_REPLY       -1    // results of statusUdpExchange()
+#define STATUS_UDP_DONE           0
+#define STATUS_UDP_COMMANDS       1
+
+typedef struct __attribute__((packed)) {
+  uint8_t magic[2];                     // 'P' 'N'
+  uint32_t nonce;
+  statusFrame_t frame;
+  uint8_t mac[STATUS_UDP_MAC_SIZE];
+} statusDatagram_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t magic[2];
+  uint32_t nonce;                       // of the datagram answered
+  uint8_t flags;                        // STATUS_UDP_REPLY_...
+  uint8_t mac[STATUS_UDP_MAC_SIZE];
+} statusReply_t;
+
+RTC_DATA_ATTR uint8_t statusUdpWakes = 0;   // UDP only wakes in a row
+
+WiFiUDP statusUdp;
+
+void statusUdpMac(const void* data, size_t length, uint8_t* mac) {
+//***************************************************************************************************
+//  truncated HMAC-SHA256
+//***************************************************************************************************
+  uint8_t hmac[32];
+
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                  (const uint8_t*)SECRET_STATUS_UDP_KEY, strlen(SECRET_STATUS_UDP_KEY),
+                  (const uint8_t*)data, length, hmac);
+  memcpy(mac, hmac, STATUS_UDP_MAC_SIZE);
+}
+
+int statusUdpExchange(const statusFrame_t* frame) {
+//***************************************************************************************************
+//  sends the frame until a valid reply comes, returns STATUS_UDP_NO_REPLY, _DONE or _COMMANDS
+//***************************************************************************************************
+  statusDatagram_t datagram;
+  statusReply_t reply;
+  uint8_t mac[STATUS_UDP_MAC_SIZE];
+  unsigned long sentAt;
+  int tries;
+
+  if(!statusUdp.begin(STATUS_UDP_LOCAL_PORT)) {
+    LOG_E("Status UDP: no UDP socket");
+    return STATUS_UDP_NO_REPLY;
+  }
+  datagram.magic[0] = 'P';
+  datagram.magic[1] = 'N';
+  datagram.nonce = esp_random();
+  datagram.frame = *frame;
+  statusUdpMac(&datagram, sizeof(datagram) - STATUS_UDP_MAC_SIZE, datagram.mac);
+
+  for(tries = 0; tries < STATUS_UDP_TRIES; tries++) {
+    statusUdp.beginPacket(STATUS_UDP_GATEWAY, STATUS_UDP_PORT);
+    statusUdp.write((const uint8_t*)&datagram, sizeof(datagram));
+    statusUdp.endPacket();
+    sentAt = millis();
+    while(millis() - sentAt < STATUS_UDP_TIMEOUT_MS) {
+      if(statusUdp.parsePacket() <= 0) {
+        delay(1);
+        continue;
+      }
+      if(statusUdp.read((uint8_t*)&reply, sizeof(reply)) != sizeof(reply)) {
+        continue;
+      }
+      statusUdpMac(&reply, sizeof(reply) - STATUS_UDP_MAC_SIZE, mac);
+      if(reply.magic[0] != 'P' || reply.magic[1] != 'N' || reply.nonce != datagram.nonce ||
+         memcmp(mac, reply.mac, STATUS_UDP_MAC_SIZE) != 0) {
+        continue;                       // stale or forged
+      }
+      statusUdp.stop();
+      LOG_I("Status UDP: sent after %d tries, %lu ms", tries + 1, millis() - sentAt);
+      return (reply.flags & STATUS_UDP_REPLY_COMMANDS) ? STATUS_UDP_COMMANDS : STATUS_UDP_DONE;
+    }
+  }
+  statusUdp.stop();
+  LOG_W("Status UDP: no reply from %s", STATUS_UDP_GATEWAY);
+  return STATUS_UDP_NO_REPLY;
+}
+
+#endif
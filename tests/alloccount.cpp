@@ -0,0 +1,105 @@
+//***************************************************************************************************
+//  alloccount:   see alloccount.h. glibc only, the own malloc forwards to __libc_malloc and so on.
+//***************************************************************************************************
+
+#include <malloc.h>
+#include "alloccount.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+// heapstats.h defines them with CONFIG_HEAP_USE_HOOKS
+void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) __attribute__((weak));
+void esp_heap_trace_free_hook(void* ptr) __attribute__((weak));
+}
+
+#define ALLOC_CAPS                (1 << 2)   // MALLOC_CAP_8BIT
+
+static allocCount_t counts;
+
+static void counted(void* ptr) {
+//***************************************************************************************************
+//  new block
+//***************************************************************************************************
+  size_t size;
+
+  if(ptr == NULL) {
+    return;
+  }
+  size = malloc_usable_size(ptr);
+  __atomic_add_fetch(&counts.mallocs, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&counts.blocks, 1, __ATOMIC_RELAXED);
+  if(__atomic_add_fetch(&counts.bytes, size, __ATOMIC_RELAXED) > counts.peakBytes) {
+    counts.peakBytes = counts.bytes;
+  }
+  if(esp_heap_trace_alloc_hook != NULL) {
+    esp_heap_trace_alloc_hook(ptr, size, ALLOC_CAPS);
+  }
+}
+
+static void released(void* ptr) {
+//***************************************************************************************************
+//  block given back
+//***************************************************************************************************
+  if(ptr == NULL) {
+    return;
+  }
+  __atomic_add_fetch(&counts.frees, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&counts.blocks, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&counts.bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+  if(esp_heap_trace_free_hook != NULL) {
+    esp_heap_trace_free_hook(ptr);
+  }
+}
+
+extern "C" void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+
+  counted(ptr);
+  return ptr;
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  void* ptr = __libc_calloc(count, size);
+
+  counted(ptr);
+  return ptr;
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  void* moved;
+
+  // counted as free and malloc, growing a String in place is an allocation all the same
+  released(ptr);
+  moved = __libc_realloc(ptr, size);
+  if(moved == NULL && size > 0) {
+    counted(ptr);                       // the old block is still there
+    return NULL;
+  }
+  counted(moved);
+  return moved;
+}
+
+extern "C" void free(void* ptr) {
+  released(ptr);
+  __libc_free(ptr);
+}
+
+void allocCountReset() {
+//***************************************************************************************************
+//  from here on, blocks and bytes stay as they are
+//***************************************************************************************************
+  counts.mallocs = 0;
+  counts.frees = 0;
+  counts.peakBytes = counts.bytes;
+}
+
+allocCount_t allocCountGet() {
+//***************************************************************************************************
+//  snapshot
+//***************************************************************************************************
+  return counts;
+}
@@ -0,0 +1,29 @@
+//***************************************************************************************************
+//  alloccount:   Counting allocator of the host tests. alloccount.cpp replaces malloc, calloc,
+//                realloc and free of the C library, operator new and String end up there too. Every
+//                call is counted and handed to the heap hooks of heapstats.h if the test defines
+//                them, as the ESP-IDF heap does with CONFIG_HEAP_USE_HOOKS. The heap figures of
+//                host/esp_heap_caps.h come from here.
+//                  allocCountReset();
+//                  ... code under test ...
+//                  CHECK(allocCountGet().mallocs == 0);
+//***************************************************************************************************
+
+#ifndef alloccount_h
+#define alloccount_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+  uint32_t mallocs;                     // malloc, calloc and realloc to a new block since the reset
+  uint32_t frees;
+  uint32_t blocks;                      // allocated right now, not affected by the reset
+  size_t bytes;                         // allocated right now
+  size_t peakBytes;                     // most allocated at once since the reset
+} allocCount_t;
+
+void allocCountReset();
+allocCount_t allocCountGet();
+
+#endif
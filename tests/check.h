@@ -0,0 +1,34 @@
+//***************************************************************************************************
+//  check:        Minimal test macros. CHECK() reports a failed condition and goes on, checkDone()
+//                is the exit code of main().
+//***************************************************************************************************
+
+#ifndef check_h
+#define check_h
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if(!(condition)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      checkFailures++; \
+    } \
+  } while(0)
+
+#define CHECK_TEXT(text, expected) \
+  do { \
+    if(strcmp((text), (expected)) != 0) { \
+      fprintf(stderr, "%s:%d: \"%s\" instead of \"%s\"\n", __FILE__, __LINE__, (text), (expected)); \
+      checkFailures++; \
+    } \
+  } while(0)
+
+static int checkDone(const char* name) {
+  fprintf(stderr, "%s: %s\n", name, checkFailures == 0 ? "ok" : "FAILED");
+  return checkFailures == 0 ? 0 : 1;
+}
+
+#endif
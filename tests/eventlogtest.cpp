@@ -0,0 +1,215 @@
+//***************************************************************************************************
+//  eventlogtest: eventlog.h on the file backed LittleFS of host/storage.cpp: the 24 bit duration,
+//                what is left after a power loss at any point of an append, and the throughput of
+//                appending and streaming a full log.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "check.h"
+#include "alloccount.h"
+#include "secrets.h"
+#include "settings.h"
+#include "log.h"
+#include "format.h"
+#include "eventlog.h"
+
+#define LOG_RECORDS               (EVENT_LOG_BLOCKS * EVENT_LOG_BLOCK_RECORDS)
+#define BENCHMARK_ROUNDS          4
+
+char directory[] = "/tmp/eventlogtest-XXXXXX";
+uint32_t streamed;
+uint32_t streamedFirst;
+uint32_t streamedLast;
+bool streamedInOrder;
+
+event_t watering(uint32_t time, uint32_t ms) {
+  event_t event;
+
+  memset(&event, 0, sizeof(event));
+  event.time = time;
+  event.type = EVENT_WATERING;
+  event.pump = time % NUMBER_OF_PUMPS;
+  event.ml = 50;
+  eventSetDuration(&event, ms);
+  return event;
+}
+
+void count(const uint8_t* data, size_t length) {
+  const event_t* events = (const event_t*)data;
+  size_t i;
+
+  for(i = 0; i < length / sizeof(event_t); i++) {
+    if(streamed > 0 && events[i].time <= streamedLast) {
+      streamedInOrder = false;
+    }
+    if(streamed == 0) {
+      streamedFirst = events[i].time;
+    }
+    streamedLast = events[i].time;
+    streamed++;
+  }
+}
+
+uint32_t streamAll() {
+  streamed = 0;
+  streamedInOrder = true;
+  eventLogStream(0, UINT32_MAX, count);
+  return streamed;
+}
+
+void restart() {
+//***************************************************************************************************
+//  what a reset keeps: the files, not the RAM
+//***************************************************************************************************
+  eventLogMounted = false;
+}
+
+void blockPath(char* path, size_t size, uint8_t block) {
+  char name[16];
+
+  eventLogBlockName(name, sizeof(name), block);
+  snprintf(path, size, "%s/littlefs%s", directory, name);
+}
+
+uint32_t blockRecords(uint8_t block) {
+  char path[128];
+  struct stat status;
+
+  blockPath(path, sizeof(path), block);
+  return stat(path, &status) == 0 ? status.st_size / sizeof(event_t) : 0;
+}
+
+void testDuration() {
+  event_t event;
+
+  memset(&event, 0, sizeof(event));
+  event.durationMs = 40000;             // as written before the high byte, which is 0 then
+  CHECK(eventDuration(&event) == 40000);
+  eventSetDuration(&event, 70000);
+  CHECK(eventDuration(&event) == 70000);
+  CHECK(event.durationMs == 70000 - 65536 && event.durationMsHigh == 1);
+  eventSetDuration(&event, 4 * 3600 * 1000UL);
+  CHECK(eventDuration(&event) == 4 * 3600 * 1000UL);
+  eventSetDuration(&event, UINT32_MAX);
+  CHECK(eventDuration(&event) == EVENT_DURATION_MAX_MS);
+
+  restart();
+  event = watering(1000, 90000);
+  CHECK(eventLogAppend(&event));
+  CHECK(streamAll() == 1);
+}
+
+void testPowerLoss() {
+  char path[128];
+  event_t event;
+  uint32_t time = 2000;
+  uint8_t garbage = 0xFF;
+  int descriptor;
+  int i;
+
+  // torn record: only 7 bytes of the last one made it
+  for(i = 0; i < 10; i++) {
+    event = watering(time++, 1000);
+    eventLogAppend(&event);
+  }
+  blockPath(path, sizeof(path), eventLogHead);
+  CHECK(truncate(path, 11 * sizeof(event_t) - 9) == 0);
+  restart();
+  CHECK(streamAll() == 10);
+  CHECK(streamedLast == time - 2);
+  // the next append overwrites the torn one
+  event = watering(time++, 1000);
+  CHECK(eventLogAppend(&event));
+  CHECK(streamAll() == 11);
+  CHECK(streamedInOrder && streamedLast == time - 1);
+
+  // flash bits flipped in a record, it is skipped and the others are kept
+  descriptor = open(path, O_WRONLY);
+  CHECK(pwrite(descriptor, &garbage, 1, 5 * sizeof(event_t) + 3) == 1);
+  close(descriptor);
+  CHECK(streamAll() == 10);
+  CHECK(streamedInOrder);
+
+  // power lost in a rotation after the next block was removed but before the head file was
+  // written: the full block is found again and rotated once more
+  restart();
+  while(blockRecords(0) < EVENT_LOG_BLOCK_RECORDS) {
+    event = watering(time++, 1000);
+    eventLogAppend(&event);
+  }
+  CHECK(eventLogHead == 0);
+  eventLogRotate();
+  eventLogHead = 0;
+  snprintf(path, sizeof(path), "%s/littlefs%s", directory, EVENT_LOG_HEAD_FILE);
+  descriptor = open(path, O_WRONLY | O_TRUNC);
+  CHECK(write(descriptor, &eventLogHead, 1) == 1);
+  close(descriptor);
+  restart();
+  event = watering(time++, 1000);
+  CHECK(eventLogAppend(&event));
+  CHECK(eventLogHead == 1);
+
+  // head file torn by a power loss in the next rotation, the newest block is head again and nothing
+  // is lost
+  descriptor = open(path, O_WRONLY | O_TRUNC);
+  close(descriptor);
+  restart();
+  i = streamAll();
+  event = watering(time++, 1000);
+  CHECK(eventLogAppend(&event));
+  CHECK(eventLogHead == 1);
+  CHECK(streamAll() == (uint32_t)i + 1);
+  CHECK(streamedInOrder && streamedLast == time - 1);
+}
+
+void benchmark() {
+  event_t event;
+  unsigned long startedAt;
+  unsigned long appendUs;
+  unsigned long streamUs;
+  uint32_t time = 100000;
+  int round;
+  int i;
+
+  restart();
+  event = watering(time, 2000);
+  eventLogAppend(&event);
+  allocCountReset();
+  startedAt = micros();
+  for(round = 0; round < BENCHMARK_ROUNDS; round++) {
+    for(i = 0; i < LOG_RECORDS; i++) {
+      event = watering(++time, 2000);
+      eventLogAppend(&event);
+    }
+  }
+  appendUs = micros() - startedAt;
+  startedAt = micros();
+  for(round = 0; round < BENCHMARK_ROUNDS; round++) {
+    streamAll();
+  }
+  streamUs = micros() - startedAt;
+  CHECK(allocCountGet().mallocs == 0);
+  // a full log, all blocks but the head are full
+  CHECK(streamed > LOG_RECORDS - EVENT_LOG_BLOCK_RECORDS && streamed <= LOG_RECORDS);
+  CHECK(streamedInOrder && streamedLast == time);
+  fprintf(stderr, "append: %.1f us per record, %.0f records/s\n", (double)appendUs / (BENCHMARK_ROUNDS * LOG_RECORDS),
+          1e6 * BENCHMARK_ROUNDS * LOG_RECORDS / appendUs);
+  fprintf(stderr, "stream: %.1f us per full log of %u records, %.0f records/s\n", (double)streamUs / BENCHMARK_ROUNDS,
+          streamed, 1e6 * BENCHMARK_ROUNDS * streamed / streamUs);
+}
+
+int main() {
+  char command[64];
+
+  CHECK(mkdtemp(directory) != NULL);
+  setenv("NANNY_DIR", directory, 1);
+  testDuration();
+  testPowerLoss();
+  benchmark();
+  snprintf(command, sizeof(command), "rm -rf %s", directory);
+  CHECK(system(command) == 0);
+  return checkDone("eventlog");
+}
@@ -0,0 +1,179 @@
+//***************************************************************************************************
+//  formattest:   Edges of format.h and a benchmark against String, both building the topic and the
+//                payloads of one status publish as the sketch did before format.h.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include "check.h"
+#include "alloccount.h"
+#include "format.h"
+
+#define BENCHMARK_ROUNDS          100000
+
+// kept from being optimised away
+volatile size_t sink;
+
+void testEdges() {
+  char buffer[32];
+  char small[6];
+  char guarded[2] = {'\0', '#'};
+
+  buffer[0] = '\0';
+  CHECK(fmtAppendInt(buffer, sizeof(buffer), INT32_MIN));
+  CHECK_TEXT(buffer, "-2147483648");
+  buffer[0] = '\0';
+  fmtAppendInt(buffer, sizeof(buffer), INT32_MAX);
+  CHECK_TEXT(buffer, "2147483647");
+  buffer[0] = '\0';
+  fmtAppendInt(buffer, sizeof(buffer), 0);
+  fmtAppendChar(buffer, sizeof(buffer), ',');
+  fmtAppendInt(buffer, sizeof(buffer), -1);
+  CHECK_TEXT(buffer, "0,-1");
+  buffer[0] = '\0';
+  CHECK(fmtAppendUInt(buffer, sizeof(buffer), UINT32_MAX));
+  CHECK_TEXT(buffer, "4294967295");
+
+  buffer[0] = '\0';
+  fmtAppendPadded(buffer, sizeof(buffer), 7, 2);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendPadded(buffer, sizeof(buffer), -7, 3);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendPadded(buffer, sizeof(buffer), INT32_MIN, 12);
+  CHECK_TEXT(buffer, "07 -007 -2147483648");
+
+  buffer[0] = '\0';
+  fmtAppendFixed(buffer, sizeof(buffer), 3712, 3);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendFixed(buffer, sizeof(buffer), -5, 3);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendFixed(buffer, sizeof(buffer), -1005, 3);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendFixed(buffer, sizeof(buffer), 0, 2);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendFixed(buffer, sizeof(buffer), 12, 0);
+  CHECK_TEXT(buffer, "3.712 -0.005 -1.005 0.00 12");
+  buffer[0] = '\0';
+  fmtAppendFixed(buffer, sizeof(buffer), INT32_MIN, 3);
+  fmtAppendChar(buffer, sizeof(buffer), ' ');
+  fmtAppendFixed(buffer, sizeof(buffer), INT32_MAX, 9);
+  CHECK_TEXT(buffer, "-2147483.648 2.147483647");
+  buffer[0] = '\0';
+  CHECK(!fmtAppendFixed(buffer, sizeof(buffer), 1, 10));
+  CHECK_TEXT(buffer, "");
+  buffer[0] = '\0';
+  fmtAppendUnit(buffer, sizeof(buffer), 3712, 2, "V");
+  CHECK_TEXT(buffer, "37.12 V");
+
+  // exactly full: 5 characters and the terminator
+  small[0] = '\0';
+  CHECK(fmtAppend(small, sizeof(small), "12345"));
+  CHECK_TEXT(small, "12345");
+  CHECK(!fmtAppendChar(small, sizeof(small), '6'));
+  CHECK_TEXT(small, "12345");
+  small[0] = '\0';
+  CHECK(!fmtAppend(small, sizeof(small), "123456"));
+  CHECK_TEXT(small, "12345");
+  small[0] = '\0';
+  CHECK(fmtAppendInt(small, sizeof(small), -1234));
+  CHECK(!fmtAppendInt(small, sizeof(small), 5));
+  CHECK_TEXT(small, "-1234");
+  small[0] = '\0';
+  CHECK(!fmtAppendInt(small, sizeof(small), INT32_MIN));
+  CHECK_TEXT(small, "-2147");
+  small[0] = '\0';
+  CHECK(!fmtAppendFixed(small, sizeof(small), 31415, 4));
+  CHECK_TEXT(small, "3.141");
+  small[0] = '\0';
+  CHECK(!fmtAppendUnit(small, sizeof(small), 3712, 2, "V"));
+  CHECK_TEXT(small, "37.12");
+
+  // no room at all, nothing is written
+  CHECK(!fmtAppend(guarded, 0, "x"));
+  CHECK(!fmtAppendInt(guarded, 0, 1));
+  CHECK(guarded[0] == '\0' && guarded[1] == '#');
+  CHECK(!fmtAppendChar(guarded, 1, 'x'));
+  CHECK(guarded[0] == '\0' && guarded[1] == '#');
+}
+
+size_t statusWithFormat(int round) {
+  char topic[64];
+  char payload[64];
+  size_t length;
+
+  topic[0] = '\0';
+  fmtAppend(topic, sizeof(topic), "plant-nanny/");
+  fmtAppendInt(topic, sizeof(topic), round % 10);
+  fmtAppend(topic, sizeof(topic), "/battery");
+  payload[0] = '\0';
+  fmtAppendUnit(payload, sizeof(payload), 3000 + round % 1000, 3, "V");
+  length = strlen(topic) + strlen(payload);
+
+  topic[0] = '\0';
+  fmtAppend(topic, sizeof(topic), "plant-nanny/");
+  fmtAppendInt(topic, sizeof(topic), round % 10);
+  fmtAppend(topic, sizeof(topic), "/water-level");
+  payload[0] = '\0';
+  fmtAppendInt(payload, sizeof(payload), 1400 - round % 1400);
+  fmtAppendChar(payload, sizeof(payload), ',');
+  fmtAppendInt(payload, sizeof(payload), 2000);
+  fmtAppendChar(payload, sizeof(payload), ',');
+  fmtAppendPadded(payload, sizeof(payload), round % 24, 2);
+  fmtAppendChar(payload, sizeof(payload), ':');
+  fmtAppendPadded(payload, sizeof(payload), round % 60, 2);
+  return length + strlen(topic) + strlen(payload);
+}
+
+size_t statusWithString(int round) {
+  String topic;
+  String payload;
+  size_t length;
+
+  topic = String("plant-nanny/") + String(round % 10) + "/battery";
+  payload = String((3000 + round % 1000) / 1000.0, 3) + " V";
+  length = topic.length() + payload.length();
+
+  topic = String("plant-nanny/") + String(round % 10) + "/water-level";
+  payload = String(1400 - round % 1400) + "," + String(2000) + "," + String(round % 24) + ":" + String(round % 60);
+  return length + topic.length() + payload.length();
+}
+
+void benchmark() {
+  unsigned long startedAt;
+  unsigned long formatUs;
+  unsigned long stringUs;
+  uint32_t formatMallocs;
+  uint32_t stringMallocs;
+  int i;
+
+  allocCountReset();
+  startedAt = micros();
+  for(i = 0; i < BENCHMARK_ROUNDS; i++) {
+    sink = statusWithFormat(i);
+  }
+  formatUs = micros() - startedAt;
+  formatMallocs = allocCountGet().mallocs;
+
+  allocCountReset();
+  startedAt = micros();
+  for(i = 0; i < BENCHMARK_ROUNDS; i++) {
+    sink = statusWithString(i);
+  }
+  stringUs = micros() - startedAt;
+  stringMallocs = allocCountGet().mallocs;
+
+  fprintf(stderr, "format.h: %.3f us and %.1f mallocs per status\n",
+          (double)formatUs / BENCHMARK_ROUNDS, (double)formatMallocs / BENCHMARK_ROUNDS);
+  fprintf(stderr, "String:   %.3f us and %.1f mallocs per status\n",
+          (double)stringUs / BENCHMARK_ROUNDS, (double)stringMallocs / BENCHMARK_ROUNDS);
+  CHECK(formatMallocs == 0);
+  CHECK(stringMallocs >= BENCHMARK_ROUNDS);
+  CHECK(formatUs < stringUs);
+}
+
+int main() {
+  allocCountReset();
+  testEdges();
+  CHECK(allocCountGet().mallocs == 0);
+  benchmark();
+  return checkDone("format");
+}
@@ -0,0 +1,55 @@
+//***************************************************************************************************
+//  heapstatstest: The counting allocator and heapstats.h with the heap hooks on top of it.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <string>
+#include "check.h"
+#include "alloccount.h"
+
+#define CONFIG_HEAP_USE_HOOKS     1
+#include "heapstats.h"
+
+// kept from being optimised away
+void* volatile sink;
+
+int main() {
+  heapStats_t stats;
+  allocCount_t counts;
+  void* kept;
+
+  // the allocator itself
+  allocCountReset();
+  kept = malloc(100);
+  sink = calloc(4, 8);
+  free(sink);
+  sink = new std::string(64, 'x');
+  delete (std::string*)sink;
+  counts = allocCountGet();
+  CHECK(counts.mallocs == 4);           // the string object and its buffer
+  CHECK(counts.frees == 3);
+  sink = realloc(kept, 4000);
+  CHECK(allocCountGet().mallocs == 5);
+  CHECK(allocCountGet().bytes >= counts.bytes + 3900);
+  CHECK(allocCountGet().peakBytes >= allocCountGet().bytes);
+  kept = sink;
+
+  // heapstats.h, net blocks since the start and every allocation after setup
+  heapStatsBegin();
+  sink = malloc(16);
+  heapStatsSetupDone();
+  heapStatsGet(&stats);
+  CHECK(stats.allocations == 1);
+  CHECK(stats.steadyAllocations == 0);
+  free(sink);
+  sink = malloc(32);                    // a pair leaves no net block, the hook sees it anyway
+  free(sink);
+  heapStatsGet(&stats);
+  CHECK(stats.allocations == 0);
+  CHECK(stats.steadyAllocations == 1);
+  CHECK(stats.freeHeap > 0 && stats.minFreeHeap <= stats.freeHeap);
+  CHECK(stats.minFreeHeapEver == stats.minFreeHeap);
+  free(kept);
+
+  return checkDone("heapstats");
+}
@@ -0,0 +1,125 @@
+//***************************************************************************************************
+//  Arduino:      Host stand-in for the parts of the Arduino ESP32 core the sketch uses, so the
+//                headers and the whole sketch compile and run on Linux for the tests. Time is the
+//                real monotonic clock, Serial goes to stdout and counts the bytes it would have sent
+//                at 115200 baud, it reads from stdin. RTC_DATA_ATTR variables are put together in one
+//                section, deep sleep keeps them in a file, see esp_system.h.
+//***************************************************************************************************
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+// settings.h has its own timezone
+#define timezone glibc_timezone
+#include <time.h>
+#include <sys/time.h>
+#undef timezone
+
+#include "esp_system.h"
+#include "WString.h"
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PSTR(s)                   (s)
+#define F(s)                      (s)
+#define pgm_read_byte(address)    (*(const uint8_t*)(address))
+#define RTC_DATA_ATTR             __attribute__((section("rtc_data")))
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+
+#define HIGH                      1
+#define LOW                       0
+#define INPUT                     0x01
+#define OUTPUT                    0x03
+#define INPUT_PULLUP              0x05
+
+#define constrain(amount, low, high) ((amount) < (low) ? (low) : ((amount) > (high) ? (high) : (amount)))
+
+template<class T> T min(T a, T b) { return a < b ? a : b; }
+template<class T> T max(T a, T b) { return a > b ? a : b; }
+long random(long limit);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// pins, the last level written is kept and read back, inputs read high (buttons not pressed)
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+uint8_t hostPinLevel(uint8_t pin);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+  size_t print(const char* text) { return write(text); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return print((long)value); }
+  size_t print(unsigned value) { return print((unsigned long)value); }
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t print(double value, int digits = 2);
+  size_t println() { return write("\r\n"); }
+  template<class T> size_t println(T value) { return print(value) + println(); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+  void setTimeout(unsigned long ms) {}
+  size_t readBytesUntil(char terminator, char* buffer, size_t length);
+};
+
+class HardwareSerial : public Stream {
+public:
+  size_t sent = 0;                      // bytes written since begin()
+  bool quiet = false;                   // true: only count, nothing to stdout
+
+  void begin(unsigned long baud) { this->baud = baud; sent = 0; }
+  void end() {}
+  operator bool() { return true; }
+  int read() override;                  // stdin, without waiting
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  uint32_t sentUs() { return baud > 0 ? (uint32_t)((uint64_t)sent * 10 * 1000000 / baud) : 0; }
+
+private:
+  unsigned long baud = 0;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getCycleCount();             // nanoseconds as 1 GHz cycles
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getHeapSize();
+  uint32_t getMaxAllocHeap();
+  uint32_t getSketchSize() { return 0; }
+  uint32_t getFreeSketchSpace() { return 0; }
+  const char* getSdkVersion() { return "host"; }
+  void restart();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,31 @@
+//***************************************************************************************************
+//  Button2:      Host stand-in of the button library, the handlers are kept but never called, the
+//                buttons are never pressed.
+//***************************************************************************************************
+
+#ifndef Button2_h
+#define Button2_h
+
+#include <Arduino.h>
+
+class Button2 {
+public:
+  typedef void (*CallbackFunction)(Button2& button);
+
+  Button2(uint8_t pin) : pin(pin) {}
+  void setPressedHandler(CallbackFunction handler) { pressed = handler; }
+  void setReleasedHandler(CallbackFunction handler) { released = handler; }
+  void setLongClickHandler(CallbackFunction handler) { longClick = handler; }
+  void setLongClickTime(unsigned int ms) {}
+  void loop() {}
+  bool isPressed() { return false; }
+  unsigned int wasPressedFor() { return 0; }
+
+private:
+  uint8_t pin;
+  CallbackFunction pressed = NULL;
+  CallbackFunction released = NULL;
+  CallbackFunction longClick = NULL;
+};
+
+#endif
@@ -0,0 +1,41 @@
+//***************************************************************************************************
+//  HTTPClient:   Host stand-in of the HTTP client, GET of a http:// URL with extra headers over the
+//                given WiFiClient, the body is read from the client as on the ESP32. Connection:
+//                close, no redirects, no chunked bodies.
+//***************************************************************************************************
+
+#ifndef HTTPClient_h
+#define HTTPClient_h
+
+#include "WiFi.h"
+
+#define HTTP_CODE_OK              200
+#define HTTP_CODE_PARTIAL_CONTENT 206
+#define HTTP_CODE_NOT_FOUND       404
+#define HTTPC_ERROR_CONNECTION_REFUSED -1
+#define HTTPC_ERROR_NOT_CONNECTED -4
+#define HTTPC_ERROR_READ_TIMEOUT  -11
+
+class HTTPClient {
+public:
+  bool begin(WiFiClient& client, const char* url);
+  void addHeader(const char* name, const char* value);
+  int GET();
+  int getSize() { return size; }
+  WiFiClient* getStreamPtr() { return client; }
+  void end();
+  void setTimeout(uint16_t ms) { timeoutMs = ms; }
+
+private:
+  WiFiClient* client = NULL;
+  char host[64] = "";
+  uint16_t port = 80;
+  char path[128] = "";
+  char headers[256] = "";
+  int size = -1;
+  uint16_t timeoutMs = 5000;
+
+  bool readLine(char* line, size_t length);
+};
+
+#endif
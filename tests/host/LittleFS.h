@@ -0,0 +1,57 @@
+//***************************************************************************************************
+//  LittleFS:     Host stand-in of LittleFS on the spiffs partition, a directory NANNY_DIR/littlefs.
+//                File wraps a file descriptor, so opening and closing does not allocate. A File can
+//                be moved but not copied, it closes itself at the end.
+//***************************************************************************************************
+
+#ifndef LittleFS_h
+#define LittleFS_h
+
+#include <Arduino.h>
+
+#define SeekSet                   0
+#define SeekCur                   1
+#define SeekEnd                   2
+
+class File : public Stream {
+public:
+  File(int descriptor = -1) : descriptor(descriptor) {}
+  File(File&& other) : descriptor(other.descriptor) { other.descriptor = -1; }
+  File& operator=(File&& other) { close(); descriptor = other.descriptor; other.descriptor = -1; return *this; }
+  File(const File&) = delete;
+  ~File() { close(); }
+
+  operator bool() const { return descriptor >= 0; }
+  size_t size();
+  size_t position();
+  bool seek(uint32_t position, int mode = SeekSet);
+  size_t read(uint8_t* buffer, size_t size);
+  int read() override;
+  int available() override;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void flush() override {}
+  void close();
+
+private:
+  int descriptor;
+};
+
+class LittleFSFS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs");
+  File open(const char* path, const char* mode = "r", bool create = false);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+  size_t totalBytes() { return 1408 * 1024; }
+
+private:
+  const char* fullPath(char* path, size_t size, const char* name);
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
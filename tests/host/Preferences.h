@@ -0,0 +1,39 @@
+//***************************************************************************************************
+//  Preferences:  Host stand-in of the NVS preferences, unsigned values only as the sketch uses
+//                them. Each name space is a file NANNY_DIR/nvs-<name>, read by begin() and written by
+//                end() if something changed. The table is fixed, no allocation after the start.
+//***************************************************************************************************
+
+#ifndef Preferences_h
+#define Preferences_h
+
+#include <Arduino.h>
+
+#define PREFERENCES_KEYS          64
+#define PREFERENCES_KEY_LENGTH    16    // as NVS, including the terminator
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  size_t putUInt(const char* key, uint32_t value);
+  bool isKey(const char* key);
+  bool remove(const char* key);
+
+private:
+  typedef struct {
+    char key[PREFERENCES_KEY_LENGTH];
+    uint32_t value;
+  } entry_t;
+
+  entry_t entries[PREFERENCES_KEYS];
+  int count = 0;
+  char name[PREFERENCES_KEY_LENGTH] = "";
+  bool opened = false;
+  bool changed = false;
+
+  int find(const char* key);
+};
+
+#endif
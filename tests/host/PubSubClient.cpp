@@ -0,0 +1,333 @@
+//***************************************************************************************************
+//  PubSubClient: see PubSubClient.h. The packet is built behind 5 bytes of room for the fixed
+//                header, which is put in front when it is sent, as the original does.
+//***************************************************************************************************
+
+#include "PubSubClient.h"
+
+#define MQTT_HEADER_ROOM          5
+#define MQTT_CONNECT              0x10
+#define MQTT_CONNACK              0x20
+#define MQTT_PUBLISH              0x30
+#define MQTT_PUBACK               0x40
+#define MQTT_SUBSCRIBE            0x80
+#define MQTT_SUBACK               0x90
+#define MQTT_PINGREQ              0xC0
+#define MQTT_PINGRESP             0xD0
+#define MQTT_DISCONNECT           0xE0
+
+PubSubClient::PubSubClient(Client& client) : client(&client), buffer(NULL) {
+  setBufferSize(MQTT_MAX_PACKET_SIZE);
+}
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  this->domain = domain;
+  this->port = port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  this->callback = callback;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  uint8_t* resized;
+
+  if(size == 0) {
+    return false;
+  }
+  resized = (uint8_t*)realloc(buffer, size);
+  if(resized == NULL) {
+    return false;
+  }
+  buffer = resized;
+  bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  return connect(id, user, pass, NULL, 0, false, NULL, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic,
+                           uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession) {
+  const uint8_t protocol[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+  size_t length = MQTT_HEADER_ROOM;
+  uint8_t flags = 0;
+  uint8_t header;
+
+  if(connected()) {
+    return true;
+  }
+  if(domain == NULL || !client->connect(domain, port)) {
+    connectionState = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  nextMessageId = 1;
+  memcpy(buffer + length, protocol, sizeof(protocol));
+  length += sizeof(protocol);
+  if(willTopic != NULL) {
+    flags = 0x04 | (willQos << 3) | (willRetain ? 0x20 : 0);
+  }
+  if(cleanSession) {
+    flags |= 0x02;
+  }
+  if(user != NULL) {
+    flags |= 0x80;
+    if(pass != NULL) {
+      flags |= 0x40;
+    }
+  }
+  buffer[length++] = flags;
+  buffer[length++] = keepAlive >> 8;
+  buffer[length++] = keepAlive & 0xFF;
+  length = writeString(id, length);
+  if(willTopic != NULL) {
+    length = writeString(willTopic, length);
+    length = writeString(willMessage, length);
+  }
+  if(user != NULL) {
+    length = writeString(user, length);
+    if(pass != NULL) {
+      length = writeString(pass, length);
+    }
+  }
+  if(length == 0 || !writePacket(MQTT_CONNECT, length - MQTT_HEADER_ROOM)) {
+    client->stop();
+    connectionState = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  lastInActivity = lastOutActivity = millis();
+  // session present and return code
+  if(readPacket(&header) == 3 && header == MQTT_CONNACK && buffer[2] == 0) {
+    pingOutstanding = false;
+    connectionState = MQTT_CONNECTED;
+    return true;
+  }
+  connectionState = header == MQTT_CONNACK ? buffer[2] : MQTT_CONNECTION_TIMEOUT;
+  client->stop();
+  return false;
+}
+
+void PubSubClient::disconnect() {
+  buffer[0] = MQTT_DISCONNECT;
+  buffer[1] = 0;
+  client->write(buffer, 2);
+  connectionState = MQTT_DISCONNECTED;
+  client->flush();
+  client->stop();
+  lastInActivity = lastOutActivity = millis();
+}
+
+bool PubSubClient::connected() {
+  if(client->connected()) {
+    return connectionState == MQTT_CONNECTED;
+  }
+  if(connectionState == MQTT_CONNECTED) {
+    connectionState = MQTT_CONNECTION_LOST;
+    client->stop();
+  }
+  return false;
+}
+
+bool PubSubClient::readByte(uint8_t* c) {
+//***************************************************************************************************
+//  waits for it at most socketTimeout
+//***************************************************************************************************
+  unsigned long startedAt = millis();
+  int value;
+
+  while((value = client->read()) < 0) {
+    if(millis() - startedAt >= socketTimeout * 1000UL || !client->connected()) {
+      return false;
+    }
+    delay(1);
+  }
+  *c = value;
+  return true;
+}
+
+uint32_t PubSubClient::readPacket(uint8_t* header) {
+//***************************************************************************************************
+//  a whole packet into buffer, the remaining length behind the type byte is skipped. Returns the
+//  length, 0 if it failed or did not fit
+//***************************************************************************************************
+  uint32_t length = 0;
+  uint32_t multiplier = 1;
+  uint32_t i;
+  uint8_t c;
+
+  *header = 0;
+  if(!readByte(header)) {
+    return 0;
+  }
+  buffer[0] = *header;
+  do {
+    if(multiplier > 128 * 128 * 128 || !readByte(&c)) {
+      return 0;
+    }
+    length += (c & 0x7F) * multiplier;
+    multiplier *= 128;
+  } while(c & 0x80);
+  for(i = 0; i < length; i++) {
+    if(!readByte(&c)) {
+      return 0;
+    }
+    if(i + 1 < bufferSize) {
+      buffer[i + 1] = c;
+    }
+  }
+  lastInActivity = millis();
+  return length + 1 <= bufferSize ? length + 1 : 0;
+}
+
+size_t PubSubClient::writeString(const char* text, size_t position) {
+//***************************************************************************************************
+//  length prefixed, 0 if it doesn't fit
+//***************************************************************************************************
+  size_t length = strlen(text);
+
+  if(position == 0 || position + 2 + length > bufferSize) {
+    return 0;
+  }
+  buffer[position++] = length >> 8;
+  buffer[position++] = length & 0xFF;
+  memcpy(buffer + position, text, length);
+  return position + length;
+}
+
+bool PubSubClient::writePacket(uint8_t header, size_t length) {
+//***************************************************************************************************
+//  the fixed header goes right before the variable part at MQTT_HEADER_ROOM
+//***************************************************************************************************
+  uint8_t encoded[4];
+  size_t count = 0;
+  size_t rest = length;
+  size_t start;
+
+  do {
+    encoded[count] = rest % 128;
+    rest /= 128;
+    if(rest > 0) {
+      encoded[count] |= 0x80;
+    }
+    count++;
+  } while(rest > 0 && count < sizeof(encoded));
+  start = MQTT_HEADER_ROOM - 1 - count;
+  buffer[start] = header;
+  memcpy(buffer + start + 1, encoded, count);
+  lastOutActivity = millis();
+  return client->write(buffer + start, length + 1 + count) == length + 1 + count;
+}
+
+bool PubSubClient::loop() {
+//***************************************************************************************************
+//  keep alive and every packet that is waiting
+//***************************************************************************************************
+  uint8_t header;
+  uint32_t length;
+  uint16_t topicLength;
+  uint16_t messageId;
+  size_t payloadStart;
+
+  if(!connected()) {
+    return false;
+  }
+  if(millis() - lastInActivity > keepAlive * 1000UL || millis() - lastOutActivity > keepAlive * 1000UL) {
+    if(pingOutstanding) {
+      connectionState = MQTT_CONNECTION_TIMEOUT;
+      client->stop();
+      return false;
+    }
+    buffer[0] = MQTT_PINGREQ;
+    buffer[1] = 0;
+    client->write(buffer, 2);
+    lastOutActivity = lastInActivity = millis();
+    pingOutstanding = true;
+  }
+  while(client->available() > 0) {
+    length = readPacket(&header);
+    if(length == 0) {
+      if(!client->connected()) {
+        return false;
+      }
+      continue;
+    }
+    switch(header & 0xF0) {
+      case MQTT_PUBLISH:
+        // header, one or more length bytes, topic length, topic, message id with QoS 1, payload
+        topicLength = (buffer[1] << 8) | buffer[2];
+        if(3 + (uint32_t)topicLength > length) {
+          break;
+        }
+        memmove(buffer + 2, buffer + 3, topicLength);
+        buffer[2 + topicLength] = '\0';
+        payloadStart = 3 + topicLength;
+        if((header & 0x06) == 0x02) {
+          messageId = (buffer[payloadStart] << 8) | buffer[payloadStart + 1];
+          payloadStart += 2;
+        } else {
+          messageId = 0;
+        }
+        if(callback) {
+          callback((char*)buffer + 2, buffer + payloadStart, length - payloadStart);
+        }
+        if(messageId != 0) {
+          buffer[0] = MQTT_PUBACK;
+          buffer[1] = 2;
+          buffer[2] = messageId >> 8;
+          buffer[3] = messageId & 0xFF;
+          client->write(buffer, 4);
+          lastOutActivity = millis();
+        }
+        break;
+      case MQTT_PINGREQ:
+        buffer[0] = MQTT_PINGRESP;
+        buffer[1] = 0;
+        client->write(buffer, 2);
+        break;
+      case MQTT_PINGRESP:
+        pingOutstanding = false;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  size_t length = MQTT_HEADER_ROOM;
+
+  if(qos > 1 || !connected()) {
+    return false;
+  }
+  nextMessageId = nextMessageId == 0xFFFF ? 1 : nextMessageId + 1;
+  buffer[length++] = nextMessageId >> 8;
+  buffer[length++] = nextMessageId & 0xFF;
+  length = writeString(topic, length);
+  if(length == 0 || length + 1 > bufferSize) {
+    return false;
+  }
+  buffer[length++] = qos;
+  return writePacket(MQTT_SUBSCRIBE | 0x02, length - MQTT_HEADER_ROOM);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload != NULL ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  size_t position;
+
+  if(!connected()) {
+    return false;
+  }
+  position = writeString(topic, MQTT_HEADER_ROOM);
+  if(position == 0 || position + length > bufferSize) {
+    return false;
+  }
+  memcpy(buffer + position, payload, length);
+  return writePacket(MQTT_PUBLISH | (retained ? 0x01 : 0), position + length - MQTT_HEADER_ROOM);
+}
@@ -0,0 +1,71 @@
+//***************************************************************************************************
+//  PubSubClient: Host stand-in of the MQTT 3.1.1 client by Nick O'Leary with the same interface and
+//                behaviour as far as the sketch sees it: one packet buffer of setBufferSize() bytes
+//                for sending and receiving, QoS 0 publishes, QoS 0 and 1 subscriptions, incoming
+//                QoS 1 acknowledged after the callback, keep alive pings from loop().
+//***************************************************************************************************
+
+#ifndef PubSubClient_h
+#define PubSubClient_h
+
+#include <functional>
+#include "WiFi.h"
+
+#define MQTT_KEEPALIVE            15    // seconds
+#define MQTT_SOCKET_TIMEOUT       15    // seconds
+#define MQTT_MAX_PACKET_SIZE      256
+
+#define MQTT_CONNECTION_TIMEOUT   -4
+#define MQTT_CONNECTION_LOST      -3
+#define MQTT_CONNECT_FAILED       -2
+#define MQTT_DISCONNECTED         -1
+#define MQTT_CONNECTED            0
+
+#define MQTT_CALLBACK_SIGNATURE   std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+public:
+  PubSubClient(Client& client);
+  ~PubSubClient() { free(buffer); }
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient& setClient(Client& client) { this->client = &client; return *this; }
+  PubSubClient& setKeepAlive(uint16_t seconds) { keepAlive = seconds; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t seconds) { socketTimeout = seconds; return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return bufferSize; }
+
+  bool connect(const char* id, const char* user, const char* pass);
+  bool connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+               bool willRetain, const char* willMessage, bool cleanSession);
+  void disconnect();
+  bool connected();
+  int state() { return connectionState; }
+  bool loop();
+  bool subscribe(const char* topic, uint8_t qos = 0);
+  bool publish(const char* topic, const char* payload, bool retained = false);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+
+private:
+  Client* client;
+  const char* domain = NULL;
+  uint16_t port = 1883;
+  std::function<void(char*, uint8_t*, unsigned int)> callback;
+  uint8_t* buffer;
+  uint16_t bufferSize = 0;
+  uint16_t keepAlive = MQTT_KEEPALIVE;
+  uint16_t socketTimeout = MQTT_SOCKET_TIMEOUT;
+  uint16_t nextMessageId = 1;
+  unsigned long lastOutActivity = 0;
+  unsigned long lastInActivity = 0;
+  bool pingOutstanding = false;
+  int connectionState = MQTT_DISCONNECTED;
+
+  bool readByte(uint8_t* c);
+  uint32_t readPacket(uint8_t* header);
+  size_t writeString(const char* text, size_t position);
+  bool writePacket(uint8_t header, size_t length);
+};
+
+#endif
@@ -0,0 +1,84 @@
+//***************************************************************************************************
+//  TFT_eSPI:     Host stand-in of the display library, nothing is drawn. Text widths are those of
+//                FONT2, 8 pixels a character, the free fonts are empty and only there to be pointed
+//                to, see display.cpp.
+//***************************************************************************************************
+
+#ifndef TFT_eSPI_h
+#define TFT_eSPI_h
+
+#include <Arduino.h>
+
+#define TFT_WIDTH                 135
+#define TFT_HEIGHT                240
+
+#define TL_DATUM                  0
+#define TC_DATUM                  1
+#define TR_DATUM                  2
+#define ML_DATUM                  3
+#define MC_DATUM                  4
+#define MR_DATUM                  5
+
+#define TFT_BLACK                 0x0000
+#define TFT_NAVY                  0x000F
+#define TFT_DARKGREEN             0x03E0
+#define TFT_MAROON                0x7800
+#define TFT_OLIVE                 0x7BE0
+#define TFT_DARKGREY              0x7BEF
+#define TFT_SKYBLUE               0x867D
+#define TFT_LIGHTGREY             0xD69A
+#define TFT_GREEN                 0x07E0
+#define TFT_RED                   0xF800
+#define TFT_ORANGE                0xFDA0
+#define TFT_YELLOW                0xFFE0
+#define TFT_WHITE                 0xFFFF
+
+typedef struct {
+  uint16_t bitmapOffset;
+  uint8_t width, height, xAdvance;
+  int8_t xOffset, yOffset;
+} GFXglyph;
+
+typedef struct {
+  uint8_t* bitmap;
+  GFXglyph* glyph;
+  uint16_t first, last;
+  uint8_t yAdvance;
+} GFXfont;
+
+extern const GFXfont FreeSans9pt7b;
+extern const GFXfont FreeSans12pt7b;
+extern const GFXfont FreeSans18pt7b;
+extern const GFXfont FreeSans24pt7b;
+
+class TFT_eSPI : public Print {
+public:
+  void init() {}
+  void setRotation(uint8_t rotation) {}
+  void writecommand(uint8_t command) {}
+  void fillScreen(uint32_t color) {}
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {}
+  void fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color) {}
+  void drawXBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color) {}
+  void drawXBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color,
+                   uint16_t background) {}
+  void setTextColor(uint16_t color) {}
+  void setTextColor(uint16_t color, uint16_t background) {}
+  void setTextDatum(uint8_t datum) {}
+  void setFreeFont(const GFXfont* font) {}
+  void setTextFont(uint8_t font) {}
+  int16_t fontHeight(int16_t font = 1) { return 16; }
+  int16_t textWidth(const char* text, uint8_t font = 1) { return strlen(text) * 8; }
+  int16_t drawString(const char* text, int32_t x, int32_t y) { return textWidth(text); }
+  int16_t drawString(const char* text, int32_t x, int32_t y, uint8_t font) { return textWidth(text); }
+  int16_t drawString(const String& text, int32_t x, int32_t y, uint8_t font = 1) { return textWidth(text.c_str()); }
+  size_t write(uint8_t c) override { return 1; }
+
+  bool initDMA(bool ctrl = false) { return true; }
+  void dmaWait() {}
+  void startWrite() {}
+  void endWrite() {}
+  void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* image, uint16_t* buffer = nullptr) {}
+};
+
+#endif
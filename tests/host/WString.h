@@ -0,0 +1,86 @@
+//***************************************************************************************************
+//  WString:      Host stand-in of the Arduino String, with the allocations of the ESP32 core: texts
+//                up to 10 characters live in the object itself, longer ones on the heap, which
+//                grows with realloc on every concat that does not fit. Numbers are converted in a
+//                stack buffer, floats in a heap one. Only what the tests need.
+//***************************************************************************************************
+
+#ifndef WString_h
+#define WString_h
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+class String {
+public:
+  String(const char* text = "") { copy(text, strlen(text)); }
+  String(const String& other) { copy(other.c_str(), other.len); }
+  String(char c) { char text[2] = {c, '\0'}; copy(text, 1); }
+  String(int value) { number("%ld", (long)value); }
+  String(unsigned int value) { number("%lu", (unsigned long)value); }
+  String(long value) { number("%ld", value); }
+  String(unsigned long value) { number("%lu", value); }
+  String(double value, unsigned int decimals = 2) {
+    char* text = (char*)malloc(decimals + 42);
+
+    snprintf(text, decimals + 42, "%.*f", decimals, value);
+    copy(text, strlen(text));
+    free(text);
+  }
+  ~String() { if(heap != NULL) free(heap); }
+
+  String& operator=(const String& other) { if(this != &other) { len = 0; concat(other.c_str(), other.len); } return *this; }
+  String& operator+=(const String& other) { concat(other.c_str(), other.len); return *this; }
+  String& operator+=(const char* text) { concat(text, strlen(text)); return *this; }
+  bool concat(const String& other) { return concat(other.c_str(), other.len); }
+  bool concat(const char* text) { return concat(text, strlen(text)); }
+  bool concat(int value) { return concat(String(value)); }
+
+  const char* c_str() const { return heap != NULL ? heap : sso; }
+  unsigned int length() const { return len; }
+  bool operator==(const char* text) const { return strcmp(c_str(), text) == 0; }
+
+  friend String operator+(const String& a, const String& b) { String sum(a); sum += b; return sum; }
+  friend String operator+(const String& a, const char* b) { String sum(a); sum += b; return sum; }
+
+private:
+  enum { SSO_SIZE = 11 };
+  char sso[SSO_SIZE];
+  char* heap = NULL;
+  unsigned int capacity = SSO_SIZE - 1;
+  unsigned int len = 0;
+
+  void copy(const char* text, unsigned int length) {
+    sso[0] = '\0';
+    concat(text, length);
+  }
+
+  template<class T> void number(const char* format, T value) {
+    char text[24];
+
+    snprintf(text, sizeof(text), format, value);
+    copy(text, strlen(text));
+  }
+
+  bool concat(const char* text, unsigned int length) {
+    if(len + length > capacity) {
+      char* grown = (char*)realloc(heap, len + length + 1);
+
+      if(grown == NULL) {
+        return false;
+      }
+      if(heap == NULL) {
+        memcpy(grown, sso, len + 1);
+      }
+      heap = grown;
+      capacity = len + length;
+    }
+    memmove((char*)c_str() + len, text, length);
+    len += length;
+    ((char*)c_str())[len] = '\0';
+    return true;
+  }
+};
+
+#endif
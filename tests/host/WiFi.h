@@ -0,0 +1,91 @@
+//***************************************************************************************************
+//  WiFi:         Host stand-in of WiFi and WiFiClient. The station is connected at once, unless
+//                NANNY_WIFI=off. Names resolve only through NANNY_HOSTS, i.e.
+//                "broker=127.0.0.1,0.pool.ntp.org=127.0.0.1", so a test never reaches the real
+//                network. NANNY_PORTS maps the ports connected to, i.e. "123=40123,1883=41883", for
+//                stand-in servers that can't listen on the real ones. NANNY_DNS_MS is the time every
+//                lookup of a name takes. WiFiClient is a TCP socket.
+//***************************************************************************************************
+
+#ifndef WiFi_h
+#define WiFi_h
+
+#include <Arduino.h>
+
+#define WIFI_OFF                  0
+#define WIFI_STA                  1
+#define WL_IDLE_STATUS            0
+#define WL_CONNECTED              3
+#define WL_DISCONNECTED           6
+
+class IPAddress {
+public:
+  IPAddress() : address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { uint8_t bytes[4] = {a, b, c, d}; memcpy(&address, bytes, 4); }
+  IPAddress(uint32_t address) : address(address) {}
+  operator uint32_t() const { return address; }        // first byte lowest, as the ESP32 core
+
+private:
+  uint32_t address;
+};
+
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t* buffer, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
+
+class WiFiClass {
+public:
+  void mode(int mode) {}
+  int begin(const char* ssid, const char* password);
+  int status() { return connectedStatus; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  int hostByName(const char* host, IPAddress& address);
+  bool disconnect(bool wifiOff = false, bool eraseAp = false) { connectedStatus = WL_DISCONNECTED; return true; }
+  int8_t RSSI() { return -60; }
+
+private:
+  int connectedStatus = WL_IDLE_STATUS;
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Client {
+public:
+  WiFiClient() {}
+  WiFiClient(const WiFiClient&) = delete;
+  ~WiFiClient() { stop(); }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buffer, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+private:
+  int socket = -1;
+};
+
+// for the stand-ins of WiFiUdp.h and HTTPClient.h
+uint16_t hostPort(uint16_t port);
+
+#endif
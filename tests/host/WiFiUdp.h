@@ -0,0 +1,47 @@
+//***************************************************************************************************
+//  WiFiUdp:      Host stand-in of WiFiUDP on a UDP socket. begin() takes any free local port, tests
+//                run side by side. Destinations go through NANNY_HOSTS and NANNY_PORTS, see WiFi.h.
+//***************************************************************************************************
+
+#ifndef WiFiUdp_h
+#define WiFiUdp_h
+
+#include "WiFi.h"
+
+#define WIFI_UDP_PACKET_SIZE      1460
+
+class WiFiUDP : public Stream {
+public:
+  WiFiUDP() {}
+  WiFiUDP(const WiFiUDP&) = delete;
+  ~WiFiUDP() { stop(); }
+
+  uint8_t begin(uint16_t port);
+  void stop();
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacket(const char* host, uint16_t port);
+  int endPacket();
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int parsePacket();
+  int available() override { return rxLength - rxPosition; }
+  int read() override;
+  int read(uint8_t* buffer, size_t size);
+  IPAddress remoteIP() { return remoteAddress; }
+  uint16_t remotePort() { return remotePortNumber; }
+
+private:
+  int socket = -1;
+  uint32_t txAddress = 0;
+  uint16_t txPort = 0;
+  uint8_t txBuffer[WIFI_UDP_PACKET_SIZE];
+  size_t txLength = 0;
+  uint8_t rxBuffer[WIFI_UDP_PACKET_SIZE];
+  size_t rxLength = 0;
+  size_t rxPosition = 0;
+  IPAddress remoteAddress;
+  uint16_t remotePortNumber = 0;
+};
+
+#endif
@@ -0,0 +1,10 @@
+//***************************************************************************************************
+//  display:      The free fonts of the TFT_eSPI stand-in, without glyphs.
+//***************************************************************************************************
+
+#include "TFT_eSPI.h"
+
+const GFXfont FreeSans9pt7b = {NULL, NULL, 0x20, 0x7E, 22};
+const GFXfont FreeSans12pt7b = {NULL, NULL, 0x20, 0x7E, 29};
+const GFXfont FreeSans18pt7b = {NULL, NULL, 0x20, 0x7E, 42};
+const GFXfont FreeSans24pt7b = {NULL, NULL, 0x20, 0x7E, 56};
@@ -0,0 +1,30 @@
+//***************************************************************************************************
+//  esp_adc_cal:  Host stand-in of the ADC calibration, always the default reference.
+//***************************************************************************************************
+
+#ifndef esp_adc_cal_h
+#define esp_adc_cal_h
+
+#include <stdint.h>
+
+typedef int adc_unit_t;
+typedef int adc_atten_t;
+typedef int adc_bits_width_t;
+typedef enum { ESP_ADC_CAL_VAL_EFUSE_VREF, ESP_ADC_CAL_VAL_EFUSE_TP, ESP_ADC_CAL_VAL_DEFAULT_VREF } esp_adc_cal_value_t;
+
+#define ADC_UNIT_1                1
+#define ADC1_CHANNEL_6            6
+#define ADC_ATTEN_DB_11           3
+#define ADC_WIDTH_BIT_12          3
+
+typedef struct {
+  uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+inline esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+                                                    uint32_t vref, esp_adc_cal_characteristics_t* chars) {
+  chars->vref = vref;
+  return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+#endif
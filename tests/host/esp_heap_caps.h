@@ -0,0 +1,30 @@
+//***************************************************************************************************
+//  esp_heap_caps: Host stand-in of the heap info, the figures come from the counting allocator in
+//                alloccount.cpp. Free and largest block are of a 320 kB heap as on the ESP32.
+//***************************************************************************************************
+
+#ifndef esp_heap_caps_h
+#define esp_heap_caps_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MALLOC_CAP_8BIT           (1 << 2)
+#define MALLOC_CAP_DEFAULT        (1 << 12)
+
+typedef struct {
+  size_t total_free_bytes;
+  size_t total_allocated_bytes;
+  size_t largest_free_block;
+  size_t minimum_free_bytes;
+  size_t allocated_blocks;
+  size_t free_blocks;
+  size_t total_blocks;
+} multi_heap_info_t;
+
+void heap_caps_get_info(multi_heap_info_t* info, uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif
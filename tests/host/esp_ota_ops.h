@@ -0,0 +1,38 @@
+//***************************************************************************************************
+//  esp_ota_ops:  Host stand-in of the two app partitions and the OTA data. The partitions are files
+//                NANNY_DIR/ota_0.bin and ota_1.bin, the boot selection and the image state are kept
+//                in NANNY_DIR/otadata. An image is valid if it starts with the ESP image magic 0xE9,
+//                the boot loader checks much more. A new image starts pending verify as with
+//                CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE. The ELF SHA-256 of the running app is a
+//                64 bit FNV-1a hash of the executable, it changes with every build as well.
+//***************************************************************************************************
+
+#ifndef esp_ota_ops_h
+#define esp_ota_ops_h
+
+#include "esp_system.h"
+
+#define ESP_IMAGE_HEADER_MAGIC    0xE9
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  const char* label;
+} esp_partition_t;
+
+typedef enum {
+  ESP_OTA_IMG_NEW, ESP_OTA_IMG_PENDING_VERIFY, ESP_OTA_IMG_VALID, ESP_OTA_IMG_INVALID,
+  ESP_OTA_IMG_ABORTED, ESP_OTA_IMG_UNDEFINED
+} esp_ota_img_states_t;
+
+const esp_partition_t* esp_ota_get_running_partition();
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback();
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+int esp_ota_get_app_elf_sha256(char* dst, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* data, size_t size);
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* data, size_t size);
+
+#endif
@@ -0,0 +1,54 @@
+//***************************************************************************************************
+//  esp_system:   Host stand-in for the ESP-IDF and FreeRTOS declarations the Arduino core brings in
+//                with Arduino.h. Deep sleep ends the process with HOST_EXIT_SLEEP, the test harness
+//                starts the next wake. With NANNY_DIR in the environment the RTC_DATA_ATTR variables
+//                and the clock are saved there before and loaded again on the next start, which then
+//                is a timer wake that happens as soon as the harness likes, the clock jumps over the
+//                time slept. Without the file a start is a power on, as after ESP.restart() or a
+//                crash. The clock of time(), gettimeofday() and settimeofday() is the host's own and
+//                starts at 1970 after power on, as on the ESP32; the real one is never set.
+//***************************************************************************************************
+
+#ifndef esp_system_h
+#define esp_system_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+#define ESP_OK                    0
+#define ESP_FAIL                  -1
+
+#define HOST_EXIT_SLEEP           3     // exit code of esp_deep_sleep_start()
+
+typedef int gpio_num_t;
+#define GPIO_NUM_0                0
+#define GPIO_NUM_35               35
+#define GPIO_SEL_0                (1ULL << 0)
+#define GPIO_SEL_35               (1ULL << 35)
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED, ESP_SLEEP_WAKEUP_ALL, ESP_SLEEP_WAKEUP_EXT0, ESP_SLEEP_WAKEUP_EXT1,
+  ESP_SLEEP_WAKEUP_TIMER, ESP_SLEEP_WAKEUP_TOUCHPAD, ESP_SLEEP_WAKEUP_ULP
+} esp_sleep_wakeup_cause_t;
+#define ESP_EXT1_WAKEUP_ALL_LOW   0
+#define ESP_EXT1_WAKEUP_ANY_HIGH  1
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us);
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level);
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, int mode);
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+uint64_t esp_sleep_get_ext1_wakeup_status();
+void esp_deep_sleep_start() __attribute__((noreturn));
+uint64_t hostSleepUs();                 // timer of the last esp_deep_sleep_start(), 0 if none
+const char* hostPath(char* path, size_t size, const char* name);   // NANNY_DIR/name, "." without
+
+uint32_t esp_random();
+
+typedef void* TaskHandle_t;             // one per thread
+typedef unsigned int UBaseType_t;
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TaskHandle_t xTaskGetIdleTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+#endif
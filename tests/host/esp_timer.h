@@ -0,0 +1,27 @@
+//***************************************************************************************************
+//  esp_timer:    Host stand-in of the one-shot esp_timer, each timer has its own thread as the
+//                esp_timer task of the ESP32 runs the callbacks beside the loop task.
+//***************************************************************************************************
+
+#ifndef esp_timer_h
+#define esp_timer_h
+
+#include "esp_system.h"
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void* arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char* name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+#endif
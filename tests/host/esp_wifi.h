@@ -0,0 +1,13 @@
+//***************************************************************************************************
+//  esp_wifi:     Host stand-in of the radio switch, see WiFi.h for the connection.
+//***************************************************************************************************
+
+#ifndef esp_wifi_h
+#define esp_wifi_h
+
+#include "esp_system.h"
+
+inline esp_err_t esp_wifi_start() { return ESP_OK; }
+inline esp_err_t esp_wifi_stop() { return ESP_OK; }
+
+#endif
@@ -0,0 +1,437 @@
+//***************************************************************************************************
+//  host:         Arduino.h, esp_system.h and esp_heap_caps.h on Linux, see there.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "../alloccount.h"
+
+#define HOST_HEAP_SIZE            (320 * 1024)
+#define HOST_PINS                 40
+#define HOST_RTC_MAGIC            0x52544331      // "RTC1"
+
+// the RTC_DATA_ATTR variables, the linker names the start and end of the section
+extern char __start_rtc_data[] __attribute__((weak));
+extern char __stop_rtc_data[] __attribute__((weak));
+
+typedef struct {
+  uint32_t magic;
+  uint32_t size;                        // of the section, another build of the sketch is a power on
+  int64_t clockUs;                      // the clock at the wake, the time slept included
+} hostRtcHeader_t;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static uint8_t pinLevels[HOST_PINS];
+static uint64_t sleepUs = 0;
+static int64_t clockOffsetUs = 0;       // added to micros() for the clock, 0 at power on
+static esp_sleep_wakeup_cause_t wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+
+static uint64_t nowNs() {
+  struct timespec now;
+  static uint64_t startNs = 0;
+  uint64_t ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  if(startNs == 0) {
+    startNs = ns;
+  }
+  return ns - startNs;
+}
+
+unsigned long millis() {
+  return nowNs() / 1000000;
+}
+
+unsigned long micros() {
+  return nowNs() / 1000;
+}
+
+long random(long limit) {
+  return limit > 0 ? random() % limit : 0;
+}
+
+void delay(unsigned long ms) {
+  usleep(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  usleep(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if(pin < HOST_PINS && mode != OUTPUT) {
+    pinLevels[pin] = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if(pin < HOST_PINS) {
+    pinLevels[pin] = level;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_PINS ? pinLevels[pin] : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  return 2400;                          // about 4 V battery behind the divider
+}
+
+uint8_t hostPinLevel(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+
+  while(size-- > 0) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value) {
+  char text[24];
+
+  snprintf(text, sizeof(text), "%ld", value);
+  return write(text);
+}
+
+size_t Print::print(unsigned long value) {
+  char text[24];
+
+  snprintf(text, sizeof(text), "%lu", value);
+  return write(text);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[48];
+
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char text[256];
+  va_list args;
+  int length;
+
+  va_start(args, format);
+  length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if(length < 0) {
+    return 0;
+  }
+  return write((const uint8_t*)text, min((size_t)length, sizeof(text) - 1));
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t n = 0;
+  int c;
+
+  while(n < length && (c = read()) >= 0 && c != terminator) {
+    buffer[n++] = c;
+  }
+  return n;
+}
+
+int HardwareSerial::read() {
+  struct pollfd input = {0, POLLIN, 0};
+  uint8_t c;
+
+  if(poll(&input, 1, 0) != 1 || ::read(0, &c, 1) != 1) {
+    return -1;
+  }
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  sent += size;
+  if(!quiet) {
+    fwrite(buffer, 1, size, stdout);
+  }
+  return size;
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)nowNs();
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t EspClass::getHeapSize() {
+  return HOST_HEAP_SIZE;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+void EspClass::restart() {
+  fflush(stdout);
+  exit(0);
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) {
+  sleepUs = us;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) {
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, int mode) {
+  return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  return wakeCause;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status() {
+  return 0;
+}
+
+const char* hostPath(char* path, size_t size, const char* name) {
+  const char* directory = getenv("NANNY_DIR");
+
+  snprintf(path, size, "%s/%s", directory != NULL ? directory : ".", name);
+  return path;
+}
+
+static void rtcSave() {
+//***************************************************************************************************
+//  plain system calls, stdio would allocate
+//***************************************************************************************************
+  hostRtcHeader_t header;
+  char path[256];
+  int file;
+
+  if(getenv("NANNY_DIR") == NULL) {
+    return;
+  }
+  header.magic = HOST_RTC_MAGIC;
+  header.size = __stop_rtc_data - __start_rtc_data;
+  header.clockUs = clockOffsetUs + (int64_t)micros() + (int64_t)sleepUs;
+  file = open(hostPath(path, sizeof(path), "rtc"), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(file < 0) {
+    return;
+  }
+  if(write(file, &header, sizeof(header)) != sizeof(header) ||
+     write(file, __start_rtc_data, header.size) != (ssize_t)header.size) {
+    perror("rtc");
+  }
+  close(file);
+}
+
+__attribute__((constructor)) static void rtcLoad() {
+//***************************************************************************************************
+//  before main(), the file is used once, a crash in this wake makes the next one a power on
+//***************************************************************************************************
+  hostRtcHeader_t header;
+  char path[256];
+  int file;
+
+  nowNs();                              // micros() counts from here
+  if(getenv("NANNY_DIR") == NULL) {
+    return;
+  }
+  file = open(hostPath(path, sizeof(path), "rtc"), O_RDONLY);
+  if(file < 0) {
+    return;
+  }
+  if(read(file, &header, sizeof(header)) == sizeof(header) && header.magic == HOST_RTC_MAGIC &&
+     header.size == (uint32_t)(__stop_rtc_data - __start_rtc_data) &&
+     read(file, __start_rtc_data, header.size) == (ssize_t)header.size) {
+    clockOffsetUs = header.clockUs;
+    wakeCause = ESP_SLEEP_WAKEUP_TIMER;
+  }
+  close(file);
+  unlink(path);
+}
+
+void esp_deep_sleep_start() {
+  fflush(stdout);
+  rtcSave();
+  exit(HOST_EXIT_SLEEP);
+}
+
+extern "C" int gettimeofday(struct timeval* now, void* zone) noexcept {
+//***************************************************************************************************
+//  the clock of the sketch instead of the C library's, settimeofday() only moves this one
+//***************************************************************************************************
+  int64_t us = clockOffsetUs + (int64_t)micros();
+
+  now->tv_sec = us / 1000000;           // not NULL, says the C library
+  now->tv_usec = us % 1000000;
+  return 0;
+}
+
+// struct timezone is renamed by Arduino.h
+extern "C" int settimeofday(const struct timeval* now, const struct glibc_timezone* zone) noexcept {
+  if(now != NULL) {
+    clockOffsetUs = (int64_t)now->tv_sec * 1000000 + now->tv_usec - (int64_t)micros();
+  }
+  return 0;
+}
+
+extern "C" time_t time(time_t* now) noexcept {
+  struct timeval clock;
+
+  gettimeofday(&clock, NULL);
+  if(now != NULL) {
+    *now = clock.tv_sec;
+  }
+  return clock.tv_sec;
+}
+
+uint64_t hostSleepUs() {
+  return sleepUs;
+}
+
+uint32_t esp_random() {
+  return (uint32_t)random();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static thread_local int task;
+
+  return &task;                         // main() is the loop task, esp_timer has its own thread
+}
+
+TaskHandle_t xTaskGetIdleTaskHandle() {
+  static int idleTask;
+
+  return &idleTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return 4096;
+}
+
+void heap_caps_get_info(multi_heap_info_t* info, uint32_t caps) {
+  allocCount_t counts = allocCountGet();
+
+  memset(info, 0, sizeof(*info));
+  info->total_allocated_bytes = counts.bytes;
+  info->allocated_blocks = counts.blocks;
+  info->total_free_bytes = HOST_HEAP_SIZE - min((size_t)HOST_HEAP_SIZE, counts.bytes);
+  info->minimum_free_bytes = HOST_HEAP_SIZE - min((size_t)HOST_HEAP_SIZE, counts.peakBytes);
+  info->largest_free_block = info->total_free_bytes;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, caps);
+  return info.total_free_bytes;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, caps);
+  return info.minimum_free_bytes;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, caps);
+  return info.largest_free_block;
+}
+
+struct esp_timer {
+  esp_timer_create_args_t args;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  uint64_t dueUs;                       // micros(), 0 if stopped
+};
+
+static void* timerThread(void* context) {
+//***************************************************************************************************
+//  waits for the due time of its timer, a start or stop in between wakes it up
+//***************************************************************************************************
+  esp_timer* timer = (esp_timer*)context;
+  struct timespec until;
+  uint64_t dueUs;
+
+  pthread_mutex_lock(&timer->lock);
+  for(;;) {
+    if(timer->dueUs == 0) {
+      pthread_cond_wait(&timer->changed, &timer->lock);
+      continue;
+    }
+    if(micros() < timer->dueUs) {
+      clock_gettime(CLOCK_MONOTONIC, &until);
+      dueUs = timer->dueUs - micros();
+      until.tv_sec += dueUs / 1000000;
+      until.tv_nsec += (dueUs % 1000000) * 1000;
+      if(until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&timer->changed, &timer->lock, &until);
+      continue;
+    }
+    timer->dueUs = 0;
+    pthread_mutex_unlock(&timer->lock);
+    timer->args.callback(timer->args.arg);
+    pthread_mutex_lock(&timer->lock);
+  }
+  return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+  pthread_condattr_t attributes;
+  esp_timer* timer = new esp_timer();
+
+  timer->args = *args;
+  pthread_mutex_init(&timer->lock, NULL);
+  pthread_condattr_init(&attributes);
+  pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+  pthread_cond_init(&timer->changed, &attributes);
+  if(pthread_create(&timer->thread, NULL, timerThread, timer) != 0) {
+    delete timer;
+    return ESP_FAIL;
+  }
+  *handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t us) {
+  pthread_mutex_lock(&timer->lock);
+  timer->dueUs = micros() + max(us, (uint64_t)1);
+  pthread_cond_signal(&timer->changed);
+  pthread_mutex_unlock(&timer->lock);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  pthread_mutex_lock(&timer->lock);
+  timer->dueUs = 0;
+  pthread_cond_signal(&timer->changed);
+  pthread_mutex_unlock(&timer->lock);
+  return ESP_OK;
+}
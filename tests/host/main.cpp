@@ -0,0 +1,39 @@
+//***************************************************************************************************
+//  main:         One wake of the sketch as the Arduino core runs it: setup() and then loop() until
+//                esp_deep_sleep_start() ends the process. stdout gets its buffer before, so printing
+//                never allocates, an abort prints the backtrace to stderr.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+
+void setup();
+void loop();
+
+static char stdoutBuffer[4096];
+
+static void printBacktrace(int signal) {
+  void* frames[64];
+  int count;
+
+  fflush(stdout);
+  count = backtrace(frames, 64);
+  backtrace_symbols_fd(frames, count, STDERR_FILENO);
+  _exit(128 + signal);
+}
+
+int main() {
+  void* frame;
+
+  setvbuf(stdout, stdoutBuffer, _IOLBF, sizeof(stdoutBuffer));
+  // loads libgcc, which backtrace() would otherwise do with malloc in the signal handler
+  backtrace(&frame, 1);
+  signal(SIGABRT, printBacktrace);
+  signal(SIGSEGV, printBacktrace);
+  setup();
+  for(;;) {
+    loop();
+  }
+}
@@ -0,0 +1,21 @@
+//***************************************************************************************************
+//  mbedtls/md:   Host stand-in of the message digests, without any: the HMAC-SHA256 is all zero.
+//***************************************************************************************************
+
+#ifndef mbedtls_md_h
+#define mbedtls_md_h
+
+#include <stddef.h>
+#include <string.h>
+
+typedef enum { MBEDTLS_MD_NONE = 0, MBEDTLS_MD_SHA256 = 6 } mbedtls_md_type_t;
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+inline const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t type) { return NULL; }
+inline int mbedtls_md_hmac(const mbedtls_md_info_t* info, const unsigned char* key, size_t keyLength,
+                           const unsigned char* input, size_t inputLength, unsigned char* output) {
+  memset(output, 0, 32);
+  return 0;
+}
+
+#endif
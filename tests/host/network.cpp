@@ -0,0 +1,401 @@
+//***************************************************************************************************
+//  network:      WiFi.h, WiFiUdp.h and HTTPClient.h on Linux sockets, see there. Nothing allocates,
+//                names resolve from NANNY_HOSTS without DNS.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "WiFi.h"
+#include "WiFiUdp.h"
+#include "HTTPClient.h"
+
+#define HOST_CONNECT_TIMEOUT_MS   3000  // as WiFiClient of the ESP32 core
+
+WiFiClass WiFi;
+
+static const char* listFind(const char* list, const char* key, size_t keyLength) {
+//***************************************************************************************************
+//  value of key in "key=value,key=value", NULL if not there
+//***************************************************************************************************
+  const char* entry = list;
+
+  while(entry != NULL && *entry != '\0') {
+    if(strncmp(entry, key, keyLength) == 0 && entry[keyLength] == '=') {
+      return entry + keyLength + 1;
+    }
+    entry = strchr(entry, ',');
+    if(entry != NULL) {
+      entry++;
+    }
+  }
+  return NULL;
+}
+
+uint16_t hostPort(uint16_t port) {
+  char key[8];
+  const char* mapped;
+
+  snprintf(key, sizeof(key), "%u", port);
+  mapped = listFind(getenv("NANNY_PORTS"), key, strlen(key));
+  return mapped != NULL ? atoi(mapped) : port;
+}
+
+static sockaddr_in hostAddress(uint32_t address, uint16_t port) {
+  sockaddr_in socketAddress;
+
+  memset(&socketAddress, 0, sizeof(socketAddress));
+  socketAddress.sin_family = AF_INET;
+  socketAddress.sin_addr.s_addr = address;              // both in network order
+  socketAddress.sin_port = htons(hostPort(port));
+  return socketAddress;
+}
+
+int WiFiClass::begin(const char* ssid, const char* password) {
+  const char* wifi = getenv("NANNY_WIFI");
+
+  connectedStatus = wifi != NULL && strcmp(wifi, "off") == 0 ? WL_DISCONNECTED : WL_CONNECTED;
+  return connectedStatus;
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& address) {
+  const char* mapped;
+  char text[16];
+  in_addr parsed;
+  size_t length;
+
+  if(inet_aton(host, &parsed)) {
+    address = IPAddress(parsed.s_addr);
+    return 1;
+  }
+  if(connectedStatus != WL_CONNECTED) {
+    return 0;
+  }
+  if(getenv("NANNY_DNS_MS") != NULL) {
+    delay(atoi(getenv("NANNY_DNS_MS")));        // the DNS round trip, unknown names too
+  }
+  mapped = listFind(getenv("NANNY_HOSTS"), host, strlen(host));
+  if(mapped == NULL) {
+    return 0;
+  }
+  length = strcspn(mapped, ",");
+  if(length >= sizeof(text)) {
+    return 0;
+  }
+  memcpy(text, mapped, length);
+  text[length] = '\0';
+  if(!inet_aton(text, &parsed)) {
+    return 0;
+  }
+  address = IPAddress(parsed.s_addr);
+  return 1;
+}
+
+//***************************************************************************************************
+//  WiFiClient
+//***************************************************************************************************
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  sockaddr_in address = hostAddress(ip, port);
+  struct pollfd done;
+  int error = 0;
+  socklen_t length = sizeof(error);
+  int on = 1;
+
+  stop();
+  if(WiFi.status() != WL_CONNECTED) {
+    return 0;
+  }
+  socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if(socket < 0) {
+    return 0;
+  }
+  if(::connect(socket, (sockaddr*)&address, sizeof(address)) != 0 && errno != EINPROGRESS) {
+    stop();
+    return 0;
+  }
+  done = {socket, POLLOUT, 0};
+  if(poll(&done, 1, HOST_CONNECT_TIMEOUT_MS) != 1 ||
+     getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+    stop();
+    return 0;
+  }
+  fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) & ~O_NONBLOCK);
+  setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  IPAddress address;
+
+  if(!WiFi.hostByName(host, address)) {
+    return 0;
+  }
+  return connect(address, port);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  size_t written = 0;
+  ssize_t length;
+
+  while(socket >= 0 && written < size) {
+    length = send(socket, buffer + written, size - written, MSG_NOSIGNAL);
+    if(length <= 0) {
+      stop();
+      break;
+    }
+    written += length;
+  }
+  return written;
+}
+
+int WiFiClient::available() {
+  int count = 0;
+
+  if(socket < 0 || ioctl(socket, FIONREAD, &count) != 0) {
+    return 0;
+  }
+  return count;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+  ssize_t length;
+
+  if(socket < 0) {
+    return -1;
+  }
+  length = recv(socket, buffer, size, MSG_DONTWAIT);
+  return length > 0 ? length : -1;
+}
+
+int WiFiClient::peek() {
+  uint8_t c;
+
+  return socket >= 0 && recv(socket, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() {
+  if(socket >= 0) {
+    ::close(socket);
+    socket = -1;
+  }
+}
+
+uint8_t WiFiClient::connected() {
+  uint8_t c;
+  ssize_t length;
+
+  if(socket < 0) {
+    return 0;
+  }
+  length = recv(socket, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if(length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    // closed by the other side, what is left can still be read
+    return available() > 0;
+  }
+  return 1;
+}
+
+//***************************************************************************************************
+//  WiFiUDP
+//***************************************************************************************************
+uint8_t WiFiUDP::begin(uint16_t port) {
+  sockaddr_in address = hostAddress(INADDR_ANY, 0);
+
+  stop();
+  if(WiFi.status() != WL_CONNECTED) {
+    return 0;
+  }
+  socket = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if(socket < 0) {
+    return 0;
+  }
+  address.sin_port = 0;
+  if(bind(socket, (sockaddr*)&address, sizeof(address)) != 0) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if(socket >= 0) {
+    ::close(socket);
+    socket = -1;
+  }
+  rxLength = 0;
+  rxPosition = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  txAddress = ip;
+  txPort = port;
+  txLength = 0;
+  return socket >= 0;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+  IPAddress address;
+
+  if(!WiFi.hostByName(host, address)) {
+    return 0;
+  }
+  return beginPacket(address, port);
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+  size = min(size, sizeof(txBuffer) - txLength);
+  memcpy(txBuffer + txLength, buffer, size);
+  txLength += size;
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  sockaddr_in address = hostAddress(txAddress, txPort);
+
+  if(socket < 0) {
+    return 0;
+  }
+  return sendto(socket, txBuffer, txLength, 0, (sockaddr*)&address, sizeof(address)) == (ssize_t)txLength;
+}
+
+int WiFiUDP::parsePacket() {
+  sockaddr_in address;
+  socklen_t length = sizeof(address);
+  ssize_t received;
+
+  rxLength = 0;
+  rxPosition = 0;
+  if(socket < 0) {
+    return 0;
+  }
+  received = recvfrom(socket, rxBuffer, sizeof(rxBuffer), MSG_DONTWAIT, (sockaddr*)&address, &length);
+  if(received <= 0) {
+    return 0;
+  }
+  rxLength = received;
+  remoteAddress = IPAddress((uint32_t)address.sin_addr.s_addr);
+  remotePortNumber = ntohs(address.sin_port);
+  return rxLength;
+}
+
+int WiFiUDP::read() {
+  return rxPosition < rxLength ? rxBuffer[rxPosition++] : -1;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t size) {
+  size = min(size, rxLength - rxPosition);
+  memcpy(buffer, rxBuffer + rxPosition, size);
+  rxPosition += size;
+  return size;
+}
+
+//***************************************************************************************************
+//  HTTPClient
+//***************************************************************************************************
+bool HTTPClient::begin(WiFiClient& client, const char* url) {
+  const char* start;
+  const char* slash;
+  const char* colon;
+  size_t length;
+
+  this->client = &client;
+  headers[0] = '\0';
+  size = -1;
+  if(strncmp(url, "http://", 7) != 0) {
+    return false;
+  }
+  start = url + 7;
+  slash = strchr(start, '/');
+  if(slash == NULL) {
+    slash = start + strlen(start);
+  }
+  colon = (const char*)memchr(start, ':', slash - start);
+  length = (colon != NULL ? colon : slash) - start;
+  if(length >= sizeof(host)) {
+    return false;
+  }
+  memcpy(host, start, length);
+  host[length] = '\0';
+  port = colon != NULL ? atoi(colon + 1) : 80;
+  snprintf(path, sizeof(path), "%s", *slash != '\0' ? slash : "/");
+  return true;
+}
+
+void HTTPClient::addHeader(const char* name, const char* value) {
+  size_t length = strlen(headers);
+
+  snprintf(headers + length, sizeof(headers) - length, "%s: %s\r\n", name, value);
+}
+
+bool HTTPClient::readLine(char* line, size_t length) {
+//***************************************************************************************************
+//  one header line without CR LF, waits at most timeoutMs for each byte
+//***************************************************************************************************
+  unsigned long startedAt = millis();
+  size_t n = 0;
+  int c;
+
+  while(millis() - startedAt < timeoutMs) {
+    c = client->read();
+    if(c < 0) {
+      if(!client->connected()) {
+        return false;
+      }
+      delay(1);
+      continue;
+    }
+    startedAt = millis();
+    if(c == '\n') {
+      line[n > 0 && line[n - 1] == '\r' ? n - 1 : n] = '\0';
+      return true;
+    }
+    if(n < length - 1) {
+      line[n++] = c;
+    }
+  }
+  return false;
+}
+
+int HTTPClient::GET() {
+  char line[256];
+  int code;
+
+  if(client == NULL || host[0] == '\0') {
+    return HTTPC_ERROR_NOT_CONNECTED;
+  }
+  if(!client->connect(host, port)) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  snprintf(line, sizeof(line), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n", path, host);
+  client->write((const uint8_t*)line, strlen(line));
+  client->write((const uint8_t*)headers, strlen(headers));
+  client->write((const uint8_t*)"\r\n", 2);
+  if(!readLine(line, sizeof(line)) || sscanf(line, "HTTP/%*s %d", &code) != 1) {
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  while(readLine(line, sizeof(line)) && line[0] != '\0') {
+    if(strncasecmp(line, "Content-Length:", 15) == 0) {
+      size = atoi(line + 15);
+    }
+  }
+  return code;
+}
+
+void HTTPClient::end() {
+  if(client != NULL) {
+    client->stop();
+  }
+}
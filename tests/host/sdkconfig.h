@@ -0,0 +1,11 @@
+//***************************************************************************************************
+//  sdkconfig:    Host stand-in of the ESP-IDF configuration, only what the sketch asks for.
+//                esp_ota_ops.h rolls back as a boot loader with CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE.
+//***************************************************************************************************
+
+#ifndef sdkconfig_h
+#define sdkconfig_h
+
+#define CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE 1
+
+#endif
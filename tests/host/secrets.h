@@ -0,0 +1,18 @@
+//***************************************************************************************************
+//  secrets:      Host values, the broker is whatever NANNY_HOSTS and NANNY_PORTS make of it, see
+//                WiFi.h.
+//***************************************************************************************************
+
+#ifndef secrets_h
+#define secrets_h
+
+#define SECRET_WIFI_SSID          "host"
+#define SECRET_WIFI_PASSWORD      ""
+#define SECRET_MQTT_BROKER        "broker"
+#define SECRET_MQTT_PORT          1883
+#define SECRET_MQTT_USER          "nanny"
+#define SECRET_MQTT_PASSWORD      ""
+#define SECRET_MQTT_CA_CERT       ""
+#define SECRET_STATUS_UDP_KEY     ""
+
+#endif
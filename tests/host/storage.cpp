@@ -0,0 +1,368 @@
+//***************************************************************************************************
+//  storage:      Preferences.h, LittleFS.h and esp_ota_ops.h on Linux, see there. Only system calls
+//                after the start, stdio and opendir() would allocate.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "Preferences.h"
+#include "LittleFS.h"
+#include "esp_ota_ops.h"
+
+#define HOST_PARTITION_SIZE       0x1E0000        // app partitions of min_spiffs.csv
+#define HOST_OTADATA_MAGIC        0x4F544131      // "OTA1"
+
+LittleFSFS LittleFS;
+
+//***************************************************************************************************
+//  Preferences
+//***************************************************************************************************
+bool Preferences::begin(const char* name, bool readOnly) {
+  char path[256];
+  char file[PREFERENCES_KEY_LENGTH + 8];
+  int descriptor;
+  ssize_t length;
+
+  snprintf(this->name, sizeof(this->name), "%s", name);
+  snprintf(file, sizeof(file), "nvs-%s", name);
+  count = 0;
+  descriptor = ::open(hostPath(path, sizeof(path), file), O_RDONLY);
+  if(descriptor >= 0) {
+    length = ::read(descriptor, entries, sizeof(entries));
+    count = length > 0 ? length / sizeof(entry_t) : 0;
+    ::close(descriptor);
+  }
+  opened = true;
+  changed = false;
+  return true;
+}
+
+void Preferences::end() {
+  char path[256];
+  char file[PREFERENCES_KEY_LENGTH + 8];
+  int descriptor;
+
+  if(opened && changed) {
+    snprintf(file, sizeof(file), "nvs-%s", name);
+    descriptor = ::open(hostPath(path, sizeof(path), file), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(descriptor >= 0) {
+      if(::write(descriptor, entries, count * sizeof(entry_t)) != (ssize_t)(count * sizeof(entry_t))) {
+        perror("nvs");
+      }
+      ::close(descriptor);
+    }
+  }
+  opened = false;
+}
+
+int Preferences::find(const char* key) {
+  int i;
+
+  for(i = 0; i < count; i++) {
+    if(strncmp(entries[i].key, key, PREFERENCES_KEY_LENGTH) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  int i = find(key);
+
+  return opened && i >= 0 ? entries[i].value : defaultValue;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  int i = find(key);
+
+  if(!opened || strlen(key) >= PREFERENCES_KEY_LENGTH) {
+    return 0;
+  }
+  if(i < 0) {
+    if(count >= PREFERENCES_KEYS) {
+      return 0;
+    }
+    i = count++;
+    snprintf(entries[i].key, sizeof(entries[i].key), "%s", key);
+  }
+  entries[i].value = value;
+  changed = true;
+  return sizeof(value);
+}
+
+bool Preferences::isKey(const char* key) {
+  return opened && find(key) >= 0;
+}
+
+bool Preferences::remove(const char* key) {
+  int i = find(key);
+
+  if(!opened || i < 0) {
+    return false;
+  }
+  entries[i] = entries[--count];
+  changed = true;
+  return true;
+}
+
+//***************************************************************************************************
+//  LittleFS
+//***************************************************************************************************
+size_t File::size() {
+  struct stat status;
+
+  return descriptor >= 0 && fstat(descriptor, &status) == 0 ? status.st_size : 0;
+}
+
+size_t File::position() {
+  off_t position = descriptor >= 0 ? lseek(descriptor, 0, SEEK_CUR) : -1;
+
+  return position >= 0 ? position : 0;
+}
+
+bool File::seek(uint32_t position, int mode) {
+  const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+
+  return descriptor >= 0 && mode >= SeekSet && mode <= SeekEnd && lseek(descriptor, position, whence[mode]) >= 0;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  ssize_t length = descriptor >= 0 ? ::read(descriptor, buffer, size) : -1;
+
+  return length > 0 ? length : 0;
+}
+
+int File::read() {
+  uint8_t c;
+
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::available() {
+  return size() - position();
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  ssize_t length = descriptor >= 0 ? ::write(descriptor, buffer, size) : -1;
+
+  return length > 0 ? length : 0;
+}
+
+void File::close() {
+  if(descriptor >= 0) {
+    ::close(descriptor);
+    descriptor = -1;
+  }
+}
+
+const char* LittleFSFS::fullPath(char* path, size_t size, const char* name) {
+  char directory[256];
+
+  snprintf(path, size, "%s%s", hostPath(directory, sizeof(directory), "littlefs"), name);
+  return path;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+  char path[256];
+
+  return mkdir(fullPath(path, sizeof(path), ""), 0755) == 0 || errno == EEXIST;
+}
+
+File LittleFSFS::open(const char* name, const char* mode, bool create) {
+  char path[256];
+  int flags;
+
+  if(strcmp(mode, "r") == 0) {
+    flags = O_RDONLY;
+  } else if(strcmp(mode, "r+") == 0) {
+    flags = O_RDWR;
+  } else if(strcmp(mode, "w") == 0) {
+    flags = O_WRONLY | O_CREAT | O_TRUNC;
+  } else if(strcmp(mode, "w+") == 0) {
+    flags = O_RDWR | O_CREAT | O_TRUNC;
+  } else if(strcmp(mode, "a") == 0) {
+    flags = O_WRONLY | O_CREAT | O_APPEND;
+  } else {
+    return File();
+  }
+  return File(::open(fullPath(path, sizeof(path), name), flags, 0644));
+}
+
+bool LittleFSFS::exists(const char* name) {
+  char path[256];
+
+  return access(fullPath(path, sizeof(path), name), F_OK) == 0;
+}
+
+bool LittleFSFS::remove(const char* name) {
+  char path[256];
+
+  return unlink(fullPath(path, sizeof(path), name)) == 0;
+}
+
+bool LittleFSFS::rename(const char* from, const char* to) {
+  char fromPath[256];
+  char toPath[256];
+
+  return ::rename(fullPath(fromPath, sizeof(fromPath), from), fullPath(toPath, sizeof(toPath), to)) == 0;
+}
+
+//***************************************************************************************************
+//  app partitions
+//***************************************************************************************************
+typedef struct {
+  uint32_t magic;
+  uint8_t boot;                         // index into hostPartitions
+  uint8_t state;                        // esp_ota_img_states_t of the boot partition
+} hostOtaData_t;
+
+static const esp_partition_t hostPartitions[2] = {
+  {0x10000, HOST_PARTITION_SIZE, "app0"},
+  {0x10000 + HOST_PARTITION_SIZE, HOST_PARTITION_SIZE, "app1"}
+};
+
+static hostOtaData_t otaDataRead() {
+  hostOtaData_t data = {HOST_OTADATA_MAGIC, 0, ESP_OTA_IMG_VALID};
+  char path[256];
+  int descriptor = ::open(hostPath(path, sizeof(path), "otadata"), O_RDONLY);
+
+  if(descriptor >= 0) {
+    if(::read(descriptor, &data, sizeof(data)) != sizeof(data) || data.magic != HOST_OTADATA_MAGIC || data.boot > 1) {
+      data = {HOST_OTADATA_MAGIC, 0, ESP_OTA_IMG_VALID};
+    }
+    ::close(descriptor);
+  }
+  return data;
+}
+
+static bool otaDataWrite(hostOtaData_t data) {
+  char path[256];
+  int descriptor = ::open(hostPath(path, sizeof(path), "otadata"), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written;
+
+  if(descriptor < 0) {
+    return false;
+  }
+  written = ::write(descriptor, &data, sizeof(data)) == sizeof(data);
+  ::close(descriptor);
+  return written;
+}
+
+static int partitionOpen(const esp_partition_t* partition, int flags) {
+  char path[256];
+  char name[16];
+
+  snprintf(name, sizeof(name), "ota_%d.bin", partition == &hostPartitions[0] ? 0 : 1);
+  return ::open(hostPath(path, sizeof(path), name), flags, 0644);
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+  return &hostPartitions[otaDataRead().boot];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start) {
+  return &hostPartitions[1 - otaDataRead().boot];
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+  hostOtaData_t data = otaDataRead();
+
+  if(partition != &hostPartitions[data.boot]) {
+    return ESP_FAIL;
+  }
+  *state = (esp_ota_img_states_t)data.state;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+  hostOtaData_t data = otaDataRead();
+
+  data.state = ESP_OTA_IMG_VALID;
+  return otaDataWrite(data) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+  hostOtaData_t data = otaDataRead();
+  uint8_t magic = 0;
+
+  if(esp_partition_read(partition, 0, &magic, 1) != ESP_OK || magic != ESP_IMAGE_HEADER_MAGIC) {
+    return ESP_FAIL;
+  }
+  data.boot = partition == &hostPartitions[0] ? 0 : 1;
+  data.state = ESP_OTA_IMG_PENDING_VERIFY;
+  return otaDataWrite(data) ? ESP_OK : ESP_FAIL;
+}
+
+int esp_ota_get_app_elf_sha256(char* dst, size_t size) {
+  static char hex[17] = "";
+  uint8_t buffer[4096];
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  ssize_t length;
+  ssize_t i;
+  int descriptor;
+
+  if(hex[0] == '\0') {
+    descriptor = ::open("/proc/self/exe", O_RDONLY);
+    while(descriptor >= 0 && (length = ::read(descriptor, buffer, sizeof(buffer))) > 0) {
+      for(i = 0; i < length; i++) {
+        hash = (hash ^ buffer[i]) * 0x100000001B3ULL;
+      }
+    }
+    if(descriptor >= 0) {
+      ::close(descriptor);
+    }
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  }
+  if(size == 0) {
+    return 0;
+  }
+  size = min(size, sizeof(hex));
+  memcpy(dst, hex, size - 1);
+  dst[size - 1] = '\0';
+  return size;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  uint8_t erased[256];
+  int descriptor;
+  size_t done;
+
+  if(offset + size > partition->size || (descriptor = partitionOpen(partition, O_WRONLY | O_CREAT)) < 0) {
+    return ESP_FAIL;
+  }
+  memset(erased, 0xFF, sizeof(erased));
+  for(done = 0; done < size; done += sizeof(erased)) {
+    if(pwrite(descriptor, erased, min(sizeof(erased), size - done), offset + done) < 0) {
+      break;
+    }
+  }
+  ::close(descriptor);
+  return done >= size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* data, size_t size) {
+  int descriptor;
+  bool written;
+
+  if(offset + size > partition->size || (descriptor = partitionOpen(partition, O_WRONLY | O_CREAT)) < 0) {
+    return ESP_FAIL;
+  }
+  written = pwrite(descriptor, data, size, offset) == (ssize_t)size;
+  ::close(descriptor);
+  return written ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* data, size_t size) {
+  int descriptor;
+  bool done;
+
+  if(offset + size > partition->size || (descriptor = partitionOpen(partition, O_RDONLY)) < 0) {
+    return ESP_FAIL;
+  }
+  done = pread(descriptor, data, size, offset) == (ssize_t)size;
+  ::close(descriptor);
+  return done ? ESP_OK : ESP_FAIL;
+}
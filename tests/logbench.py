@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  logbench:     What LOG_LEVEL costs a wake. The sketch is built once per level, see nanny.py, and
+#                woken --wakes times by the timer after the power on. Per level the median of the
+#                setup time measured by profile.h (START to STATUS, the loop only waits for
+#                INACTIVITY_THRESHOLD), the serial bytes of a wake and what they take at 115200 baud
+#                on the ESP32, where a full TX FIFO blocks the sketch.
+#                Then the INFO build wakes in the state of the DEBUG build: log.h must clear the ring,
+#                whose format pointers belong to the other image, the dump has only records of the
+#                new wake.
+#                  tests/logbench.py --wakes 5
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import shutil
+import statistics
+import sys
+import tempfile
+
+import nanny
+
+LEVELS = ["LOG_LEVEL_NONE", "LOG_LEVEL_ERROR", "LOG_LEVEL_WARN", "LOG_LEVEL_INFO", "LOG_LEVEL_DEBUG"]
+BAUD = 115200                           # as logBegin() in log.h
+SETUP_PHASES = slice(1, 7)              # START to STATUS of PROFILE_PHASE_LIST
+
+
+def setup_us(broker):
+    profile = broker.payloads("profile")
+    return sum(int(value) for value in profile[-1].split(b";")[0].split(b",")[SETUP_PHASES]) if profile else None
+
+
+async def bench(level, binary, wakes, directory):
+    """(median setup ms, median serial bytes) of the timer wakes"""
+    broker = nanny.Recorder()
+    await broker.start("127.0.0.1", 0)
+    device = nanny.Nanny(binary, broker, directory)
+    setups = []
+    serial = []
+    try:
+        for wake in range(wakes + 1):
+            broker.messages.clear()
+            code = await device.wake()
+            if code != nanny.HOST_EXIT_SLEEP:
+                sys.stdout.write(device.output)
+                sys.exit("%s: wake %d ended with %s" % (level, wake, code))
+            if wake > 0:
+                setups.append(setup_us(broker) / 1000)
+                serial.append(len(device.output))
+    finally:
+        await broker.stop()
+    return statistics.median(setups), statistics.median(serial)
+
+
+async def image_change(binary, directory):
+    """binary wakes in the state of another build, True if the ring only has the new wake"""
+    broker = nanny.Recorder()
+    await broker.start("127.0.0.1", 0)
+    device = nanny.Nanny(binary, broker, directory)
+    try:
+        broker.command_after("battery-value", [("command-log", "")])
+        code = await device.wake()
+    finally:
+        await broker.stop()
+    wakes = set(int(line.split(b" ")[0]) for line in broker.payloads("log"))
+    # a record of the other image points anywhere, printing it may well crash
+    print("after the image change: exit %s, records of wakes %s" % (code, sorted(wakes)))
+    # more than one wake counted proves the RTC memory was kept
+    return len(wakes) == 1 and min(wakes) > 1
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="wake time per LOG_LEVEL on the host")
+    parser.add_argument("--wakes", type=int, default=5, help="timer wakes per level")
+    parser.add_argument("--variant", default="BUILD_HEADLESS", choices=["BUILD_FULL", "BUILD_HEADLESS"])
+    args = parser.parse_args()
+    binaries = {}
+    directories = {}
+    print("%-16s %10s %13s %15s" % ("level", "setup ms", "serial bytes", "serial ms 115k2"))
+    try:
+        for level in LEVELS:
+            binaries[level] = nanny.build("logbench-" + level.lower(),
+                                          {"LOG_LEVEL": level, "INACTIVITY_THRESHOLD": "1"}, args.variant)
+            directories[level] = tempfile.mkdtemp(prefix="logbench-")
+            setup_ms, serial_bytes = await bench(level, binaries[level], args.wakes, directories[level])
+            print("%-16s %10.1f %13d %15.1f" % (level, setup_ms, serial_bytes, serial_bytes * 10 * 1000 / BAUD))
+        cleared = await image_change(binaries["LOG_LEVEL_INFO"], directories["LOG_LEVEL_DEBUG"])
+    finally:
+        for directory in directories.values():
+            shutil.rmtree(directory)
+    if not cleared:
+        sys.exit("the log ring kept records of the other image")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  nanny:        The whole sketch on the host. build() compiles a copy of it with settings replaced
+#                against the stand-ins in host/, every run of the binary is one wake: setup() and
+#                loop() until deep sleep ends it with HOST_EXIT_SLEEP. The RTC memory, the NVS, the
+#                LittleFS files and the flash partitions live in the directory of the Nanny, so the
+#                next run is the timer wake after it. MQTT goes to tools/mqttbroker.py, which the
+#                Recorder keeps every publish of.
+#                As a test it is the steady state check of STATIC_MEMORY_MODE: HEAP_STEADY_ABORT is
+#                on, so the first allocation of the loop task after setup aborts with the backtrace,
+#                while the pumps run, commands come in and the event log and the log ring are
+#                published. The stand-ins never allocate after setup, what the ESP32 core and
+#                ESP-IDF allocate on the device (NVS handles, LittleFS files, sockets, WiFi) is not
+#                part of the check, only the sketch is.
+#                  tests/nanny.py
+#                  tests/nanny.py --variant BUILD_HEADLESS --keep
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+TESTS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TESTS)
+sys.path.insert(0, os.path.join(ROOT, "tools"))
+from mqttbroker import Broker           # noqa: E402
+
+SKETCH = "TTGOPlantNanny"
+HOST = [os.path.join(TESTS, "host", name) for name in
+        ("host.cpp", "storage.cpp", "network.cpp", "display.cpp", "PubSubClient.cpp", "main.cpp")] + \
+       [os.path.join(TESTS, "alloccount.cpp")]
+CXXFLAGS = ["-std=gnu++17", "-O1", "-g", "-Wall", "-Wno-unused-function", "-Wno-unused-variable",
+            "-Wno-unused-but-set-variable", "-DCONFIG_HEAP_USE_HOOKS=1", "-pthread", "-rdynamic"]
+HOST_EXIT_SLEEP = 3                     # as in host/esp_system.h
+WAKE_TIMEOUT = 60                       # seconds
+TOPIC = "plant-nanny/1/"                # mqttMainTopic and NANNY_NUMBER
+# a short wake, headless and minimal builds already use 3 s
+SETTINGS = {"MQTT_TLS": "0", "INACTIVITY_THRESHOLD": "3", "HEAP_STEADY_ABORT": "1"}
+
+FUNCTION = re.compile(r"^([A-Za-z_][\w:<>*& ]*?[\s*&]+)([A-Za-z_]\w*)\s*\(([^;{]*)\)\s*\{\s*$")
+CONDITIONAL = re.compile(r"^\s*#\s*(if|ifdef|ifndef|elif|else|endif)\b")
+KEYWORDS = ("if", "while", "for", "switch", "else", "return", "typedef", "struct", "class", "enum")
+
+
+def prototypes(source):
+    """the sketch as the Arduino builder makes it a C++ file: Arduino.h and a prototype of every
+    function in front of the first one, inside the same #if as the function"""
+    lines = source.split("\n")
+    found = []
+    first = None
+    for number, line in enumerate(lines):
+        if first is not None and CONDITIONAL.match(line):
+            found.append(line)
+            continue
+        match = FUNCTION.match(line)
+        if match is None or line.startswith(KEYWORDS) or match.group(2) in KEYWORDS:
+            continue
+        if first is None:
+            first = number
+        arguments = re.sub(r"\s*=\s*[^,)]+", "", match.group(3))
+        found.append("%s %s(%s);" % (match.group(1).strip(), match.group(2), arguments))
+    return "\n".join(["#include <Arduino.h>", '#line 1 "%s.ino"' % SKETCH] + lines[:first] + found +
+                     ['#line %d "%s.ino"' % (first + 1, SKETCH)] + lines[first:])
+
+
+def build(name, settings={}, variant="BUILD_FULL"):
+    """compiles the sketch with the #defines of settings.h in SETTINGS and settings replaced, returns
+    the binary, tests/build/<name>/nanny"""
+    path = os.path.join(TESTS, "build", name)
+    shutil.rmtree(path, ignore_errors=True)
+    os.makedirs(path)
+    for file in os.listdir(ROOT):
+        # secrets.h of the host, the real one stays where it is
+        if file.endswith((".ino", ".h")) and file != "secrets.h":
+            shutil.copy(os.path.join(ROOT, file), path)
+    with open(os.path.join(path, "settings.h")) as file:
+        text = file.read()
+    for key, value in dict(SETTINGS, BUILD_VARIANT=variant, **settings).items():
+        text, count = re.subn(r"^(#define %s\s+)\S+" % key, lambda match: match.group(1) + value, text, flags=re.M)
+        if count == 0:
+            sys.exit("%s not found in settings.h" % key)
+    with open(os.path.join(path, "settings.h"), "w") as file:
+        file.write(text)
+    with open(os.path.join(path, SKETCH + ".ino")) as file:
+        source = prototypes(file.read())
+    with open(os.path.join(path, SKETCH + ".cpp"), "w") as file:
+        file.write(source)
+    binary = os.path.join(path, "nanny")
+    command = [os.environ.get("CXX", "g++")] + CXXFLAGS + ["-I" + path, "-I" + os.path.join(TESTS, "host"),
+                                                           "-o", binary, os.path.join(path, SKETCH + ".cpp")] + HOST
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr)
+        sys.exit("compiling %s failed" % name)
+    return binary
+
+
+class Recorder(Broker):
+    """keeps (seconds since start, topic, payload) of everything published"""
+
+    def __init__(self, **options):
+        super().__init__(**options)
+        self.messages = []
+        self.started = time.monotonic()
+        self.pending = {}
+
+    def publish(self, topic, payload, qos, retain):
+        self.messages.append((time.monotonic() - self.started, topic.decode(), payload))
+        super().publish(topic, payload, qos, retain)
+        for command in self.pending.pop(topic.decode(), []):
+            self.command(*command)
+
+    def command_after(self, topic, commands):
+        """[(topic, payload)] sent as soon as the nanny publishes topic, it has subscribed by then"""
+        self.pending.setdefault(TOPIC + topic, []).extend(commands)
+
+    def command(self, topic, payload):
+        """QoS 1, the persistent session of the nanny keeps it while it sleeps"""
+        self.publish((TOPIC + topic).encode(), payload.encode(), 1, False)
+
+    def payloads(self, topic):
+        return [payload for _, name, payload in self.messages if name == TOPIC + topic]
+
+
+class Nanny:
+    """the state of one nanny between wakes, in its own directory"""
+
+    def __init__(self, binary, broker, directory):
+        self.binary = binary
+        self.broker = broker
+        self.directory = directory
+        self.output = ""
+
+    async def wake(self, environment={}, timeout=WAKE_TIMEOUT):
+        """one wake, returns its exit code, the output is in self.output"""
+        env = dict(os.environ, NANNY_DIR=self.directory, NANNY_HOSTS="broker=127.0.0.1",
+                   NANNY_PORTS="1883=%d" % self.broker.port)
+        env.update(environment)
+        process = await asyncio.create_subprocess_exec(self.binary, env=env, stdin=subprocess.DEVNULL,
+                                                       stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        try:
+            output, _ = await asyncio.wait_for(process.communicate(), timeout)
+        except asyncio.TimeoutError:
+            process.kill()
+            output, _ = await process.communicate()
+        self.output = output.decode(errors="replace")
+        return process.returncode
+
+
+def steady_allocations(broker):
+    """of the last heap message"""
+    heap = broker.payloads("heap")
+    return int(heap[-1].split(b",")[7]) if heap else None
+
+
+async def steady_state(variant, keep, verbose):
+    binary = build("nanny-" + variant.lower(), variant=variant)
+    directory = tempfile.mkdtemp(prefix="nanny-")
+    broker = Recorder()
+    await broker.start("127.0.0.1", 0)
+    nanny = Nanny(binary, broker, directory)
+    failed = False
+    try:
+        # power on, the commands come while it is awake
+        broker.command_after("battery-value", [("1/command-water-now", "2"), ("2/command-freq", "12"),
+                                               ("2/command-next", "1"), ("command-container", "2500"),
+                                               ("command-log", ""), ("command-history", "0")])
+        # then a timer wake with the commands queued while it slept
+        for wake in ("power on", "timer"):
+            if wake == "timer":
+                broker.command("2/command-water-now", "1")
+                broker.command("1/command-amount", "150")
+                broker.command("command-history", "0")
+            code = await nanny.wake()
+            steady = steady_allocations(broker)
+            # the abort already ends a wake that allocates, the heap message is the second opinion,
+            # the minimal build has none
+            ok = code == HOST_EXIT_SLEEP and steady == (None if variant == "BUILD_MINIMAL" else 0)
+            # the schedule commands take effect in the wake they come in
+            if wake == "power on" and variant != "BUILD_MINIMAL":
+                ok = ok and "Schedule changed, next job in 1 hours" in nanny.output
+            print("%s %s wake: exit %s, allocations after setup %s, %s" %
+                  (variant, wake, code, steady, "ok" if ok else "FAILED"))
+            if not ok or verbose:
+                sys.stdout.write(nanny.output)
+            if not ok:
+                failed = True
+                break
+            broker.messages.clear()
+    finally:
+        await broker.stop()
+        if keep:
+            print("state kept in", directory)
+        else:
+            shutil.rmtree(directory)
+    return not failed
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="steady state allocations of the whole sketch on the host")
+    parser.add_argument("--variant", action="append", choices=["BUILD_FULL", "BUILD_HEADLESS", "BUILD_MINIMAL"],
+                        help="default all three")
+    parser.add_argument("--keep", action="store_true", help="keep the state directory")
+    parser.add_argument("--verbose", action="store_true", help="the output of every wake")
+    args = parser.parse_args()
+    results = [await steady_state(variant, args.keep, args.verbose)
+               for variant in args.variant or ["BUILD_FULL", "BUILD_HEADLESS", "BUILD_MINIMAL"]]
+    sys.exit(0 if all(results) else 1)
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
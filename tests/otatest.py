@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  otatest:      The firmware update of ota.h end to end, see nanny.py: command-ota comes from
+#                tools/mqttbroker.py, the images and patches from tools/otaserver.py, which cuts
+#                every response after --cut percent of the download, so the nanny has to resume with
+#                range requests over several wakes. Once with the full image only, the patch request
+#                gets a 404, and once with a patch of tools/otadelta.py against the image in the
+#                running partition. Checks the new image in the other partition, the boot partition
+#                pending verification after the restart, the confirmation in the next wake and at
+#                most one download per wake. The patch has to cost fewer bytes than the image.
+#                The images are random bytes behind the magic byte, the running one is named after
+#                the hash the host stand-in of esp_ota_get_app_elf_sha256() has of the binary.
+#                  tests/otatest.py --cut 30
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import os
+import random
+import shutil
+import struct
+import sys
+import tempfile
+
+import nanny
+from otadelta import patch             # noqa: E402, tools/ is on the path of nanny
+from otaserver import Server            # noqa: E402
+
+VERSION = "2.0"
+PREFIX = "plant-nanny-"
+IMAGE_SIZE = 1200000
+MAX_WAKES = 12
+OTADATA = "<IBB2x"                      # hostOtaData_t of host/storage.cpp
+OTA_IMG_PENDING_VERIFY = 1              # esp_ota_img_states_t of host/esp_ota_ops.h
+OTA_IMG_VALID = 2
+
+
+def images():
+    """running image and the next one: some bytes changed, some added, some removed"""
+    generator = random.Random(69)
+    old = b"\xe9" + bytes(generator.getrandbits(8) for _ in range(IMAGE_SIZE - 1))
+    new = bytearray(old)
+    for offset in (4096, 300000, 700000):
+        new[offset:offset + 200] = bytes(generator.getrandbits(8) for _ in range(200))
+    new[500000:500000] = bytes(generator.getrandbits(8) for _ in range(1000))
+    del new[900000:900300]
+    return old, bytes(new)
+
+
+def elf_sha(binary):
+    """first 16 hex digits, FNV-1a 64 of the binary as the host stand-in has it"""
+    with open(binary, "rb") as file:
+        data = file.read()
+    value = 0xCBF29CE484222325
+    for byte in data:
+        value = ((value ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return "%016x" % value
+
+
+async def update(binary, delta, cut, verbose):
+    """bytes sent for the update or None if it failed"""
+    old, new = images()
+    directory = tempfile.mkdtemp(prefix="otatest-")
+    firmware = os.path.join(directory, "firmware")
+    os.makedirs(firmware)
+    with open(os.path.join(directory, "ota_0.bin"), "wb") as file:
+        file.write(old)
+    with open(os.path.join(firmware, PREFIX + VERSION + ".bin"), "wb") as file:
+        file.write(new)
+    download = new
+    if delta:
+        download = patch(old, new)
+        with open(os.path.join(firmware, "%s%s-%s.patch" % (PREFIX, VERSION, elf_sha(binary))), "wb") as file:
+            file.write(download)
+    mode = "delta" if delta else "full"
+    broker = nanny.Recorder()
+    await broker.start("127.0.0.1", 0)
+    server = Server(firmware, cut=max(1, len(download) * cut // 100))
+    await server.start("127.0.0.1", 0)
+    environment = {"NANNY_HOSTS": "broker=127.0.0.1,ota=127.0.0.1",
+                   "NANNY_PORTS": "1883=%d,8080=%d" % (broker.port, server.port)}
+    device = nanny.Nanny(binary, broker, directory)
+    failed = None
+    try:
+        broker.command_after("battery-value", [("command-ota", VERSION)])
+        for wake in range(MAX_WAKES):
+            server.requests.clear()
+            code = await device.wake(environment)
+            downloads = [request for request in server.requests if request[2] in (200, 206)]
+            if verbose:
+                sys.stdout.write(device.output)
+            if len(downloads) > 1:
+                failed = "wake %d downloaded %d times" % (wake, len(downloads))
+            elif code not in (0, nanny.HOST_EXIT_SLEEP):
+                failed = "wake %d ended with %s" % (wake, code)
+            elif delta and any(request[0].endswith(".bin") for request in server.requests):
+                failed = "wake %d downloaded the image instead of the patch" % wake
+            if failed or code == 0:
+                break
+        else:
+            failed = "not done after %d wakes" % MAX_WAKES
+        if not failed:
+            with open(os.path.join(directory, "ota_1.bin"), "rb") as file:
+                written = file.read()
+            with open(os.path.join(directory, "otadata"), "rb") as file:
+                _, boot, state = struct.unpack(OTADATA, file.read(struct.calcsize(OTADATA)))
+            if written[:len(new)] != new:
+                failed = "ota_1.bin is not the new image"
+            elif boot != 1 or state != OTA_IMG_PENDING_VERIFY:
+                failed = "boots %d in state %d after the restart" % (boot, state)
+            elif wake == 0:
+                failed = "done in one wake, --cut did not interrupt the download"
+        if not failed:
+            code = await device.wake(environment)
+            with open(os.path.join(directory, "otadata"), "rb") as file:
+                _, boot, state = struct.unpack(OTADATA, file.read(struct.calcsize(OTADATA)))
+            if code != nanny.HOST_EXIT_SLEEP or boot != 1 or state != OTA_IMG_VALID:
+                failed = "first wake of the new image: exit %s, boots %d in state %d" % (code, boot, state)
+        sent = sum(server.sent.values())
+        print("%s: %d bytes in %d wakes for a %d byte image, %s" %
+              (mode, sent, wake + 1, len(new), failed or "ok"))
+        if failed and not verbose:
+            sys.stdout.write(device.output)
+    finally:
+        await broker.stop()
+        await server.stop()
+        shutil.rmtree(directory)
+    return None if failed else sent
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="firmware update over several wakes against a local HTTP server")
+    parser.add_argument("--cut", type=int, default=40, help="percent of the download each response is cut after")
+    parser.add_argument("--verbose", action="store_true", help="the output of every wake")
+    args = parser.parse_args()
+    binary = nanny.build("otatest", {"OTA_URL_PREFIX": '"http://ota:8080/%s"' % PREFIX}, "BUILD_HEADLESS")
+    full = await update(binary, False, args.cut, args.verbose)
+    delta = await update(binary, True, args.cut, args.verbose)
+    if full is None or delta is None:
+        sys.exit(1)
+    print("the patch costs %.1f %% of the image" % (100 * delta / full))
+    if delta >= full:
+        sys.exit("the patch is not smaller than the image")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
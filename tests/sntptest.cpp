@@ -0,0 +1,224 @@
+//***************************************************************************************************
+//  sntptest:     sntp.h against tools/sntpserver.py, one server per entry of sntpServers on
+//                127.0.0.1 to 127.0.0.3: a sync, silent servers, replies that must be dropped and
+//                the deadline of SNTP_TIMEOUT_MS with the DNS lookups in it. Runs from tests/, as
+//                make does.
+//***************************************************************************************************
+
+#include <Arduino.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "check.h"
+#include "secrets.h"
+#include "settings.h"
+#include "log.h"
+#include "sntp.h"
+
+#define SERVER_SCRIPT             "../tools/sntpserver.py"
+#define CLOCK_TOLERANCE_MS        50    // of the synced clock to the host's, over loopback
+#define DEADLINE_TOLERANCE_MS     100   // after SNTP_TIMEOUT_MS, the host is busy with other tests
+#define DNS_MS                    300   // per lookup, all of them fit into SNTP_TIMEOUT_MS
+#define DNS_SLOW_MS               800   // per lookup, two of them outlast SNTP_TIMEOUT_MS
+#define BAD_OFFSET_S              "3600"        // of the bad servers, a dropped reply must not set it
+
+extern char** environ;
+
+pid_t servers[SNTP_SERVER_COUNT];
+uint16_t serverPort;
+
+void serverStart(size_t index, const char* fault, const char* delayMs = "0", const char* offset = "0") {
+//***************************************************************************************************
+//  server of sntpServers[index] on 127.0.0.<index + 1>, all on the port of the first one
+//***************************************************************************************************
+  char host[16];
+  char port[8];
+  char line[64];
+  const char* arguments[] = {"python3", SERVER_SCRIPT, "--host", host, "--port", port, "--fault", fault,
+                             "--delay", delayMs, "--offset", offset, NULL};
+  posix_spawn_file_actions_t actions;
+  int output[2];
+  FILE* stream;
+
+  snprintf(host, sizeof(host), "127.0.0.%u", (unsigned)index + 1);
+  snprintf(port, sizeof(port), "%u", index == 0 ? 0 : serverPort);
+  CHECK(pipe(output) == 0);
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, output[1], STDERR_FILENO);
+  posix_spawn_file_actions_addclose(&actions, output[0]);
+  CHECK(posix_spawnp(&servers[index], "python3", &actions, NULL, (char**)arguments, environ) == 0);
+  posix_spawn_file_actions_destroy(&actions);
+  close(output[1]);
+  // "listening on 127.0.0.1:40123" once it is bound
+  stream = fdopen(output[0], "r");
+  if(fgets(line, sizeof(line), stream) == NULL || strrchr(line, ':') == NULL) {
+    fprintf(stderr, "%s did not start\n", SERVER_SCRIPT);
+    exit(1);
+  }
+  fclose(stream);
+  if(index == 0) {
+    serverPort = atoi(strrchr(line, ':') + 1);
+  }
+}
+
+void serversStop() {
+  size_t i;
+
+  for(i = 0; i < SNTP_SERVER_COUNT; i++) {
+    if(servers[i] > 0) {
+      kill(servers[i], SIGTERM);
+      waitpid(servers[i], NULL, 0);
+      servers[i] = 0;
+    }
+  }
+}
+
+void powerOn(int dnsMs = 0) {
+//***************************************************************************************************
+//  what sntp.h finds after a power on: clock not set, nothing resolved
+//***************************************************************************************************
+  struct timeval zero = {0, 0};
+  char hosts[160];
+  char ports[16];
+  char dns[8];
+
+  settimeofday(&zero, NULL);
+  memset(sntpAddresses, 0, sizeof(sntpAddresses));
+  snprintf(hosts, sizeof(hosts), "%s=127.0.0.1,%s=127.0.0.2,%s=127.0.0.3", sntpServers[0], sntpServers[1],
+           sntpServers[2]);
+  snprintf(ports, sizeof(ports), "%u=%u", SNTP_PORT, serverPort);
+  snprintf(dns, sizeof(dns), "%d", dnsMs);
+  setenv("NANNY_HOSTS", hosts, 1);
+  setenv("NANNY_PORTS", ports, 1);
+  setenv("NANNY_DNS_MS", dns, 1);
+}
+
+unsigned long sntpSync() {
+//***************************************************************************************************
+//  sntpBegin() and sntpPoll() as the sketch calls them, returns ms from the begin to the end
+//***************************************************************************************************
+  unsigned long startedAt = millis();
+
+  if(sntpBegin()) {
+    while(sntpPoll()) {
+      delay(1);
+    }
+  }
+  return millis() - startedAt;
+}
+
+long clockErrorMs() {
+//***************************************************************************************************
+//  the clock sntp.h set against the real one of the host
+//***************************************************************************************************
+  struct timeval synced;
+  struct timespec real;
+
+  gettimeofday(&synced, NULL);
+  clock_gettime(CLOCK_REALTIME, &real);
+  return labs(((int64_t)synced.tv_sec * 1000 + synced.tv_usec / 1000) -
+              ((int64_t)real.tv_sec * 1000 + real.tv_nsec / 1000000));
+}
+
+void testSync() {
+  unsigned long ms;
+
+  serverStart(0, "none");
+  serverStart(1, "none");
+  serverStart(2, "none");
+  powerOn();
+  ms = sntpSync();
+  CHECK(sntpTimeValid());
+  CHECK(clockErrorMs() < CLOCK_TOLERANCE_MS);
+  CHECK(ms < SNTP_TIMEOUT_MS);
+  // the next wake asks the kept addresses, without DNS
+  CHECK(sntpAddresses[0] != 0 && sntpAddresses[1] != 0 && sntpAddresses[2] != 0);
+  setenv("NANNY_HOSTS", "", 1);
+  CHECK(sntpSync() < SNTP_TIMEOUT_MS);
+  CHECK(clockErrorMs() < CLOCK_TOLERANCE_MS);
+  serversStop();
+}
+
+void testTimeout() {
+  unsigned long ms;
+
+  serverStart(0, "silent");
+  serverStart(1, "silent");
+  serverStart(2, "silent");
+  powerOn();
+  ms = sntpSync();
+  CHECK(!sntpTimeValid());
+  CHECK(ms >= SNTP_TIMEOUT_MS && ms <= SNTP_TIMEOUT_MS + DEADLINE_TOLERANCE_MS);
+  CHECK(!sntpBusy);
+  // resolved again on the next wake, the servers may have moved
+  CHECK(sntpAddresses[0] == 0 && sntpAddresses[1] == 0 && sntpAddresses[2] == 0);
+  serversStop();
+}
+
+void testBadReply() {
+  unsigned long ms;
+
+  // replies in client mode and kisses of death, all dropped
+  serverStart(0, "mode", "0", BAD_OFFSET_S);
+  serverStart(1, "stratum0", "0", BAD_OFFSET_S);
+  serverStart(2, "leap", "0", BAD_OFFSET_S);
+  powerOn();
+  ms = sntpSync();
+  CHECK(!sntpTimeValid());
+  CHECK(ms >= SNTP_TIMEOUT_MS && ms <= SNTP_TIMEOUT_MS + DEADLINE_TOLERANCE_MS);
+  serversStop();
+
+  // a good reply after the bad ones still counts and the bad time is not taken
+  serverStart(0, "mode", "0", BAD_OFFSET_S);
+  serverStart(1, "stratum0", "0", BAD_OFFSET_S);
+  serverStart(2, "none", "200");
+  powerOn();
+  ms = sntpSync();
+  CHECK(sntpTimeValid());
+  CHECK(clockErrorMs() < CLOCK_TOLERANCE_MS);
+  CHECK(ms >= 200 && ms < SNTP_TIMEOUT_MS);
+  serversStop();
+}
+
+void testDnsDeadline() {
+  unsigned long ms;
+
+  // two lookups take more than SNTP_TIMEOUT_MS, the third server is not resolved any more and no
+  // request goes out, the addresses are kept for the next wake
+  serverStart(0, "none");
+  serverStart(1, "none");
+  serverStart(2, "none");
+  powerOn(DNS_SLOW_MS);
+  ms = sntpSync();
+  CHECK(!sntpTimeValid());
+  CHECK(sntpAddresses[0] != 0 && sntpAddresses[1] != 0 && sntpAddresses[2] == 0);
+  CHECK(sntpSentAt[0] == 0 && sntpSentAt[1] == 0 && sntpSentAt[2] == 0);
+  CHECK(ms >= 2 * DNS_SLOW_MS && ms <= SNTP_TIMEOUT_MS + DNS_SLOW_MS + DEADLINE_TOLERANCE_MS);
+  // the next wake only looks up the third one
+  ms = sntpSync();
+  CHECK(sntpTimeValid());
+  CHECK(clockErrorMs() < CLOCK_TOLERANCE_MS);
+  CHECK(ms >= DNS_SLOW_MS && ms < SNTP_TIMEOUT_MS);
+  serversStop();
+
+  // the lookups fit, the replies are timed from the requests sent after them, not from the first
+  // lookup
+  serverStart(0, "none");
+  serverStart(1, "none");
+  serverStart(2, "none");
+  powerOn(DNS_MS);
+  ms = sntpSync();
+  CHECK(sntpTimeValid());
+  CHECK(clockErrorMs() < CLOCK_TOLERANCE_MS);
+  CHECK(ms >= SNTP_SERVER_COUNT * DNS_MS && ms < SNTP_TIMEOUT_MS);
+  serversStop();
+}
+
+int main() {
+  WiFi.begin(SECRET_WIFI_SSID, SECRET_WIFI_PASSWORD);
+  testSync();
+  testTimeout();
+  testBadReply();
+  testDnsDeadline();
+  return checkDone("sntp");
+}
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  wakeprofile:  The phases of profile.h per build variant, without a board. The sketch runs on the
+#                host stand-ins, see nanny.py: display, relais and buttons are stubs, MQTT goes to
+#                tools/mqttbroker.py, which gets the profile message before deep sleep, SNTP goes to
+#                tools/sntpserver.py. Per phase the median micro seconds and cycles of --wakes timer
+#                wakes after the power on, the cycles are nanoseconds of the host (ESP.getCycleCount()
+#                of host/Arduino.h), not instructions of the ESP32. LOOP is mostly the wait for
+#                INACTIVITY_THRESHOLD.
+#                --save keeps the medians, --compare fails on a phase that got slower than
+#                --tolerance percent and --floor-ms, so a commit can be held against the one before.
+#                  tests/wakeprofile.py --save before.json
+#                  tests/wakeprofile.py --compare before.json --tolerance 25
+#                The minimal build has no network and so no profile message, it is left out. A QEMU
+#                target of the ESP32 is not part of it, Espressif's machine has no WiFi to wake with.
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import json
+import os
+import re
+import shutil
+import statistics
+import sys
+import tempfile
+
+import nanny
+from sntpserver import Server          # noqa: E402, tools/ is on the path of nanny
+
+VARIANTS = ["BUILD_FULL", "BUILD_HEADLESS"]
+with open(os.path.join(nanny.ROOT, "profile.h")) as header:
+    PHASES = re.findall(r"^\s*X\((\w+)\)", header.read(), flags=re.M)
+with open(os.path.join(nanny.ROOT, "settings.h")) as header:
+    SNTP_SERVERS = re.findall(r'"([^"]+)"', re.search(r"sntpServers\[\]\s*=\s*\{(.*)\}",
+                                                      header.read()).group(1))
+
+
+def phases(payload):
+    """{phase: (us, cycles)} of one profile message"""
+    us, cycles = payload.split(b";")
+    return dict(zip(PHASES, zip((int(value) for value in us.split(b",")),
+                                (int(value) for value in cycles.split(b",")))))
+
+
+async def profile(variant, wakes, latency):
+    """{phase: (median us, median cycles)} of the timer wakes"""
+    binary = nanny.build("wakeprofile-" + variant.lower(), {"INACTIVITY_THRESHOLD": "1"}, variant)
+    directory = tempfile.mkdtemp(prefix="wakeprofile-")
+    broker = nanny.Recorder(latency=latency / 1000)
+    await broker.start("127.0.0.1", 0)
+    sntp = Server(delay=latency / 1000)
+    await sntp.start("127.0.0.1", 0)
+    # every name of sntpServers in settings.h
+    hosts = ",".join(["broker=127.0.0.1"] + ["%s=127.0.0.1" % name for name in SNTP_SERVERS])
+    environment = {"NANNY_HOSTS": hosts, "NANNY_PORTS": "1883=%d,123=%d" % (broker.port, sntp.port)}
+    device = nanny.Nanny(binary, broker, directory)
+    measured = []
+    try:
+        for wake in range(wakes + 1):
+            broker.messages.clear()
+            code = await device.wake(environment)
+            payloads = broker.payloads("profile")
+            if code != nanny.HOST_EXIT_SLEEP or not payloads:
+                sys.stdout.write(device.output)
+                sys.exit("%s: wake %d ended with %s, %d profile messages" % (variant, wake, code, len(payloads)))
+            if wake > 0:
+                measured.append(phases(payloads[-1]))
+    finally:
+        await broker.stop()
+        await sntp.stop()
+        shutil.rmtree(directory)
+    return {phase: (statistics.median(wake[phase][0] for wake in measured),
+                    statistics.median(wake[phase][1] for wake in measured)) for phase in PHASES}
+
+
+def compare(results, baseline, tolerance, floor_ms):
+    """True if no phase got slower than the baseline by more than tolerance percent and floor_ms"""
+    ok = True
+    for variant, medians in results.items():
+        for phase, (us, _) in medians.items():
+            before = baseline.get(variant, {}).get(phase)
+            if before is None:
+                continue
+            if us > before[0] * (1 + tolerance / 100) and us - before[0] > floor_ms * 1000:
+                print("%s %s: %.1f ms, was %.1f ms" % (variant, phase, us / 1000, before[0] / 1000))
+                ok = False
+    return ok
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="time and cycles per wake phase on the host")
+    parser.add_argument("--variant", action="append", choices=VARIANTS, help="default both")
+    parser.add_argument("--wakes", type=int, default=5, help="timer wakes per variant")
+    parser.add_argument("--latency", type=float, default=0, help="ms added to every delivery by the broker")
+    parser.add_argument("--save", help="JSON file the medians go to")
+    parser.add_argument("--compare", help="JSON file of --save to hold the medians against")
+    parser.add_argument("--tolerance", type=float, default=25, help="percent a phase may get slower")
+    parser.add_argument("--floor-ms", type=float, default=2, help="ms a phase may always get slower")
+    args = parser.parse_args()
+    results = {}
+    for variant in args.variant or VARIANTS:
+        results[variant] = await profile(variant, args.wakes, args.latency)
+        print("%s, median of %d timer wakes" % (variant, args.wakes))
+        print("  %-8s %10s %14s" % ("phase", "ms", "cycles"))
+        for phase, (us, cycles) in results[variant].items():
+            print("  %-8s %10.2f %14d" % (phase, us / 1000, cycles))
+        print("  %-8s %10.2f" % ("total", sum(us for us, _ in results[variant].values()) / 1000))
+    if args.save:
+        with open(args.save, "w") as file:
+            json.dump(results, file, indent=1)
+    if args.compare:
+        with open(args.compare) as file:
+            if not compare(results, json.load(file), args.tolerance, args.floor_ms):
+                sys.exit("slower than %s" % args.compare)
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  waternow:     End to end latency of command-water-now. While the nanny is awake, see nanny.py,
+#                water-now commands for two pumps are published to tools/mqttbroker.py; each
+#                water-done message (pump,requested ms,on ms,remaining,source) has to arrive within
+#                --target-ms of the moment its run was due to end: the command plus the requested
+#                times and PUMP_PAUSE_MS of the runs queued before it. The on time has to match the
+#                requested one within --on-tolerance-ms. --latency adds broker latency to every
+#                delivery, as a slow WLAN would.
+#                  tests/waternow.py --wakes 3 --target-ms 250
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import shutil
+import statistics
+import sys
+import tempfile
+
+import nanny
+
+PUMP_PAUSE_MS = 100                     # as in settings.h
+COMMANDS = [(1, 1), (2, 2)]             # pump and seconds, run one after the other
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="latency of command-water-now against the local broker")
+    parser.add_argument("--wakes", type=int, default=3, help="wakes with the commands")
+    parser.add_argument("--target-ms", type=float, default=250, help="latency allowed after the end of a run")
+    parser.add_argument("--on-tolerance-ms", type=float, default=20, help="deviation allowed of the on time")
+    parser.add_argument("--latency", type=float, default=0, help="ms added to every delivery by the broker")
+    args = parser.parse_args()
+    binary = nanny.build("waternow", variant="BUILD_HEADLESS")
+    directory = tempfile.mkdtemp(prefix="waternow-")
+    broker = nanny.Recorder(latency=args.latency / 1000)
+    await broker.start("127.0.0.1", 0)
+    device = nanny.Nanny(binary, broker, directory)
+    latencies = []
+    failures = 0
+    try:
+        for wake in range(args.wakes):
+            broker.messages.clear()
+            broker.command_after("battery-value", [("%d/command-water-now" % pump, str(seconds))
+                                                   for pump, seconds in COMMANDS])
+            code = await device.wake()
+            sent = [at for at, topic, _ in broker.messages if topic.endswith("/command-water-now")]
+            done = [(at, payload.decode().split(",")) for at, topic, payload in broker.messages
+                    if topic == nanny.TOPIC + "water-done"]
+            if code != nanny.HOST_EXIT_SLEEP or len(sent) != len(COMMANDS) or len(done) != len(COMMANDS):
+                sys.stdout.write(device.output)
+                sys.exit("wake %d: exit %s, %d commands, %d completions" % (wake, code, len(sent), len(done)))
+            due = sent[-1]
+            for (pump, seconds), (at, fields) in zip(COMMANDS, done):
+                due += seconds + (PUMP_PAUSE_MS / 1000 if due > sent[-1] else 0)
+                latency = (at - due) * 1000
+                latencies.append(latency)
+                ok = (fields[0] == str(pump) and int(fields[1]) == seconds * 1000 and fields[4] == "remote" and
+                      abs(int(fields[2]) - seconds * 1000) <= args.on_tolerance_ms and latency <= args.target_ms)
+                failures += not ok
+                print("wake %d pump %d: on %s of %s ms, remaining %s, done %.1f ms after due, %s" %
+                      (wake, pump, fields[2], fields[1], fields[3], latency, "ok" if ok else "FAILED"))
+    finally:
+        await broker.stop()
+        shutil.rmtree(directory)
+    print("latency after the end of a run: median %.1f ms, max %.1f ms, target %.0f ms" %
+          (statistics.median(latencies), max(latencies), args.target_ms))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -9,10 +9,40 @@
   const char TEXT_REMAINING[] PROGMEM =       "Water lasts";
   const char TEXT_DAY[] PROGMEM =             "day";
   const char TEXT_DAYS[] PROGMEM =            "days";
+  const char TEXT_UI_PUMPS[] PROGMEM =        "Pumps";
+  const char TEXT_UI_PUMP[] PROGMEM =         "Pump";
+  const char TEXT_UI_TANK[] PROGMEM =         "Tank";
+  const char TEXT_UI_DIAG[] PROGMEM =         "Diagnostics";
+  const char TEXT_UI_OFF[] PROGMEM =          "off";
+  const char TEXT_UI_INTERVAL[] PROGMEM =     "Interval";
+  const char TEXT_UI_AMOUNT[] PROGMEM =       "Amount";
+  const char TEXT_UI_NEXT[] PROGMEM =         "Next in";
+  const char TEXT_UI_SIZE[] PROGMEM =         "Size";
+  const char TEXT_UI_WATER[] PROGMEM =        "Water";
+  const char TEXT_UI_CORRECTION[] PROGMEM =   "Correction";
+  const char TEXT_UI_BATTERY[] PROGMEM =      "Battery";
+  const char TEXT_UI_AWAKE[] PROGMEM =        "Awake";
+  const char TEXT_BUTTON_NEXT[] PROGMEM =     ">";
+  const char TEXT_BUTTON_CHANGE[] PROGMEM =   "+";
 #elif LANG == 'G'
   const char TEXT_BY[] PROGMEM =              "von";
   const char TEXT_VERSION[] PROGMEM =         "Version";
   const char TEXT_REMAINING[] PROGMEM =       "Wasser reicht";
   const char TEXT_DAY[] PROGMEM =             "Tag";
   const char TEXT_DAYS[] PROGMEM =            "Tage";
+  const char TEXT_UI_PUMPS[] PROGMEM =        "Pumpen";
+  const char TEXT_UI_PUMP[] PROGMEM =         "Pumpe";
+  const char TEXT_UI_TANK[] PROGMEM =         "Tank";
+  const char TEXT_UI_DIAG[] PROGMEM =         "Diagnose";
+  const char TEXT_UI_OFF[] PROGMEM =          "aus";
+  const char TEXT_UI_INTERVAL[] PROGMEM =     "Intervall";
+  const char TEXT_UI_AMOUNT[] PROGMEM =       "Menge";
+  const char TEXT_UI_NEXT[] PROGMEM =         "Wieder in";
+  const char TEXT_UI_SIZE[] PROGMEM =         "Volumen";
+  const char TEXT_UI_WATER[] PROGMEM =        "Wasser";
+  const char TEXT_UI_CORRECTION[] PROGMEM =   "Korrektur";
+  const char TEXT_UI_BATTERY[] PROGMEM =      "Akku";
+  const char TEXT_UI_AWAKE[] PROGMEM =        "Wach";
+  const char TEXT_BUTTON_NEXT[] PROGMEM =     ">";
+  const char TEXT_BUTTON_CHANGE[] PROGMEM =   "+";
 #endif
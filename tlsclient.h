@@ -0,0 +1,274 @@
+//***************************************************************************************************
+//  tlsclient:    TLS client for PubSubClient on mbedtls directly, so the session survives deep sleep.
+//                WiFiClientSecure starts every connect with a full handshake, here the session of the
+//                last handshake is saved with mbedtls_ssl_session_save() into RTC memory and loaded
+//                into the next connect. The broker then resumes it with its session ticket or session
+//                ID, one round trip and no certificate or key exchange. A full handshake happens after
+//                power on, when the broker has dropped the session or the ticket has expired, and the
+//                session it makes is saved again. The saved session holds the broker certificate, an
+//                ECDSA P-256 one keeps it small and the full handshake fast, see MQTT_TLS.
+//***************************************************************************************************
+
+#ifndef tlsclient_h
+#define tlsclient_h
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/net_sockets.h"
+
+RTC_DATA_ATTR uint8_t tlsSession[MQTT_TLS_SESSION_SIZE];    // mbedtls_ssl_session_save() of the last handshake
+RTC_DATA_ATTR uint16_t tlsSessionLength = 0;                // 0 if none
+
+class TlsClient : public Client {
+public:
+  TlsClient() : ready(false), open(false), resumedSession(false), peeked(-1), timeoutMs(5000), caCert(NULL) {
+  }
+
+  void setCACert(const char* pem) {
+    caCert = pem;
+  }
+
+  void setHandshakeTimeout(unsigned long seconds) {
+    timeoutMs = seconds * 1000;
+  }
+
+  bool resumed() {
+    // the last handshake resumed the saved session
+    return resumedSession;
+  }
+
+  int connect(IPAddress ip, uint16_t port) override {
+    return 0;                           // the certificate is checked against the host name
+  }
+
+  int connect(const char* host, uint16_t port) override {
+    mbedtls_ssl_session session;
+    bool offered = false;
+    bool certificateSent = false;
+    unsigned long startTime;
+    size_t length;
+    int ret;
+
+    stop();
+    if(!setup() || !tcp.connect(host, port)) {
+      return 0;
+    }
+    mbedtls_ssl_session_reset(&ssl);
+    mbedtls_ssl_set_hostname(&ssl, host);
+    mbedtls_ssl_set_bio(&ssl, &tcp, bioSend, bioRecv, NULL);
+
+    // offer the saved session
+    resumedSession = false;
+    mbedtls_ssl_session_init(&session);
+    if(tlsSessionLength > 0 && mbedtls_ssl_session_load(&session, tlsSession, tlsSessionLength) == 0 &&
+       mbedtls_ssl_set_session(&ssl, &session) == 0) {
+      offered = true;
+    }
+    mbedtls_ssl_session_free(&session);
+
+    // stepwise as mbedtls_ssl_handshake(), a resumed session skips the certificate of the broker
+    startTime = millis();
+    while(ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+      ret = mbedtls_ssl_handshake_step(&ssl);
+      if(ssl.state == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+        certificateSent = true;
+      }
+      if(ret == 0) {
+        continue;
+      }
+      if((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+         millis() - startTime > timeoutMs) {
+        LOG_E("TLS: handshake failed, mbedtls %d", ret);
+        tlsSessionLength = 0;           // the next one is a full handshake anyway
+        tcp.stop();
+        return 0;
+      }
+      delay(1);
+    }
+    open = true;
+    resumedSession = offered && !certificateSent;
+
+    // a full handshake brought a new session, a resumed one may carry a new ticket
+    mbedtls_ssl_session_init(&session);
+    tlsSessionLength = 0;
+    if(mbedtls_ssl_get_session(&ssl, &session) == 0) {
+      ret = mbedtls_ssl_session_save(&session, tlsSession, sizeof(tlsSession), &length);
+      if(ret == 0) {
+        tlsSessionLength = length;
+      } else {
+        LOG_W("TLS: session not saved, %u bytes needed, MQTT_TLS_SESSION_SIZE %u",
+              (unsigned)length, (unsigned)sizeof(tlsSession));
+      }
+    }
+    mbedtls_ssl_session_free(&session);
+    LOG_I("TLS: %s handshake in %lu ms", resumedSession ? "resumed" : "full", millis() - startTime);
+    return 1;
+  }
+
+  size_t write(uint8_t byte) override {
+    return write(&byte, 1);
+  }
+
+  size_t write(const uint8_t* buffer, size_t size) override {
+    size_t written = 0;
+    int ret;
+
+    while(open && written < size) {
+      ret = mbedtls_ssl_write(&ssl, buffer + written, size - written);
+      if(ret > 0) {
+        written += ret;
+      } else if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        stop();
+      }
+    }
+    return written;
+  }
+
+  int available() override {
+    int ret;
+
+    if(!open) {
+      return 0;
+    }
+    // a read of 0 bytes decrypts the next record, if one has come
+    ret = mbedtls_ssl_read(&ssl, NULL, 0);
+    if(ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      return 0;
+    }
+    return mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+  }
+
+  int read() override {
+    uint8_t byte;
+
+    return read(&byte, 1) == 1 ? byte : -1;
+  }
+
+  int read(uint8_t* buffer, size_t size) override {
+    int count = 0;
+    int ret;
+
+    if(size == 0) {
+      return 0;
+    }
+    if(peeked >= 0) {
+      buffer[count++] = peeked;
+      peeked = -1;
+    }
+    if(!open || count == (int)size || (count > 0 && mbedtls_ssl_get_bytes_avail(&ssl) == 0)) {
+      return count > 0 ? count : -1;
+    }
+    ret = mbedtls_ssl_read(&ssl, buffer + count, size - count);
+    if(ret > 0) {
+      return count + ret;
+    }
+    if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+    }
+    return count > 0 ? count : -1;
+  }
+
+  int peek() override {
+    if(peeked < 0) {
+      peeked = read();
+    }
+    return peeked;
+  }
+
+  void flush() override {
+  }
+
+  void stop() override {
+    if(open) {
+      mbedtls_ssl_close_notify(&ssl);
+      open = false;
+    }
+    peeked = -1;
+    tcp.stop();
+  }
+
+  uint8_t connected() override {
+    return open && tcp.connected();
+  }
+
+  operator bool() override {
+    return connected();
+  }
+
+private:
+  WiFiClient tcp;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_x509_crt ca;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  bool ready;                           // contexts set up, once per wake
+  bool open;                            // handshake done
+  bool resumedSession;
+  int peeked;                           // byte taken by peek(), -1 if none
+  unsigned long timeoutMs;
+  const char* caCert;
+
+  bool setup() {
+    if(ready) {
+      return true;
+    }
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_x509_crt_init(&ca);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    if(mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0) != 0 ||
+       mbedtls_x509_crt_parse(&ca, (const unsigned char*)caCert, strlen(caCert) + 1) != 0 ||
+       mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                   MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+      LOG_E("TLS: setup failed, check SECRET_MQTT_CA_CERT");
+      release();
+      return false;
+    }
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&conf, &ca, NULL);
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    if(mbedtls_ssl_setup(&ssl, &conf) != 0) {
+      release();
+      return false;
+    }
+    ready = true;
+    return true;
+  }
+
+  void release() {
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_x509_crt_free(&ca);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+  }
+
+  static int bioSend(void* context, const unsigned char* buffer, size_t length) {
+    WiFiClient* client = (WiFiClient*)context;
+    size_t written = client->write(buffer, length);
+
+    if(written == 0) {
+      return client->connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return written;
+  }
+
+  static int bioRecv(void* context, unsigned char* buffer, size_t length) {
+    WiFiClient* client = (WiFiClient*)context;
+    int count;
+
+    if(client->available() <= 0) {
+      return client->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    count = client->read(buffer, length);
+    return count > 0 ? count : MBEDTLS_ERR_SSL_WANT_READ;
+  }
+};
+
+#endif
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  fontsubset:   Makes fonts.h with subsets of the GFX free fonts the sketch uses, only the glyphs
+#                of the texts in texts.h, the texts drawn in the sketch and DEFAULT_CHARS. The text of
+#                every drawString() with a free font is followed to its literals: through texts of
+#                texts.h, the callers of the function it is a parameter of and the format.h calls
+#                that fill a buffer. A text it cannot follow stops the tool, a missing glyph would
+#                only show as a gap on the display.
+#                Run it again after texts change, then set USE_FONT_SUBSET in settings.h:
+#                  tools/fontsubset.py ~/Arduino/libraries/TFT_eSPI/Fonts/GFXFF
+#                GFX fonts address glyphs by a range of character codes, glyphs in the range that
+#                are not needed stay in the table with an empty bitmap.
+#                --smooth prints the characters as the unicode list for TFT_eSPI's Create_font
+#                Processing sketch instead, for anti aliased fonts loaded with tft.loadFont().
+#***************************************************************************************************
+
+import argparse
+import os
+import re
+import sys
+
+# font macro in Free_Fonts.h and the font file of TFT_eSPI/Fonts/GFXFF
+FONTS = {
+    "FSS9": "FreeSans9pt7b",
+    "FSS12": "FreeSans12pt7b",
+}
+
+# space and the characters a number can bring, see NUMBER_WRITERS
+DEFAULT_CHARS = " 0123456789-."
+
+# format.h functions that append a number to the buffer in their first argument
+NUMBER_WRITERS = {"fmtAppendInt", "fmtAppendUInt", "fmtAppendPadded", "fmtAppendFixed", "fmtAppendUnit"}
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCES = ["TTGOPlantNanny.ino"] + sorted(name for name in os.listdir(ROOT) if name.endswith(".h") and
+                                          name not in ("fonts.h", "Free_Fonts.h", "icons.h"))
+
+
+class Unseen(Exception):
+    """a text drawn with a subset font whose characters the scanner cannot tell"""
+
+
+def string_literals(text):
+    return [bytes(s, "ascii").decode("unicode_escape") for s in re.findall(r'"((?:[^"\\]|\\.)*)"', text)]
+
+
+def call_args(text, start):
+    """arguments of the call whose '(' is at start, split at the top level commas"""
+    args = []
+    depth = 0
+    current = start + 1
+    i = start
+    while i < len(text):
+        char = text[i]
+        if char in "\"'":
+            end = i + 1
+            while text[end] != char:
+                end += 2 if text[end] == "\\" else 1
+            i = end
+        elif char in "([{":
+            depth += 1
+        elif char in ")]}":
+            depth -= 1
+            if depth == 0:
+                args.append(text[current:i].strip())
+                return args
+        elif char == "," and depth == 1:
+            args.append(text[current:i].strip())
+            current = i + 1
+        i += 1
+    return args
+
+
+class Sources:
+    def __init__(self):
+        self.texts = {}                 # const char NAME[] and #define NAME, all languages
+        self.functions = []             # (name, parameters, file, start, end, text)
+        for file in SOURCES:
+            with open(os.path.join(ROOT, file)) as source:
+                text = source.read()
+            for name, literals in re.findall(r'\b(\w+)\[\]\s*(?:PROGMEM\s*)?=\s*((?:"(?:[^"\\]|\\.)*"\s*)+);', text):
+                self.texts.setdefault(name, []).extend(string_literals(literals))
+            for name, literals in re.findall(r'^#define\s+(\w+)\s+((?:"(?:[^"\\]|\\.)*"\s*)+)', text, re.M):
+                self.texts.setdefault(name, []).extend(string_literals(literals))
+            starts = [(match.group(1), match.group(2), match.start())
+                      for match in re.finditer(r"^[A-Za-z_][\w\s\*&:]*?\b(\w+)\(([^;{)]*)\)\s*\{", text, re.M)]
+            for number, (name, parameters, start) in enumerate(starts):
+                end = starts[number + 1][2] if number + 1 < len(starts) else len(text)
+                parameters = [parameter.split()[-1].strip("*&") for parameter in parameters.split(",") if parameter.strip()]
+                self.functions.append((name, parameters, file, start, end, text))
+
+    def where(self, function, offset):
+        name, parameters, file, start, end, text = function
+        return "%s:%d" % (file, text.count("\n", 0, start + offset) + 1)
+
+    def resolve(self, expression, function, offset, depth=0):
+        """characters expression can hold in function"""
+        name, parameters, file, start, end, text = function
+        body = text[start:end]
+        if expression.startswith('"'):
+            return set("".join(string_literals(expression)))
+        if expression in self.texts:
+            return set("".join(self.texts[expression]))
+        if not re.fullmatch(r"\w+", expression) or depth > 4:
+            raise Unseen("%s: %s" % (self.where(function, offset), expression))
+        if expression in parameters:
+            # whatever the callers pass
+            index = parameters.index(expression)
+            chars = set()
+            found = False
+            for caller in self.functions:
+                caller_body = caller[5][caller[3]:caller[4]]
+                for match in re.finditer(r"(?<![\w.])" + name + r"\s*\(", caller_body):
+                    args = call_args(caller_body, match.end() - 1)
+                    if caller_body[:match.start()].rstrip().endswith(("void", "bool", "int")) or index >= len(args):
+                        continue        # the definition
+                    chars |= self.resolve(args[index], caller, match.start(), depth + 1)
+                    found = True
+            if not found:
+                raise Unseen("%s: %s, no caller of %s()" % (self.where(function, offset), expression, name))
+            return chars
+        declaration = re.search(r"\bchar\s+" + expression + r"\s*\[[^\]]*\]\s*(=\s*[^;]*)?;", body)
+        if declaration is None or declaration.group(1):
+            raise Unseen("%s: %s" % (self.where(function, offset), expression))
+        # a buffer of the function, filled by the format.h functions
+        chars = set()
+        for match in re.finditer(r"(?<![\w.])(\w+)\s*\(", body):
+            args = call_args(body, match.end() - 1)
+            if expression not in args and "sizeof(%s)" % expression not in args:
+                continue
+            writer = match.group(1)
+            if writer in ("sizeof", "drawString"):
+                continue
+            if not args or args[0] != expression:
+                raise Unseen("%s: %s written by %s()" % (self.where(function, match.start()), expression, writer))
+            if writer == "fmtAppend":
+                chars |= self.resolve(args[2], function, match.start(), depth + 1)
+            elif writer == "fmtAppendChar" and re.fullmatch(r"'(\\?.)'", args[2]):
+                chars |= set(bytes(args[2][1:-1], "ascii").decode("unicode_escape"))
+            elif writer in NUMBER_WRITERS:
+                if writer == "fmtAppendUnit":
+                    chars |= self.resolve(args[4], function, match.start(), depth + 1)
+            else:
+                raise Unseen("%s: %s written by %s()" % (self.where(function, match.start()), expression, writer))
+        return chars
+
+
+def used_chars():
+    """characters of texts.h and of every text drawn with a free font, fails on those it can't tell"""
+    sources = Sources()
+    chars = set(DEFAULT_CHARS)
+    with open(os.path.join(ROOT, "texts.h")) as file:
+        for literal in string_literals(file.read()):
+            chars.update(literal)
+    unseen = []
+    for function in sources.functions:
+        name, parameters, file, start, end, text = function
+        body = text[start:end]
+        for match in re.finditer(r"(?<![\w])drawString\s*\(", body):
+            args = call_args(body, match.end() - 1)
+            if len(args) < 4 or args[3] != "GFXFF":
+                continue                # built-in fonts are not subset
+            fonts = re.findall(r"\bset(FreeFont|TextFont)\s*\(", body[:match.start()])
+            if fonts and fonts[-1] == "TextFont":
+                continue                # GFXFF after setTextFont() draws the built-in font
+            try:
+                chars |= sources.resolve(args[0], function, match.start())
+            except Unseen as error:
+                if str(error) not in unseen:
+                    unseen.append(str(error))
+    if unseen:
+        for error in unseen:
+            sys.stderr.write("%s: text drawn with a subset font that the scanner cannot see\n" % error)
+        sys.exit("draw a literal, a text of texts.h or a buffer filled by format.h")
+    return chars
+
+
+def parse_font(path, name):
+    with open(path) as file:
+        text = file.read()
+    bitmaps = re.search(name + r"Bitmaps\[\]\s*PROGMEM\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    glyphs = re.search(name + r"Glyphs\[\]\s*PROGMEM\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    font = re.search(r"GFXfont\s+" + name + r"\s*PROGMEM\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    bitmaps = [int(value, 16) for value in re.findall(r"0x[0-9A-Fa-f]+", bitmaps)]
+    glyphs = [tuple(int(value) for value in glyph.split(","))
+              for glyph in re.findall(r"\{\s*(-?\d+\s*(?:,\s*-?\d+\s*){5})\}", glyphs)]
+    first, last, y_advance = [int(value, 0) for value in re.findall(r"0x[0-9A-Fa-f]+|\b\d+\b", font)[-3:]]
+    return bitmaps, glyphs, first, last, y_advance
+
+
+def subset(name, macro, path, chars):
+    bitmaps, glyphs, first, last, y_advance = parse_font(path, name)
+    codes = sorted(ord(char) for char in chars if first <= ord(char) <= last)
+    new_name = name.replace("7b", "Subset")
+    out_bitmaps = []
+    out_glyphs = []
+    for code in range(codes[0], codes[-1] + 1):
+        offset, width, height, x_advance, x_offset, y_offset = glyphs[code - first]
+        if code not in codes:
+            out_glyphs.append(((0, 0, 0, 0, 0, 0), code))
+            continue
+        size = (width * height + 7) // 8
+        out_glyphs.append(((len(out_bitmaps), width, height, x_advance, x_offset, y_offset), code))
+        out_bitmaps.extend(bitmaps[offset:offset + size])
+
+    lines = ["const uint8_t %sBitmaps[] PROGMEM = {" % new_name]
+    for i in range(0, len(out_bitmaps), 12):
+        lines.append("  " + ", ".join("0x%02X" % value for value in out_bitmaps[i:i + 12]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("const GFXglyph %sGlyphs[] PROGMEM = {" % new_name)
+    for glyph, code in out_glyphs:
+        lines.append("  { %5d, %3d, %3d, %3d, %4d, %4d },   // 0x%02X %s"
+                     % (glyph + (code, repr(chr(code)) if code in codes else "not used")))
+    lines.append("};")
+    lines.append("")
+    lines.append("const GFXfont %s PROGMEM = {" % new_name)
+    lines.append("  (uint8_t  *)%sBitmaps," % new_name)
+    lines.append("  (GFXglyph *)%sGlyphs," % new_name)
+    lines.append("  0x%02X, 0x%02X, %d };" % (codes[0], codes[-1], y_advance))
+    lines.append("")
+    lines.append("#undef %s" % macro)
+    lines.append("#define %s &%s" % (macro, new_name))
+    lines.append("")
+    sys.stderr.write("%s: %d of %d bytes bitmap, %d of %d glyphs\n"
+                     % (macro, len(out_bitmaps), len(bitmaps), len(out_glyphs), len(glyphs)))
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="GFX font subsets for the used texts")
+    parser.add_argument("fontdir", nargs="?", help="TFT_eSPI/Fonts/GFXFF")
+    parser.add_argument("--chars", default="", help="additional characters")
+    parser.add_argument("--smooth", action="store_true", help="print the unicode list for Create_font")
+    parser.add_argument("--output", default=os.path.join(ROOT, "fonts.h"))
+    args = parser.parse_args()
+
+    chars = used_chars() | set(args.chars)
+    if args.smooth:
+        print("static final int[] specificUnicodes = {")
+        print("  " + ", ".join("0x%04X" % code for code in sorted(ord(char) for char in chars)))
+        print("};")
+        return
+    if args.fontdir is None:
+        parser.error("fontdir is needed without --smooth")
+
+    lines = ["//***************************************************************************************************",
+             "//  fonts:        made by tools/fontsubset.py, do not edit, see USE_FONT_SUBSET in settings.h",
+             "//***************************************************************************************************",
+             "",
+             "#ifndef fonts_h",
+             "#define fonts_h",
+             ""]
+    for macro, name in FONTS.items():
+        lines.extend(subset(name, macro, os.path.join(args.fontdir, name + ".h"), chars))
+    lines.append("#endif")
+    with open(args.output, "w") as file:
+        file.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
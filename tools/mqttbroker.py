@@ -0,0 +1,392 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  mqttbroker:   Small MQTT 3.1.1 broker for tests and benchmarks on the host, so mqttCallback(),
+#                mqttSubscribeToTopics() and mqttPublishValue() can be tried without a real broker.
+#                Connect with clean or persistent session, subscribe with '+' and '#', QoS 0 and 1,
+#                retained messages and the last will. A persistent session keeps its subscriptions
+#                and queues QoS 1 messages while the client sleeps, as the nannies expect it.
+#                Faults for tests: --latency delays every delivery, --loss drops messages in both
+#                directions and --disconnect closes connections at random.
+#                  tools/mqttbroker.py --port 1883 --loss 5 --stats 10
+#                Embedded in a python test, the broker runs in the event loop of the test:
+#                  broker = Broker(loss=5)
+#                  await broker.start("127.0.0.1", 0)      # broker.port is the port it got
+#                --cert and --key serve TLS as MQTT_TLS expects it, with session tickets, the --stats
+#                report counts the handshakes that resumed a session, see tlsclient.h.
+#                  tools/mqttbroker.py --port 8883 --cert broker.pem --key broker.key --stats 60
+#                No authentication, user and password are accepted as they come.
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import collections
+import random
+import ssl
+import struct
+import sys
+import time
+
+CONNECT = 1
+CONNACK = 2
+PUBLISH = 3
+PUBACK = 4
+SUBSCRIBE = 8
+SUBACK = 9
+UNSUBSCRIBE = 10
+UNSUBACK = 11
+PINGREQ = 12
+PINGRESP = 13
+DISCONNECT = 14
+
+QUEUE_LIMIT = 1000                      # messages kept per sleeping client, the oldest are dropped
+
+
+def encode_length(length):
+    encoded = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | 0x80 if length > 0 else byte)
+        if length == 0:
+            return bytes(encoded)
+
+
+def encode_string(text):
+    return struct.pack("!H", len(text)) + text
+
+
+def packet(kind, flags, body):
+    return bytes([(kind << 4) | flags]) + encode_length(len(body)) + body
+
+
+def publish_packet(topic, payload, qos, retain, packet_id, dup=False):
+    flags = (dup << 3) | (qos << 1) | retain
+    body = encode_string(topic)
+    if qos > 0:
+        body += struct.pack("!H", packet_id)
+    return packet(PUBLISH, flags, body + payload)
+
+
+class Node:
+    __slots__ = ("children", "subscribers")
+
+    def __init__(self):
+        self.children = {}
+        self.subscribers = {}           # client id: qos
+
+
+class Subscriptions:
+    """topic filters in a tree by level, a publish only walks the levels of its topic"""
+
+    def __init__(self):
+        self.root = Node()
+
+    def add(self, topic_filter, client_id, qos):
+        node = self.root
+        for level in topic_filter.split(b"/"):
+            node = node.children.setdefault(level, Node())
+        node.subscribers[client_id] = qos
+
+    def remove(self, topic_filter, client_id):
+        node = self.root
+        for level in topic_filter.split(b"/"):
+            node = node.children.get(level)
+            if node is None:
+                return
+        node.subscribers.pop(client_id, None)
+
+    def match(self, topic):
+        found = {}
+        self._match(self.root, topic.split(b"/"), 0, topic.startswith(b"$"), found)
+        return found
+
+    def _match(self, node, levels, index, system, found):
+        wildcard_allowed = not (system and index == 0)
+        if wildcard_allowed and b"#" in node.children:
+            self._add(found, node.children[b"#"].subscribers)
+        if index == len(levels):
+            self._add(found, node.subscribers)
+            return
+        child = node.children.get(levels[index])
+        if child is not None:
+            self._match(child, levels, index + 1, system, found)
+        if wildcard_allowed and b"+" in node.children:
+            self._match(node.children[b"+"], levels, index + 1, system, found)
+
+    @staticmethod
+    def _add(found, subscribers):
+        for client_id, qos in subscribers.items():
+            if qos > found.get(client_id, -1):
+                found[client_id] = qos
+
+
+def filter_matches(topic_filter, topic):
+    filter_levels = topic_filter.split(b"/")
+    topic_levels = topic.split(b"/")
+    if topic.startswith(b"$") and filter_levels[0] in (b"+", b"#"):
+        return False
+    for index, level in enumerate(filter_levels):
+        if level == b"#":
+            return True
+        if index >= len(topic_levels) or (level != b"+" and level != topic_levels[index]):
+            return False
+    return len(filter_levels) == len(topic_levels)
+
+
+class Session:
+    def __init__(self, client_id, clean):
+        self.client_id = client_id
+        self.clean = clean
+        self.filters = {}               # topic filter: qos
+        self.inflight = collections.OrderedDict()     # packet id: [topic, payload, sent], QoS 1 not acknowledged
+        self.next_id = 1
+        self.writer = None
+
+    def packet_id(self):
+        packet_id = self.next_id
+        self.next_id = self.next_id % 65535 + 1
+        return packet_id
+
+
+class Broker:
+    def __init__(self, latency=0.0, loss=0.0, disconnect=0.0):
+        self.latency = latency          # seconds added to every delivery
+        self.loss = loss / 100          # of messages dropped
+        self.disconnect = disconnect / 100      # of packets that close the connection instead
+        self.sessions = {}
+        self.subscriptions = Subscriptions()
+        self.retained = {}
+        self.server = None
+        self.port = None
+        self.received = 0
+        self.delivered = 0
+        self.handshakes = 0
+        self.resumed = 0
+
+    async def start(self, host, port, tls=None):
+        self.server = await asyncio.start_server(self.serve, host, port, ssl=tls)
+        self.port = self.server.sockets[0].getsockname()[1]
+
+    async def stop(self):
+        self.server.close()
+        await self.server.wait_closed()
+
+    def lost(self):
+        return self.loss > 0 and random.random() < self.loss
+
+    def send(self, session, data):
+        if session.writer is None:
+            return
+        if self.latency > 0:
+            asyncio.get_running_loop().call_later(self.latency, self.write, session, session.writer, data)
+        else:
+            self.write(session, session.writer, data)
+
+    @staticmethod
+    def write(session, writer, data):
+        if session.writer is writer and not writer.is_closing():
+            writer.write(data)
+
+    def deliver(self, session, topic, payload, qos, retain=False):
+        if qos > 0:
+            packet_id = session.packet_id()
+            session.inflight[packet_id] = [topic, payload, session.writer is not None]
+            if len(session.inflight) > QUEUE_LIMIT:
+                session.inflight.popitem(last=False)
+        else:
+            packet_id = 0
+        if session.writer is None:
+            return
+        if self.lost():
+            return                      # QoS 1 is sent again on the next connect
+        self.delivered += 1
+        self.send(session, publish_packet(topic, payload, qos, retain, packet_id))
+
+    def publish(self, topic, payload, qos, retain):
+        self.received += 1
+        if retain:
+            if payload:
+                self.retained[topic] = (payload, qos)
+            else:
+                self.retained.pop(topic, None)
+        for client_id, sub_qos in self.subscriptions.match(topic).items():
+            session = self.sessions.get(client_id)
+            if session is not None and (session.writer is not None or not session.clean):
+                self.deliver(session, topic, payload, min(qos, sub_qos))
+
+    async def serve(self, reader, writer):
+        session = None
+        will = None
+        tls = writer.get_extra_info("ssl_object")
+        if tls is not None:
+            self.handshakes += 1
+            self.resumed += tls.session_reused
+        try:
+            session, will = await self.connect(reader, writer)
+            if session is None:
+                return
+            while True:
+                header = await reader.readexactly(1)
+                length = await self.read_length(reader)
+                body = await reader.readexactly(length)
+                if self.disconnect > 0 and random.random() < self.disconnect:
+                    break
+                kind = header[0] >> 4
+                if kind == DISCONNECT:
+                    will = None
+                    break
+                self.handle(session, kind, header[0] & 0x0F, body)
+        except (asyncio.IncompleteReadError, ConnectionError, ValueError):
+            pass
+        finally:
+            if session is not None and session.writer is writer:
+                session.writer = None
+                if session.clean:
+                    self.drop(session)
+            if will is not None:
+                self.publish(*will)
+            writer.close()
+
+    @staticmethod
+    async def read_length(reader):
+        length = 0
+        for shift in range(0, 28, 7):
+            byte = (await reader.readexactly(1))[0]
+            length |= (byte & 0x7F) << shift
+            if byte < 0x80:
+                return length
+        raise ValueError("remaining length too long")
+
+    async def connect(self, reader, writer):
+        header = await reader.readexactly(1)
+        if header[0] >> 4 != CONNECT:
+            return None, None
+        body = await reader.readexactly(await self.read_length(reader))
+        position = 2 + struct.unpack("!H", body[0:2])[0]
+        level, flags = body[position], body[position + 1]
+        position += 4                   # level, flags and keep alive
+        if level != 4:
+            writer.write(packet(CONNACK, 0, b"\x00\x01"))      # unacceptable protocol version
+            return None, None
+        client_id, position = self.read_string(body, position)
+        clean = bool(flags & 0x02)
+        will = None
+        if flags & 0x04:
+            will_topic, position = self.read_string(body, position)
+            will_payload, position = self.read_string(body, position)
+            will = (will_topic, will_payload, (flags >> 3) & 0x03, bool(flags & 0x20))
+        if not client_id:
+            client_id = b"anonymous-%d" % id(writer)
+        session = self.sessions.get(client_id)
+        if session is not None and session.writer is not None:
+            session.writer.close()      # taken over by the new connection
+        if session is not None and clean:
+            self.drop(session)
+            session = None
+        present = session is not None
+        if session is None:
+            session = Session(client_id, clean)
+            self.sessions[client_id] = session
+        session.clean = clean
+        session.writer = writer
+        writer.write(packet(CONNACK, 0, bytes([present, 0])))
+        # unacknowledged and queued QoS 1 in the order they were published
+        for packet_id, message in session.inflight.items():
+            self.delivered += 1
+            self.send(session, publish_packet(message[0], message[1], 1, False, packet_id, dup=message[2]))
+            message[2] = True
+        return session, will
+
+    @staticmethod
+    def read_string(body, position):
+        length = struct.unpack("!H", body[position:position + 2])[0]
+        return body[position + 2:position + 2 + length], position + 2 + length
+
+    def drop(self, session):
+        for topic_filter in session.filters:
+            self.subscriptions.remove(topic_filter, session.client_id)
+        self.sessions.pop(session.client_id, None)
+
+    def handle(self, session, kind, flags, body):
+        if kind == PUBLISH:
+            qos = (flags >> 1) & 0x03
+            topic, position = self.read_string(body, 0)
+            if qos > 0:
+                packet_id = body[position:position + 2]
+                position += 2
+                if not self.lost():
+                    self.send(session, packet(PUBACK, 0, packet_id))
+            if not self.lost():
+                self.publish(topic, body[position:], qos, bool(flags & 0x01))
+        elif kind == PUBACK:
+            session.inflight.pop(struct.unpack("!H", body[0:2])[0], None)
+        elif kind == SUBSCRIBE:
+            position = 2
+            granted = bytearray()
+            retained = []
+            while position < len(body):
+                topic_filter, position = self.read_string(body, position)
+                qos = min(body[position], 1)
+                position += 1
+                session.filters[topic_filter] = qos
+                self.subscriptions.add(topic_filter, session.client_id, qos)
+                granted.append(qos)
+                retained += [(topic, payload, min(qos, retained_qos))
+                             for topic, (payload, retained_qos) in self.retained.items()
+                             if filter_matches(topic_filter, topic)]
+            self.send(session, packet(SUBACK, 0, body[0:2] + bytes(granted)))
+            for topic, payload, qos in retained:
+                self.deliver(session, topic, payload, qos, retain=True)
+        elif kind == UNSUBSCRIBE:
+            position = 2
+            while position < len(body):
+                topic_filter, position = self.read_string(body, position)
+                session.filters.pop(topic_filter, None)
+                self.subscriptions.remove(topic_filter, session.client_id)
+            self.send(session, packet(UNSUBACK, 0, body[0:2]))
+        elif kind == PINGREQ:
+            self.send(session, packet(PINGRESP, 0, b""))
+
+
+async def report(broker, interval):
+    received, delivered, started = broker.received, broker.delivered, time.monotonic()
+    while True:
+        await asyncio.sleep(interval)
+        now = time.monotonic()
+        print("%d sessions, %.0f msg/s in, %.0f msg/s out" % (
+            len(broker.sessions), (broker.received - received) / (now - started),
+            (broker.delivered - delivered) / (now - started)), file=sys.stderr)
+        if broker.handshakes:
+            print("%d TLS handshakes, %d resumed" % (broker.handshakes, broker.resumed), file=sys.stderr)
+        received, delivered, started = broker.received, broker.delivered, now
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="MQTT 3.1.1 broker for tests and benchmarks")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--latency", type=float, default=0, help="ms added to every delivery")
+    parser.add_argument("--loss", type=float, default=0, help="percent of messages dropped")
+    parser.add_argument("--disconnect", type=float, default=0, help="percent of packets that close the connection")
+    parser.add_argument("--stats", type=float, default=0, help="seconds between throughput reports")
+    parser.add_argument("--cert", help="PEM certificate chain of the broker, TLS if given")
+    parser.add_argument("--key", help="PEM private key of --cert")
+    args = parser.parse_args()
+
+    tls = None
+    if args.cert:
+        tls = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        tls.load_cert_chain(args.cert, args.key)
+    broker = Broker(args.latency / 1000, args.loss, args.disconnect)
+    await broker.start(args.host, args.port, tls)
+    print("listening on %s:%d" % (args.host, broker.port), file=sys.stderr)
+    if args.stats > 0:
+        asyncio.ensure_future(report(broker, args.stats))
+    await broker.server.serve_forever()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
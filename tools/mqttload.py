@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  mqttload:     Fleet load generator for the broker. Emulates N nannies that wake together, each wake
+#                as the sketch does it: connect with persistent session, subscribe to every command
+#                topic with QoS 1, publish battery-value, water-level, water-correction, forecast,
+#                heap, profile and the binary status frame, every METRICS_EXPORT_WAKES wakes the
+#                metrics, then disconnect. Topics are plant-nanny/<n>/... for n = 1..N.
+#                --spread spreads the connects of a wake over that many seconds, 0 is the worst case
+#                of all clocks on the full hour. Reports connect and subscribe latency percentiles
+#                and the throughput the broker delivered to a monitor subscribed to plant-nanny/#.
+#                  tools/mqttload.py --devices 10000 --wakes 3 --interval 30 --spread 2
+#                tools/mqttbroker.py is a local broker to try it against, for real figures use the
+#                broker of the installation. Plain TCP only, no TLS.
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import resource
+import struct
+import time
+
+# topic scheme of settings.h
+MAIN_TOPIC = b"plant-nanny"
+PUMP_COMMANDS = [b"command-freq", b"command-next", b"command-amount", b"command-water-now", b"command-need"]
+TANK_COMMANDS = [b"command-container", b"command-water", b"command-refill"]
+SYSTEM_COMMANDS = [b"command-log", b"command-ota", b"command-history"]
+METRICS_EXPORT_WAKES = 24
+# micro seconds per phase of profile.h, BOOT to LOOP, of a typical timer wake
+PROFILE_US = [310000, 48000, 95000, 1450000, 12000, 380000, 140000, 3010000]
+CPU_MHZ = 240
+
+
+def encode_length(length):
+    encoded = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | 0x80 if length > 0 else byte)
+        if length == 0:
+            return bytes(encoded)
+
+
+def encode_string(text):
+    return struct.pack("!H", len(text)) + text
+
+
+def packet(kind, flags, body):
+    return bytes([(kind << 4) | flags]) + encode_length(len(body)) + body
+
+
+def connect_packet(client_id, user, password, clean):
+    flags = (0x02 if clean else 0) | (0x80 if user else 0) | (0x40 if password else 0)
+    body = encode_string(b"MQTT") + bytes([4, flags]) + struct.pack("!H", 15) + encode_string(client_id)
+    if user:
+        body += encode_string(user)
+    if password:
+        body += encode_string(password)
+    return packet(1, 0, body)
+
+
+def publish_packet(topic, payload):
+    return packet(3, 0, encode_string(topic) + payload)
+
+
+async def read_packet(reader):
+    header = (await reader.readexactly(1))[0]
+    length = 0
+    for shift in range(0, 28, 7):
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            break
+    return header >> 4, await reader.readexactly(length)
+
+
+def tank_topic(name, tank):
+    # the first tank uses the plain topics, see tankTopic()
+    return name if tank == 0 else b"tank%d/%s" % (tank + 1, name)
+
+
+def command_topics(nanny, pumps, tanks):
+    prefix = MAIN_TOPIC + b"/%d/" % nanny
+    topics = [prefix + tank_topic(name, tank) for tank in range(tanks) for name in TANK_COMMANDS]
+    topics += [prefix + name for name in SYSTEM_COMMANDS]
+    topics += [prefix + b"%d/%s" % (pump, name) for pump in range(1, pumps + 1) for name in PUMP_COMMANDS]
+    return topics
+
+
+def wake_messages(nanny, pumps, tanks, wake):
+    prefix = MAIN_TOPIC + b"/%d/" % nanny
+    messages = [(prefix + b"battery-value", b"3.91")]
+    for tank in range(tanks):
+        messages.append((prefix + tank_topic(b"water-level", tank), b"1250"))
+        messages.append((prefix + tank_topic(b"water-correction", tank), b"1.000"))
+        messages.append((prefix + tank_topic(b"forecast", tank), b"96,1792000000"))
+    messages.append((prefix + b"heap", b"180000,175000,170000,110000,42,2100,800,0"))
+    if wake % METRICS_EXPORT_WAKES == METRICS_EXPORT_WAKES - 1:
+        messages.append((prefix + b"metrics", b"0:" + b",".join([b"1234"] * 10) + b";" +
+                         b",".join([b"56789"] * pumps) + b";" + b",".join([b"100"] * 4)))
+    # "us,...;cycles,..." as profileFormat(), BOOT has no cycles
+    cycles = [0] + [us * CPU_MHZ % 2 ** 32 for us in PROFILE_US[1:]]
+    messages.append((prefix + b"profile", b",".join(b"%d" % us for us in PROFILE_US) + b";" +
+                     b",".join(b"%d" % cycle for cycle in cycles)))
+    messages.append((prefix + b"status", bytes(18 + 2 * pumps)))
+    return messages
+
+
+class Results:
+    def __init__(self):
+        self.connect = []               # seconds, TCP connect to CONNACK
+        self.subscribe = []             # seconds, first SUBSCRIBE to last SUBACK
+        self.published = 0
+        self.failures = 0
+
+
+async def device_wake(args, nanny, wake, delay, results):
+    await asyncio.sleep(delay)
+    started = time.monotonic()
+    writer = None
+    try:
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+        writer.write(connect_packet(b"PlantNanny%d" % nanny, args.user, args.password, False))
+        kind, body = await asyncio.wait_for(read_packet(reader), args.timeout)
+        if kind != 2 or body[1] != 0:
+            raise ConnectionError("refused")
+        results.connect.append(time.monotonic() - started)
+
+        topics = command_topics(nanny, args.pumps, args.tanks)
+        subscribed = time.monotonic()
+        for packet_id, topic in enumerate(topics, 1):
+            writer.write(packet(8, 2, struct.pack("!H", packet_id) + encode_string(topic) + b"\x01"))
+        acknowledged = 0
+        while acknowledged < len(topics):
+            kind, body = await asyncio.wait_for(read_packet(reader), args.timeout)
+            if kind == 9:
+                acknowledged += 1       # queued commands are not acknowledged, they stay for the real device
+        results.subscribe.append(time.monotonic() - subscribed)
+
+        for topic, payload in wake_messages(nanny, args.pumps, args.tanks, wake):
+            writer.write(publish_packet(topic, payload))
+            results.published += 1
+        writer.write(packet(14, 0, b""))
+        await writer.drain()
+    except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ConnectionError):
+        results.failures += 1
+    finally:
+        if writer is not None:
+            writer.close()
+
+
+async def monitor(args, counts):
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    writer.write(connect_packet(b"PlantNannyLoadMonitor", args.user, args.password, True))
+    await read_packet(reader)
+    writer.write(packet(8, 2, struct.pack("!H", 1) + encode_string(MAIN_TOPIC + b"/#") + b"\x00"))
+    while True:
+        kind, body = await read_packet(reader)
+        if kind == 3:
+            counts.append(time.monotonic())
+
+
+def percentile(values, fraction):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def report(name, values):
+    print("%-10s p50 %7.1f ms  p90 %7.1f ms  p99 %7.1f ms  max %7.1f ms" % (
+        name, 1000 * percentile(values, 0.5), 1000 * percentile(values, 0.9),
+        1000 * percentile(values, 0.99), 1000 * max(values, default=float("nan"))))
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="emulates a fleet of plant nannies against a broker")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user", default="", help="as SECRET_MQTT_USER")
+    parser.add_argument("--password", default="", help="as SECRET_MQTT_PASSWORD")
+    parser.add_argument("--devices", type=int, default=100)
+    parser.add_argument("--pumps", type=int, default=4, help="NUMBER_OF_PUMPS")
+    parser.add_argument("--tanks", type=int, default=1, help="NUMBER_OF_TANKS")
+    parser.add_argument("--wakes", type=int, default=1, help="wakes per device")
+    parser.add_argument("--interval", type=float, default=3600, help="seconds between wakes")
+    parser.add_argument("--spread", type=float, default=0, help="seconds the connects of a wake are spread over")
+    parser.add_argument("--timeout", type=float, default=30, help="seconds for each step of a wake")
+    args = parser.parse_args()
+    args.user = args.user.encode()
+    args.password = args.password.encode()
+
+    # every device of a wake holds a socket
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < args.devices + 64:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (min(hard, args.devices + 64), hard))
+
+    counts = []
+    monitor_task = asyncio.ensure_future(monitor(args, counts))
+    await asyncio.sleep(0.2)
+    for wake in range(args.wakes):
+        results = Results()
+        started = time.monotonic()
+        received = len(counts)
+        await asyncio.gather(*[device_wake(args, nanny, wake, args.spread * (nanny - 1) / args.devices, results)
+                               for nanny in range(1, args.devices + 1)])
+        await asyncio.sleep(0.5)        # last deliveries to the monitor
+        window = counts[received:]
+        duration = time.monotonic() - started
+        print("wake %d: %d devices in %.2f s, %d failed, %d published" % (
+            wake + 1, args.devices, duration, results.failures, results.published))
+        report("connect", results.connect)
+        report("subscribe", results.subscribe)
+        if len(window) > 1:
+            print("broker     %d delivered to the monitor, %.0f msg/s" % (
+                len(window), len(window) / max(window[-1] - window[0], 1e-6)))
+        if wake + 1 < args.wakes:
+            await asyncio.sleep(max(0, args.interval - duration))
+    monitor_task.cancel()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  otadelta:     Patch from one firmware image to the next for the delta update of ota.h, see there
+#                for the format. Blocks of the new image that are anywhere in the old one are copied
+#                from the running partition, only the rest goes over the air. A block match, no
+#                bsdiff: code that moved by a few bytes still copies, code with changed addresses in
+#                it goes as new bytes.
+#                The patch is named as the nanny asks for it, after the ELF SHA-256 in the app
+#                description of the old image:
+#                  tools/otadelta.py build/old.bin build/new.bin --prefix firmware/plant-nanny-1.4
+#                  -> firmware/plant-nanny-1.4-0123456789abcdef.patch
+#                or with --output to any name.
+#***************************************************************************************************
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"PNDP"
+OP_COPY = 1
+OP_DATA = 2
+BLOCK = 32                              # shortest copy
+STRIDE = 4                              # of the old image indexed, a match may start between
+APP_DESC_OFFSET = 32                    # after the image and the first segment header
+APP_DESC_MAGIC = 0xABCD5432
+APP_ELF_SHA_OFFSET = APP_DESC_OFFSET + 144
+
+
+def elf_sha(image):
+    """first 16 hex digits of the ELF SHA-256 as esp_ota_get_app_elf_sha256(), None without app
+    description"""
+    if len(image) < APP_ELF_SHA_OFFSET + 8 or \
+            struct.unpack_from("<I", image, APP_DESC_OFFSET)[0] != APP_DESC_MAGIC:
+        return None
+    return image[APP_ELF_SHA_OFFSET:APP_ELF_SHA_OFFSET + 8].hex()
+
+
+def match_length(old, old_at, new, new_at):
+    """bytes that match from old_at and new_at on"""
+    length = 0
+    step = 4096
+    while step > 0:
+        while old[old_at + length:old_at + length + step] == new[new_at + length:new_at + length + step] and \
+                old_at + length + step <= len(old) and new_at + length + step <= len(new):
+            length += step
+        step //= 2
+    return length
+
+
+def diff(old, new):
+    """[(OP_COPY, offset, length) or (OP_DATA, bytes)] that make new out of old"""
+    index = {}
+    for offset in range(0, len(old) - BLOCK + 1, STRIDE):
+        index.setdefault(old[offset:offset + BLOCK], offset)
+    operations = []
+    literal = bytearray()
+    position = 0
+    while position < len(new):
+        old_at = index.get(new[position:position + BLOCK])
+        if old_at is None:
+            literal.append(new[position])
+            position += 1
+            continue
+        length = match_length(old, old_at, new, position)
+        position += length
+        # the index has every STRIDE byte, the match may start a bit before
+        while literal and old_at > 0 and old[old_at - 1] == literal[-1]:
+            literal.pop()
+            old_at -= 1
+            length += 1
+        if literal:
+            operations.append((OP_DATA, bytes(literal)))
+            literal = bytearray()
+        operations.append((OP_COPY, old_at, length))
+    if literal:
+        operations.append((OP_DATA, bytes(literal)))
+    return operations
+
+
+def patch(old, new):
+    """the patch as ota.h reads it"""
+    parts = [MAGIC, struct.pack("<I", len(new))]
+    for operation in diff(old, new):
+        if operation[0] == OP_COPY:
+            parts.append(struct.pack("<BII", OP_COPY, operation[1], operation[2]))
+        else:
+            parts.append(struct.pack("<BI", OP_DATA, len(operation[1])))
+            parts.append(operation[1])
+    return b"".join(parts)
+
+
+def apply(old, data):
+    """new image out of old and a patch, as ota.h does it"""
+    if data[:4] != MAGIC:
+        raise ValueError("not a patch")
+    size = struct.unpack_from("<I", data, 4)[0]
+    new = bytearray()
+    position = 8
+    while position < len(data):
+        if data[position] == OP_COPY:
+            offset, length = struct.unpack_from("<II", data, position + 1)
+            new += old[offset:offset + length]
+            position += 9
+        else:
+            length = struct.unpack_from("<I", data, position + 1)[0]
+            new += data[position + 5:position + 5 + length]
+            position += 5 + length
+    if len(new) != size:
+        raise ValueError("patch ends at %d of %d bytes" % (len(new), size))
+    return bytes(new)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="patch for the delta OTA update of ota.h")
+    parser.add_argument("old", help="image running on the nannies")
+    parser.add_argument("new", help="image to update to")
+    parser.add_argument("--prefix", help="OTA_URL_PREFIX + version as file name, the ELF SHA-256 is appended")
+    parser.add_argument("--output", help="file name of the patch instead of --prefix")
+    args = parser.parse_args()
+    with open(args.old, "rb") as file:
+        old = file.read()
+    with open(args.new, "rb") as file:
+        new = file.read()
+    if args.output:
+        output = args.output
+    elif args.prefix and elf_sha(old):
+        output = "%s-%s.patch" % (args.prefix, elf_sha(old))
+    else:
+        sys.exit(("--output needed, %s has no app description" % args.old) if args.prefix else "--prefix or --output")
+    data = patch(old, new)
+    if apply(old, data) != new:
+        sys.exit("patch does not rebuild %s" % args.new)
+    with open(output, "wb") as file:
+        file.write(data)
+    print("%s: %d bytes, %.1f %% of %d" % (output, len(data), 100 * len(data) / len(new), len(new)))
+
+
+if __name__ == "__main__":
+    main()
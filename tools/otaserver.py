@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  otaserver:    Small HTTP server for the firmware update of ota.h on the host, serves the images
+#                and patches of a directory with range requests, as the nanny resumes a download.
+#                Faults for tests: --cut closes every response after that many bytes of the body,
+#                as a wake that runs out of radio time, --rate limits the bytes per second. Counts
+#                the body bytes sent, the --stats report shows them per file.
+#                  tools/otaserver.py --directory firmware --port 8080 --cut 100000
+#                Embedded in a python test, the server runs in the event loop of the test:
+#                  server = Server("firmware", cut=100000)
+#                  await server.start("127.0.0.1", 0)      # server.port is the port it got
+#                GET only, one request per connection, no TLS.
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import collections
+import os
+import re
+import sys
+
+CHUNK = 1024
+
+
+class Server:
+    def __init__(self, directory, cut=0, rate=0.0):
+        self.directory = directory
+        self.cut = cut                  # body bytes per response, 0 all
+        self.rate = rate                # bytes per second, 0 unlimited
+        self.server = None
+        self.port = None
+        self.sent = collections.Counter()       # body bytes per file
+        self.requests = []              # (file, first byte, status)
+
+    async def start(self, host, port):
+        self.server = await asyncio.start_server(self.serve, host, port)
+        self.port = self.server.sockets[0].getsockname()[1]
+
+    async def stop(self):
+        self.server.close()
+        await self.server.wait_closed()
+
+    @staticmethod
+    def respond(writer, status, reason, headers=()):
+        lines = ["HTTP/1.1 %d %s" % (status, reason)] + list(headers) + ["Connection: close", "", ""]
+        writer.write("\r\n".join(lines).encode())
+
+    async def serve(self, reader, writer):
+        try:
+            request = (await reader.readline()).decode(errors="replace").split()
+            headers = {}
+            while True:
+                line = (await reader.readline()).decode(errors="replace").strip()
+                if not line:
+                    break
+                name, _, value = line.partition(":")
+                headers[name.strip().lower()] = value.strip()
+            if len(request) < 2 or request[0] != "GET":
+                self.respond(writer, 405, "Method Not Allowed", ["Content-Length: 0"])
+                return
+            name = os.path.basename(request[1])
+            path = os.path.join(self.directory, name)
+            if not name or not os.path.isfile(path):
+                self.requests.append((name, 0, 404))
+                self.respond(writer, 404, "Not Found", ["Content-Length: 0"])
+                return
+            with open(path, "rb") as file:
+                data = file.read()
+            match = re.match(r"bytes=(\d+)-$", headers.get("range", ""))
+            first = int(match.group(1)) if match else 0
+            if first >= len(data) and first > 0:
+                self.requests.append((name, first, 416))
+                self.respond(writer, 416, "Range Not Satisfiable", ["Content-Range: bytes */%d" % len(data),
+                                                                    "Content-Length: 0"])
+                return
+            body = data[first:]
+            if match:
+                self.requests.append((name, first, 206))
+                self.respond(writer, 206, "Partial Content", [
+                    "Content-Range: bytes %d-%d/%d" % (first, len(data) - 1, len(data)),
+                    "Content-Length: %d" % len(body)])
+            else:
+                self.requests.append((name, 0, 200))
+                self.respond(writer, 200, "OK", ["Content-Length: %d" % len(body)])
+            if self.cut > 0:
+                body = body[:self.cut]
+            for start in range(0, len(body), CHUNK):
+                chunk = body[start:start + CHUNK]
+                writer.write(chunk)
+                await writer.drain()
+                self.sent[name] += len(chunk)
+                if self.rate > 0:
+                    await asyncio.sleep(len(chunk) / self.rate)
+        except (ConnectionError, asyncio.IncompleteReadError):
+            pass
+        finally:
+            writer.close()
+
+
+async def report(server, interval):
+    while True:
+        await asyncio.sleep(interval)
+        for name, sent in sorted(server.sent.items()):
+            print("%s: %d bytes sent" % (name, sent), file=sys.stderr)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="HTTP server for the firmware update of ota.h")
+    parser.add_argument("--directory", default=".", help="images and patches")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--cut", type=int, default=0, help="bytes of the body after which a response is cut")
+    parser.add_argument("--rate", type=float, default=0, help="bytes per second")
+    parser.add_argument("--stats", type=float, default=0, help="seconds between reports of the bytes sent")
+    args = parser.parse_args()
+
+    server = Server(args.directory, args.cut, args.rate)
+    await server.start(args.host, args.port)
+    print("serving %s on %s:%d" % (args.directory, args.host, server.port), file=sys.stderr)
+    if args.stats > 0:
+        asyncio.ensure_future(report(server, args.stats))
+    await server.server.serve_forever()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  refillplan:   Plans the refill rounds from when each tank runs dry. The time to dry comes from
+#                the same model as forecastHoursToDry() in the sketch: every pump of the tank pours
+#                ledgerPredict() of its amount when its next watering counter runs out, the tank is
+#                dry below its runs dry threshold. Input is either a JSON file with the schedules
+#                    [{"nanny": "1", "throughput": 30, "position": [12.5, 3.0],
+#                      "tanks": [{"remaining": 1400, "container": 2000, "correction": 1000, "runsDry": 200}],
+#                      "pumps": [{"tank": 0, "freq": 24, "next": 5, "amount": 10}]}, ...]
+#                with the names of settings.h (amount in seconds, hours for freq and next, position
+#                optional), or the store of tools/telemetrystore.py with the forecasts the nannies
+#                publish, there a full tank is assumed to last as long as its current consumption.
+#                Each visit is as late as possible, one hour per --margin before the first tank runs
+#                dry. A visit refills the tanks that are due and those that would otherwise run dry
+#                before the next visit. Pushing every visit as far as the tanks allow gives the fewest
+#                visits, no tank is topped up that would not force an earlier visit.
+#                Within a visit the tanks are ordered along a Hilbert curve over their positions,
+#                without positions by urgency.
+#                  tools/refillplan.py --json nannies.json --visits 3
+#                  tools/refillplan.py --store ~/nannies --margin 12
+#***************************************************************************************************
+
+import argparse
+import heapq
+import json
+import math
+import os
+import sys
+import time
+
+FORECAST_MAX_DAYS = 365
+WATERING_FREQ_OFF = 0
+PUMP_RUNS_DRY = 200                      # the store has no thresholds, settings.h default
+
+
+class Tank:
+    def __init__(self, name, remaining, container, runs_dry, pumps, position, full_hours=None):
+        self.name = name
+        self.remaining = remaining
+        self.container = container
+        self.runs_dry = runs_dry
+        self.pumps = pumps              # (first pour in hours from now, every n hours, ml)
+        self.position = position
+        self.full_hours = full_hours    # known duration of a full tank, store input only
+        self.dry = self.dry_hour(0, remaining)
+
+    def dry_hour(self, start, level):
+        """hour from now the tank is dry when it holds level at hour start, see forecastHoursToDry()"""
+        limit = start + FORECAST_MAX_DAYS * 24
+        if self.full_hours is not None:
+            if level <= self.runs_dry:
+                return start
+            return min(limit, start + self.full_hours)
+        events = []
+        for first, period, ml in self.pumps:
+            # first pour at or after start
+            if first < start:
+                first += -(-(start - first) // period) * period
+            heapq.heappush(events, (first, period, ml))
+        # every span of the common period pours the same, skip all but the last before it runs dry
+        span = math.lcm(*[period for first, period, ml in events]) if events else 0
+        spent = sum(ml * (span // period) for first, period, ml in events)
+        if spent > 0:
+            skipped = max(0, (level - self.runs_dry) // spent - 1)
+            level -= skipped * spent
+            events = [(first + skipped * span, period, ml) for first, period, ml in events]
+            heapq.heapify(events)
+        while level > self.runs_dry:
+            if not events:
+                return limit
+            hour, period, ml = heapq.heappop(events)
+            if hour >= limit:
+                return limit
+            level -= ml
+            heapq.heappush(events, (hour + period, period, ml))
+            if level <= self.runs_dry:
+                return hour + 1
+        return start
+
+
+def tanks_from_json(path):
+    with open(path) as file:
+        nannies = json.load(file)
+    tanks = []
+    for nanny in nannies:
+        for number, tank in enumerate(nanny["tanks"]):
+            pumps = []
+            for pump in nanny["pumps"]:
+                if pump.get("tank", 0) != number or pump["freq"] == WATERING_FREQ_OFF:
+                    continue
+                # ledgerPredict(), integer as on the device
+                ml = pump["amount"] * 1000 * nanny["throughput"] * tank.get("correction", 1000) // (1000 * 1000)
+                # the simulation pours in the hour its counter reaches 0
+                pumps.append((max(pump["next"] - 1, 0), pump["freq"], ml))
+            name = nanny["nanny"] if number == 0 else "%s/tank%d" % (nanny["nanny"], number + 1)
+            tanks.append(Tank(name, tank["remaining"], tank["container"], tank.get("runsDry", PUMP_RUNS_DRY), pumps,
+                              nanny.get("position")))
+    return tanks
+
+
+def tanks_from_store(path):
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    from telemetrystore import Store
+    store = Store(path)
+    now = time.time()
+    tanks = []
+    # hours-to-dry of the first tank, tank2.hours-to-dry and so on of the others
+    for metric in sorted(name for name in os.listdir(path) if name.endswith("hours-to-dry")):
+        prefix = metric[:-len("hours-to-dry")]
+        if not all(os.path.exists(os.path.join(path, prefix + name, "latest")) for name in ("water-level", "container-size")):
+            continue
+        levels = store.latest_values(prefix + "water-level")
+        containers = store.latest_values(prefix + "container-size")
+        for device, (stamp, hours) in store.latest_values(metric).items():
+            if device not in levels or device not in containers:
+                continue
+            level = int(levels[device][1])
+            container = int(containers[device][1])
+            if level > PUMP_RUNS_DRY and hours < FORECAST_MAX_DAYS * 24:
+                full = hours * (container - PUMP_RUNS_DRY) / (level - PUMP_RUNS_DRY)
+            else:
+                full = FORECAST_MAX_DAYS * 24
+            tank = Tank(store.devices[device] + ("/" + prefix[:-1] if prefix else ""), level, container,
+                        PUMP_RUNS_DRY, [], None, int(full))
+            tank.dry = int(max(0, hours - (now - stamp) / 3600))
+            tanks.append(tank)
+    return tanks
+
+
+def hilbert(x, y, order=16):
+    """position along a Hilbert curve of the unit square"""
+    side = 1 << order
+    x = min(side - 1, int(x * side))
+    y = min(side - 1, int(y * side))
+    distance = 0
+    scale = side >> 1
+    while scale > 0:
+        rx = 1 if x & scale else 0
+        ry = 1 if y & scale else 0
+        distance += scale * scale * ((3 * rx) ^ ry)
+        if ry == 0:
+            if rx == 1:
+                x = side - 1 - x
+                y = side - 1 - y
+            x, y = y, x
+        scale >>= 1
+    return distance
+
+
+def route(tanks):
+    placed = [tank for tank in tanks if tank.position]
+    if len(placed) < len(tanks):
+        return sorted(tanks, key=lambda tank: tank.dry)
+    left = min(tank.position[0] for tank in tanks)
+    bottom = min(tank.position[1] for tank in tanks)
+    size = max(max(tank.position[0] - left for tank in tanks), max(tank.position[1] - bottom for tank in tanks)) or 1
+    return sorted(tanks, key=lambda tank: hilbert((tank.position[0] - left) / size, (tank.position[1] - bottom) / size))
+
+
+def plan(tanks, visits, margin):
+    """[(hour of the visit, [(tank, hours it has left)] in route order)]"""
+    rounds = []
+    now = 0
+    for _ in range(visits):
+        pending = [tank for tank in tanks if tank.dry < FORECAST_MAX_DAYS * 24]
+        if not pending:
+            break
+        visit = max(now, min(tank.dry for tank in pending) - margin)
+        refill = {id(tank): (tank, tank.dry_hour(visit, tank.container))
+                  for tank in pending if tank.dry - margin <= visit}
+        # add the tanks that would force a visit before the refilled ones allow the next
+        while True:
+            next_visit = min(full for tank, full in refill.values()) - margin
+            more = [tank for tank in pending if id(tank) not in refill and tank.dry - margin < next_visit]
+            if not more:
+                break
+            for tank in more:
+                refill[id(tank)] = (tank, tank.dry_hour(visit, tank.container))
+        rounds.append((visit, [(tank, tank.dry - visit) for tank in route([tank for tank, full in refill.values()])]))
+        for tank, full in refill.values():
+            tank.dry = full
+        now = visit + 1
+    return rounds
+
+
+def main():
+    parser = argparse.ArgumentParser(description="refill rounds from the forecasts of the plant nannies")
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--json", help="schedules and levels of all nannies")
+    source.add_argument("--store", help="directory of tools/telemetrystore.py")
+    parser.add_argument("--margin", type=int, default=24, help="hours before a tank runs dry")
+    parser.add_argument("--visits", type=int, default=1, help="visits to plan ahead")
+    args = parser.parse_args()
+
+    started = time.perf_counter()
+    tanks = tanks_from_json(args.json) if args.json else tanks_from_store(args.store)
+    rounds = plan(tanks, args.visits, args.margin)
+    elapsed = time.perf_counter() - started
+    now = time.time()
+    for number, (hour, route_tanks) in enumerate(rounds, 1):
+        print("visit %d: %s, %d tanks" % (number, time.strftime("%Y-%m-%d %H:00", time.localtime(now + hour * 3600)),
+                                          len(route_tanks)))
+        for tank, left in route_tanks:
+            print("  %-16s %5d h left, %5d ml" % (tank.name, left, tank.container))
+    if not rounds:
+        print("no tank runs dry within %d days" % FORECAST_MAX_DAYS)
+    print("%d tanks planned in %.0f ms" % (len(tanks), 1000 * elapsed), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
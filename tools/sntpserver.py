@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  sntpserver:   Small SNTP server for tests on the host, so sntp.h can be tried without the pool.
+#                Replies with the clock of the host, the transmit timestamp of the request echoed as
+#                originate timestamp. Faults for tests: --fault silent never replies, mode replies
+#                in client mode, stratum0 sends a kiss of death, leap says the server is not
+#                synchronised; --delay holds every reply back, --offset moves the time sent.
+#                  tools/sntpserver.py --port 1123 --fault stratum0 --offset 3600
+#                Embedded in a python test, the server runs in the event loop of the test:
+#                  server = Server(delay=200)
+#                  await server.start("127.0.0.1", 0)      # server.port is the port it got
+#                Several servers on 127.0.0.x share one port, as the pool of sntpServers does.
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import struct
+import sys
+import time
+
+PACKET_SIZE = 48
+UNIX_OFFSET = 2208988800                # seconds from 1.1.1900 to 1.1.1970
+FAULTS = ["none", "silent", "mode", "stratum0", "leap"]
+
+
+def timestamp(seconds):
+    """NTP timestamp of a unix time"""
+    seconds += UNIX_OFFSET
+    return struct.pack("!II", int(seconds) & 0xFFFFFFFF, int((seconds % 1) * 2 ** 32))
+
+
+class Server(asyncio.DatagramProtocol):
+    def __init__(self, fault="none", delay=0.0, offset=0.0, stratum=2):
+        self.fault = fault
+        self.delay = delay              # seconds a reply is held back
+        self.offset = offset            # seconds added to the time sent
+        self.stratum = stratum
+        self.transport = None
+        self.port = None
+        self.requests = 0
+        self.replies = 0
+
+    async def start(self, host, port):
+        loop = asyncio.get_running_loop()
+        self.transport, _ = await loop.create_datagram_endpoint(lambda: self, local_addr=(host, port))
+        self.port = self.transport.get_extra_info("sockname")[1]
+
+    async def stop(self):
+        self.transport.close()
+
+    def datagram_received(self, data, address):
+        received = time.time() + self.offset
+        if len(data) < PACKET_SIZE or data[0] & 0x07 != 3:
+            return                      # not a client request
+        self.requests += 1
+        if self.fault == "silent":
+            return
+        if self.delay > 0:
+            asyncio.get_running_loop().call_later(self.delay, self.reply, data, address, received)
+        else:
+            self.reply(data, address, received)
+
+    def reply(self, request, address, received):
+        leap = 3 if self.fault == "leap" else 0
+        mode = 3 if self.fault == "mode" else 4
+        stratum = 0 if self.fault == "stratum0" else self.stratum
+        reply = bytes([(leap << 6) | (4 << 3) | mode, stratum, request[2], 0xEC]) + bytes(8) + \
+            (b"RATE" if stratum == 0 else b"LOCL") + timestamp(received) + request[40:48] + \
+            timestamp(received) + timestamp(time.time() + self.offset)
+        self.transport.sendto(reply, address)
+        self.replies += 1
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="SNTP server for tests")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=123)
+    parser.add_argument("--fault", default="none", choices=FAULTS, help="how the replies are wrong")
+    parser.add_argument("--delay", type=float, default=0, help="ms every reply is held back")
+    parser.add_argument("--offset", type=float, default=0, help="seconds added to the time sent")
+    args = parser.parse_args()
+
+    server = Server(args.fault, args.delay / 1000, args.offset)
+    await server.start(args.host, args.port)
+    print("listening on %s:%d" % (args.host, server.port), file=sys.stderr, flush=True)
+    await asyncio.Event().wait()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
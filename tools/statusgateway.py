@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  statusgateway: Gateway for the status frames over UDP, see statusudp.h. Checks the HMAC of each
+#                datagram with SECRET_STATUS_UDP_KEY and the crc of its frame, answers it and
+#                publishes the frame on plant-nanny/<n>/status as if the nanny had sent it over MQTT.
+#                A frame whose time is not newer than the last one of that nanny is dropped, unless
+#                it is the same datagram again because the reply got lost, that one is answered again
+#                and not published twice.
+#                The gateway watches the command topics of all nannies on the broker. A command sets
+#                STATUS_UDP_REPLY_COMMANDS in the next reply to that nanny, until the nanny publishes
+#                over MQTT itself, it has then taken the commands from its persistent session.
+#                  tools/statusgateway.py --key "your status key" --host broker
+#                  tools/statusgateway.py --key-file status.key --udp-port 5683 --verbose
+#***************************************************************************************************
+
+import argparse
+import asyncio
+import hashlib
+import hmac
+import struct
+import sys
+
+from mqttbroker import encode_string, packet
+from telemetrystore import decode_status, read_packet
+
+MAIN_TOPIC = b"plant-nanny"
+STATUS_TOPIC = b"status"
+STATUS_UDP_MAC_SIZE = 8
+STATUS_UDP_REPLY_COMMANDS = 0x01
+HEADER = struct.Struct("<2sI")          # magic, nonce
+FRAME_TIME = struct.Struct("<BBI")      # version, nanny, time
+KEEP_ALIVE = 60
+
+
+def mac(key, data):
+    return hmac.new(key, data, hashlib.sha256).digest()[:STATUS_UDP_MAC_SIZE]
+
+
+class Gateway(asyncio.DatagramProtocol):
+    def __init__(self, key, verbose):
+        self.key = key
+        self.verbose = verbose
+        self.last = {}                  # nanny: (frame time, nonce) of the last published frame
+        self.commands = set()           # nannies with commands waiting on the broker
+        self.writer = None              # of the broker connection, None while it is down
+        self.transport = None
+        self.published = 0
+        self.dropped = 0
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, address):
+        size = HEADER.size + STATUS_UDP_MAC_SIZE
+        if len(data) < size or data[:2] != b"PN" or not hmac.compare_digest(mac(self.key, data[:-STATUS_UDP_MAC_SIZE]),
+                                                                          data[-STATUS_UDP_MAC_SIZE:]):
+            self.drop("forged or broken datagram from %s" % address[0])
+            return
+        nonce = HEADER.unpack_from(data)[1]
+        frame = data[HEADER.size:-STATUS_UDP_MAC_SIZE]
+        if decode_status(frame) is None:
+            self.drop("unknown status frame from %s" % address[0])
+            return
+        _, nanny, frame_time = FRAME_TIME.unpack_from(frame)
+        last_time, last_nonce = self.last.get(nanny, (0, None))
+        if frame_time == last_time and nonce == last_nonce:
+            pass                        # the reply got lost, the frame is published already
+        elif frame_time <= last_time:
+            self.drop("replayed frame of nanny %d" % nanny)
+            return
+        else:
+            if self.writer is None:
+                self.drop("no broker, frame of nanny %d not answered" % nanny)
+                return                  # the nanny falls back to MQTT
+            self.writer.write(packet(3, 0, encode_string(MAIN_TOPIC + b"/%d/" % nanny + STATUS_TOPIC) + frame))
+            self.last[nanny] = (frame_time, nonce)
+            self.published += 1
+        flags = STATUS_UDP_REPLY_COMMANDS if nanny in self.commands else 0
+        reply = HEADER.pack(b"PN", nonce) + bytes([flags])
+        self.transport.sendto(reply + mac(self.key, reply), address)
+        if self.verbose:
+            print("nanny %d: %d bytes from %s%s" % (nanny, len(frame), address[0],
+                                                    ", commands waiting" if flags else ""), file=sys.stderr)
+
+    def drop(self, reason):
+        self.dropped += 1
+        if self.verbose:
+            print(reason, file=sys.stderr)
+
+    def message(self, topic, payload):
+        parts = topic.split(b"/")
+        if len(parts) < 3 or parts[0] != MAIN_TOPIC or not parts[1].isdigit():
+            return
+        nanny = int(parts[1])
+        if parts[-1].startswith(b"command-"):
+            if payload:
+                self.commands.add(nanny)
+        elif parts[2:] != [STATUS_TOPIC]:
+            # status also comes from this gateway, anything else only from the nanny over MQTT
+            self.commands.discard(nanny)
+
+
+async def broker_connection(gateway, args):
+    while True:
+        try:
+            reader, writer = await asyncio.open_connection(args.host, args.port)
+            flags = (0x80 if args.user else 0) | (0x40 if args.password else 0)
+            body = encode_string(b"MQTT") + bytes([4, 0x02 | flags]) + struct.pack("!H", KEEP_ALIVE)
+            body += encode_string(b"PlantNannyStatusGateway")
+            for text in (args.user, args.password):
+                if text:
+                    body += encode_string(text.encode())
+            writer.write(packet(1, 0, body))
+            header, body = await read_packet(reader)
+            if header >> 4 != 2 or body[1] != 0:
+                sys.exit("broker refused the connection")
+            writer.write(packet(8, 2, struct.pack("!H", 1) + encode_string(MAIN_TOPIC + b"/+/#") + b"\x00"))
+            gateway.writer = writer
+            print("connected to %s:%d" % (args.host, args.port), file=sys.stderr)
+            while True:
+                try:
+                    header, body = await asyncio.wait_for(read_packet(reader), KEEP_ALIVE / 2)
+                except asyncio.TimeoutError:
+                    writer.write(packet(12, 0, b""))
+                    continue
+                if header >> 4 == 3:
+                    length = struct.unpack_from("!H", body)[0]
+                    gateway.message(body[2:2 + length], body[2 + length + (2 if header & 0x06 else 0):])
+        except (OSError, asyncio.IncompleteReadError) as error:
+            print("broker: %s, reconnecting" % error, file=sys.stderr)
+        gateway.writer = None
+        # commands seen so far stay marked, new ones are not seen until the connection is back
+        await asyncio.sleep(5)
+
+
+async def report(gateway, interval):
+    while True:
+        await asyncio.sleep(interval)
+        print("%d published, %d dropped, %d nannies with commands" % (
+            gateway.published, gateway.dropped, len(gateway.commands)), file=sys.stderr)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="UDP status frames of the plant nannies to the broker")
+    key = parser.add_mutually_exclusive_group(required=True)
+    key.add_argument("--key", help="SECRET_STATUS_UDP_KEY")
+    key.add_argument("--key-file", help="file holding SECRET_STATUS_UDP_KEY")
+    parser.add_argument("--udp-host", default="0.0.0.0")
+    parser.add_argument("--udp-port", type=int, default=5683, help="STATUS_UDP_PORT")
+    parser.add_argument("--host", default="127.0.0.1", help="broker")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    parser.add_argument("--stats", type=float, default=0, help="seconds between reports")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+    if args.key_file:
+        with open(args.key_file, "rb") as file:
+            secret = file.read().strip()
+    else:
+        secret = args.key.encode()
+
+    gateway = Gateway(secret, args.verbose)
+    loop = asyncio.get_running_loop()
+    await loop.create_datagram_endpoint(lambda: gateway, local_addr=(args.udp_host, args.udp_port))
+    print("listening on udp %s:%d" % (args.udp_host, args.udp_port), file=sys.stderr)
+    if args.stats > 0:
+        asyncio.ensure_future(report(gateway, args.stats))
+    await broker_connection(gateway, args)
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
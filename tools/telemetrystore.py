@@ -0,0 +1,355 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  telemetrystore: Ingestion store for the telemetry of all nannies. "ingest" subscribes to
+#                plant-nanny/+/#, decodes the text topics and the binary status frame of
+#                statusframe.h and appends every value to per metric column files:
+#                  <store>/<metric>/time, device, value        raw values, one row per message
+#                  <store>/<metric>/index/<device>             rows of that device, in time order
+#                  <store>/<metric>/hourly/...                 min, max, sum and count per device and hour
+#                  <store>/<metric>/latest                     last time and value per device
+#                Queries memory-map the files, a device's range is found by bisecting its index and
+#                "dry" only reads the latest values, so they answer in milliseconds after a year.
+#                  tools/telemetrystore.py --store ~/nannies ingest --host broker
+#                  tools/telemetrystore.py --store ~/nannies dry --days 2
+#                  tools/telemetrystore.py --store ~/nannies series 3 water-level --hourly
+#                Metrics of the further tanks are prefixed, i.e. tank2.water-level. Only one ingest
+#                may write a store, queries can run at the same time.
+#***************************************************************************************************
+
+import argparse
+import array
+import asyncio
+import bisect
+import mmap
+import os
+import signal
+import struct
+import sys
+import time
+
+from mqttbroker import encode_string, packet
+
+MAIN_TOPIC = b"plant-nanny"
+FLUSH_SECONDS = 5
+
+# text topic: metric, factor to the stored unit
+TEXT_TOPICS = {
+    b"battery-value": ("battery", 1),                   # V
+    b"water-level": ("water-level", 1),                 # ml
+    b"water-correction": ("water-correction", 1),       # 1.000 is pump time only
+}
+
+STATUS_FLAG_NO_TIME = 0x08
+
+
+def crc8(data):
+    # as eventLogCrc()
+    crc = 0xFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x31 if crc & 0x80 else crc << 1) & 0xFF
+    return crc
+
+
+def decode_status(payload):
+    """statusFrame_t of version 1 or 2, None if it is not one"""
+    if len(payload) < 16 or crc8(payload[:-1]) != payload[-1]:
+        return None
+    version = payload[0]
+    fixed = {1: 16, 2: 18}.get(version)
+    if fixed is None or (len(payload) - fixed) % 2 != 0:
+        return None
+    pumps = (len(payload) - fixed) // 2
+    _, _, frame_time, battery_mv, remaining, container, correction = struct.unpack_from("<BBIHhHH", payload)
+    flags = payload[14 + 2 * pumps]
+    values = {
+        "battery": battery_mv / 1000,
+        "water-level": remaining,
+        "container-size": container,
+        "water-correction": correction / 1000,
+    }
+    if version >= 2:
+        values["hours-to-dry"] = struct.unpack_from("<H", payload, 15 + 2 * pumps)[0]
+    return (None if flags & STATUS_FLAG_NO_TIME else frame_time), values
+
+
+def decode(sub_topic, payload, received):
+    """(time, {metric: value}) of one message, None for topics that are not stored"""
+    prefix = b""
+    if sub_topic.startswith(b"tank") and b"/" in sub_topic:
+        prefix, sub_topic = sub_topic.split(b"/", 1)
+        prefix += b"."
+    try:
+        if sub_topic == b"status" and not prefix:
+            decoded = decode_status(payload)
+            if decoded is None:
+                return None
+            return decoded[0] or received, decoded[1]
+        if sub_topic == b"forecast":
+            hours, dry_at = payload.split(b",")
+            values = {"hours-to-dry": int(hours)}
+            if int(dry_at) > 0:
+                values["dry-at"] = int(dry_at)
+            return received, {prefix.decode() + name: value for name, value in values.items()}
+        if sub_topic in TEXT_TOPICS:
+            name, factor = TEXT_TOPICS[sub_topic]
+            return received, {prefix.decode() + name: float(payload) * factor}
+    except ValueError:
+        return None
+    return None
+
+
+class Table:
+    """columns of fixed size values with one row index per device, appended in time order"""
+
+    def __init__(self, path, columns):
+        self.path = path
+        self.columns = columns          # (name, array typecode), the first two are time and device
+        self.pending = {name: array.array(code) for name, code in columns}
+        self.index = {}                 # device: array of rows not yet written
+        self.rows = None
+
+    def count(self):
+        if self.rows is None:
+            name, code = self.columns[0]
+            try:
+                self.rows = os.path.getsize(os.path.join(self.path, name)) // array.array(code).itemsize
+            except OSError:
+                self.rows = 0
+        return self.rows
+
+    def append(self, *values):
+        row = self.count() + len(self.pending[self.columns[0][0]])
+        for (name, _), value in zip(self.columns, values):
+            self.pending[name].append(value)
+        self.index.setdefault(values[1], array.array("I")).append(row)
+
+    def flush(self):
+        os.makedirs(os.path.join(self.path, "index"), exist_ok=True)
+        for name, code in self.columns:
+            with open(os.path.join(self.path, name), "ab") as file:
+                self.pending[name].tofile(file)
+            self.pending[name] = array.array(code)
+        self.rows = None
+        for device, rows in self.index.items():
+            with open(os.path.join(self.path, "index", str(device)), "ab") as file:
+                rows.tofile(file)
+        self.index = {}
+
+
+def mapped(path, code):
+    """read only view of a column file, empty if there is none"""
+    try:
+        with open(path, "rb") as file:
+            if os.fstat(file.fileno()).st_size == 0:
+                return memoryview(b"").cast(code)
+            return memoryview(mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)).cast(code)
+    except FileNotFoundError:
+        return memoryview(b"").cast(code)
+
+
+class Store:
+    RAW = [("time", "I"), ("device", "H"), ("value", "d")]
+    HOURLY = [("time", "I"), ("device", "H"), ("min", "d"), ("max", "d"), ("sum", "d"), ("count", "I")]
+    LATEST = struct.Struct("<Id")       # time 0 if never
+
+    def __init__(self, path):
+        self.path = path
+        os.makedirs(path, exist_ok=True)
+        self.devices = []
+        try:
+            with open(os.path.join(path, "devices")) as file:
+                self.devices = file.read().split()
+        except FileNotFoundError:
+            pass
+        self.device_ids = {name: number for number, name in enumerate(self.devices)}
+        self.tables = {}
+        self.buckets = {}               # (metric, device): [hour, min, max, sum, count]
+        self.latest = {}                # (metric, device): (time, value)
+
+    def device(self, name):
+        if name not in self.device_ids:
+            self.device_ids[name] = len(self.devices)
+            self.devices.append(name)
+            with open(os.path.join(self.path, "devices"), "a") as file:
+                file.write(name + "\n")
+        return self.device_ids[name]
+
+    def table(self, metric, hourly=False):
+        key = (metric, hourly)
+        if key not in self.tables:
+            path = os.path.join(self.path, metric, "hourly") if hourly else os.path.join(self.path, metric)
+            self.tables[key] = Table(path, self.HOURLY if hourly else self.RAW)
+        return self.tables[key]
+
+    def add(self, device_name, stamp, values):
+        device = self.device(device_name)
+        for metric, value in values.items():
+            self.table(metric).append(stamp, device, value)
+            self.latest[(metric, device)] = (stamp, value)
+            hour = stamp - stamp % 3600
+            bucket = self.buckets.get((metric, device))
+            if bucket is not None and bucket[0] != hour:
+                self.table(metric, True).append(*bucket[:1], device, *bucket[1:])
+                bucket = None
+            if bucket is None:
+                self.buckets[(metric, device)] = [hour, value, value, value, 1]
+            else:
+                bucket[1] = min(bucket[1], value)
+                bucket[2] = max(bucket[2], value)
+                bucket[3] += value
+                bucket[4] += 1
+
+    def flush(self, closing=False):
+        if closing:
+            for (metric, device), bucket in self.buckets.items():
+                self.table(metric, True).append(*bucket[:1], device, *bucket[1:])
+            self.buckets = {}
+        for table in self.tables.values():
+            table.flush()
+        by_metric = {}
+        for (metric, device), latest in self.latest.items():
+            by_metric.setdefault(metric, []).append((device, latest))
+        for metric, values in by_metric.items():
+            path = os.path.join(self.path, metric, "latest")
+            with open(path, "r+b" if os.path.exists(path) else "w+b") as file:
+                for device, (stamp, value) in values:
+                    file.seek(device * self.LATEST.size)
+                    file.write(self.LATEST.pack(stamp, value))
+        self.latest = {}
+
+    def latest_values(self, metric):
+        """{device: (time, value)} from the memory-mapped latest file"""
+        values = {}
+        view = mapped(os.path.join(self.path, metric, "latest"), "B")
+        for device, (stamp, value) in enumerate(self.LATEST.iter_unpack(view[:len(view) // self.LATEST.size * self.LATEST.size])):
+            if stamp > 0:
+                values[device] = (stamp, value)
+        return values
+
+    def series(self, device, metric, start, end, hourly=False):
+        path = os.path.join(self.path, metric, "hourly") if hourly else os.path.join(self.path, metric)
+        columns = self.HOURLY if hourly else self.RAW
+        rows = mapped(os.path.join(path, "index", str(device)), "I")
+        times = mapped(os.path.join(path, "time"), "I")
+        views = [mapped(os.path.join(path, name), code) for name, code in columns[2:]]
+        first = bisect.bisect_left(rows, start, key=lambda row: times[row])
+        last = bisect.bisect_left(rows, end, key=lambda row: times[row])
+        return [(times[row],) + tuple(view[row] for view in views) for row in rows[first:last]]
+
+
+async def read_packet(reader):
+    header = (await reader.readexactly(1))[0]
+    length = 0
+    for shift in range(0, 28, 7):
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            break
+    return header, await reader.readexactly(length)
+
+
+async def ingest(store, args):
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    flags = (0x80 if args.user else 0) | (0x40 if args.password else 0)
+    body = encode_string(b"MQTT") + bytes([4, 0x02 | flags]) + struct.pack("!H", 60)
+    body += encode_string(b"PlantNannyStore")
+    for text in (args.user, args.password):
+        if text:
+            body += encode_string(text.encode())
+    writer.write(packet(1, 0, body))
+    header, body = await read_packet(reader)
+    if header >> 4 != 2 or body[1] != 0:
+        sys.exit("broker refused the connection")
+    writer.write(packet(8, 2, struct.pack("!H", 1) + encode_string(MAIN_TOPIC + b"/+/#") + b"\x00"))
+    flushed = time.monotonic()
+    messages = 0
+    try:
+        while True:
+            try:
+                header, body = await asyncio.wait_for(read_packet(reader), FLUSH_SECONDS)
+            except asyncio.TimeoutError:
+                writer.write(packet(12, 0, b""))      # keep alive
+                header = 0
+            if header >> 4 == 3:
+                length = struct.unpack_from("!H", body)[0]
+                topic = body[2:2 + length]
+                payload = body[2 + length + (2 if header & 0x06 else 0):]
+                parts = topic.split(b"/", 2)
+                decoded = decode(parts[2], payload, int(time.time())) if len(parts) == 3 else None
+                if decoded is not None:
+                    store.add(parts[1].decode(errors="replace"), *decoded)
+                    messages += 1
+            if time.monotonic() - flushed > FLUSH_SECONDS:
+                store.flush()
+                flushed = time.monotonic()
+                if args.verbose:
+                    print("%d messages, %d devices" % (messages, len(store.devices)), file=sys.stderr)
+    finally:
+        store.flush(closing=True)
+
+
+def query_dry(store, args):
+    now = int(time.time())
+    limit = args.days * 24
+    started = time.perf_counter()
+    found = []
+    for metric in sorted(name for name in os.listdir(store.path) if name.endswith("hours-to-dry")):
+        for device, (stamp, hours) in store.latest_values(metric).items():
+            left = hours - (now - stamp) / 3600
+            if left < limit:
+                found.append((left, store.devices[device], metric))
+    for left, device, metric in sorted(found):
+        print("%-12s %-24s %6.1f h" % (device, metric, left))
+    print("%d found in %.1f ms" % (len(found), 1000 * (time.perf_counter() - started)), file=sys.stderr)
+
+
+def query_series(store, args):
+    if args.device not in store.device_ids:
+        sys.exit("unknown device %s" % args.device)
+    start = args.start or 0
+    end = args.end or 2 ** 32 - 1
+    for row in store.series(store.device_ids[args.device], args.metric, start, end, args.hourly):
+        stamp = time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(row[0]))
+        if args.hourly:
+            print("%s min %g max %g mean %g" % (stamp, row[1], row[2], row[3] / row[4]))
+        else:
+            print("%s %g" % (stamp, row[1]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="telemetry store of the plant nannies")
+    parser.add_argument("--store", required=True, help="directory of the column files")
+    commands = parser.add_subparsers(dest="command", required=True)
+    command = commands.add_parser("ingest", help="subscribe to the broker and store what comes")
+    command.add_argument("--host", default="127.0.0.1")
+    command.add_argument("--port", type=int, default=1883)
+    command.add_argument("--user", default="")
+    command.add_argument("--password", default="")
+    command.add_argument("--verbose", action="store_true")
+    command = commands.add_parser("dry", help="devices that run dry within the given days")
+    command.add_argument("--days", type=float, default=2)
+    command = commands.add_parser("series", help="values of one device and metric")
+    command.add_argument("device")
+    command.add_argument("metric")
+    command.add_argument("--start", type=int, help="UTC seconds")
+    command.add_argument("--end", type=int, help="UTC seconds")
+    command.add_argument("--hourly", action="store_true", help="hourly rollup instead of raw values")
+    args = parser.parse_args()
+
+    store = Store(args.store)
+    signal.signal(signal.SIGTERM, lambda number, frame: sys.exit(0))
+    if args.command == "ingest":
+        try:
+            asyncio.run(ingest(store, args))
+        except KeyboardInterrupt:
+            pass
+    elif args.command == "dry":
+        query_dry(store, args)
+    else:
+        query_series(store, args)
+
+
+if __name__ == "__main__":
+    main()
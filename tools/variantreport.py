@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+#***************************************************************************************************
+#  variantreport: Flash, RAM and wake time of each BUILD_VARIANT. Compiles a copy of the sketch per
+#                variant with arduino-cli and takes the program storage and global variables it
+#                reports. With --port each variant is uploaded in turn and the awake time of its
+#                first --wakes wakes is read from the "awake for" log line, so LOG_LEVEL must be at
+#                least info. The power on wake comes first, further wakes need the buttons or the
+#                timer. settings.h and secrets.h of the sketch are used as they are, only
+#                BUILD_VARIANT is replaced.
+#                  tools/variantreport.py
+#                  tools/variantreport.py --port /dev/ttyUSB0 --wakes 2 --markdown
+#***************************************************************************************************
+
+import argparse
+import os
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import termios
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SKETCH = "TTGOPlantNanny"
+VARIANTS = ["BUILD_FULL", "BUILD_HEADLESS", "BUILD_MINIMAL"]
+BAUD = termios.B115200                  # as logBegin() in log.h
+
+
+def sketch_copy(directory, variant):
+    path = os.path.join(directory, variant, SKETCH)
+    os.makedirs(path)
+    for name in os.listdir(ROOT):
+        if name.endswith((".ino", ".h")):
+            shutil.copy(os.path.join(ROOT, name), path)
+    settings = os.path.join(path, "settings.h")
+    with open(settings) as file:
+        text = file.read()
+    text, count = re.subn(r"^#define BUILD_VARIANT\s+\w+", "#define BUILD_VARIANT             " + variant, text,
+                          flags=re.M)
+    if count != 1:
+        sys.exit("BUILD_VARIANT not found in settings.h")
+    with open(settings, "w") as file:
+        file.write(text)
+    return path
+
+
+def compile_sketch(path, args):
+    """(flash bytes, flash maximum, RAM bytes, RAM maximum)"""
+    command = ["arduino-cli", "compile", "--fqbn", args.fqbn, "--build-path", os.path.join(path, "build"), path]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout + result.stderr)
+        sys.exit("compiling %s failed" % path)
+    flash = re.search(r"Sketch uses (\d+) bytes .*? Maximum is (\d+) bytes", result.stdout)
+    ram = re.search(r"Global variables use (\d+) bytes .*? Maximum is (\d+) bytes", result.stdout)
+    if flash is None or ram is None:
+        sys.exit("no sizes in the output of arduino-cli:\n" + result.stdout)
+    return int(flash.group(1)), int(flash.group(2)), int(ram.group(1)), int(ram.group(2))
+
+
+def wake_times(path, args):
+    """awake ms of the first args.wakes wakes after the upload"""
+    command = ["arduino-cli", "upload", "--fqbn", args.fqbn, "--port", args.port,
+               "--input-dir", os.path.join(path, "build"), path]
+    if subprocess.run(command, capture_output=True).returncode != 0:
+        sys.exit("upload to %s failed" % args.port)
+    port = os.open(args.port, os.O_RDONLY | os.O_NOCTTY | os.O_NONBLOCK)
+    try:
+        attributes = termios.tcgetattr(port)
+        attributes[0] = attributes[1] = attributes[3] = 0      # raw
+        attributes[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attributes[4] = attributes[5] = BAUD
+        termios.tcsetattr(port, termios.TCSANOW, attributes)
+        times = []
+        line = b""
+        deadline = time.monotonic() + args.timeout
+        while len(times) < args.wakes and time.monotonic() < deadline:
+            try:
+                data = os.read(port, 256)
+            except BlockingIOError:
+                data = b""
+            if not data:
+                time.sleep(0.05)
+                continue
+            line += data
+            while b"\n" in line:
+                text, line = line.split(b"\n", 1)
+                match = re.search(rb"awake for (\d+) ms", text)
+                if match:
+                    times.append(int(match.group(1)))
+        return times
+    finally:
+        os.close(port)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="flash, RAM and wake time per build variant")
+    parser.add_argument("--fqbn", default="esp32:esp32:esp32", help="board of arduino-cli")
+    parser.add_argument("--port", help="serial port of a nanny, to measure the wake times")
+    parser.add_argument("--wakes", type=int, default=1, help="wakes measured per variant")
+    parser.add_argument("--timeout", type=float, default=300, help="seconds to wait for the wakes of a variant")
+    parser.add_argument("--markdown", action="store_true", help="table for the README")
+    args = parser.parse_args()
+    if shutil.which("arduino-cli") is None:
+        sys.exit("arduino-cli not found")
+
+    rows = []
+    with tempfile.TemporaryDirectory() as directory:
+        for variant in VARIANTS:
+            path = sketch_copy(directory, variant)
+            flash, flash_max, ram, ram_max = compile_sketch(path, args)
+            wake = ""
+            if args.port:
+                times = wake_times(path, args)
+                wake = "%d ms" % statistics.median(times) if times else "no wake"
+            rows.append((variant, "%d (%d%%)" % (flash, 100 * flash // flash_max),
+                         "%d (%d%%)" % (ram, 100 * ram // ram_max), wake))
+    columns = 4 if args.port else 3
+    header = ("variant", "flash bytes", "RAM bytes", "wake time")[:columns]
+    rows = [row[:columns] for row in rows]
+    if args.markdown:
+        for row in [header, ("---",) * columns] + rows:
+            print("| " + " | ".join(row) + " |")
+    else:
+        for row in [header] + rows:
+            print("  ".join("%-18s" % cell for cell in row).rstrip())
+
+
+if __name__ == "__main__":
+    main()
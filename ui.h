@@ -0,0 +1,56 @@
+//***************************************************************************************************
+//  ui:           Text widgets for the screens besides the main one. A screen draws each of its widgets
+//                with uiWidget() whenever something may have changed, only widgets whose text or
+//                selection differs from what is on the display are drawn again. uiInvalidate() after
+//                clearing the main area draws everything on the next call.
+//                Widgets are rows of FONT2 in the main area, row 0 is the title of the screen.
+//***************************************************************************************************
+
+#ifndef ui_h
+#define ui_h
+
+#define UI_WIDGETS                5     // rows of the main area
+#define UI_TEXT_LENGTH            24
+#define UI_ROW_HEIGHT             18
+#define UI_ROW_X                  4
+#define UI_ROW_Y                  (LAYOUT_INFO_BAR_HEIGHT + 3)
+#define UI_ROW_WIDTH              (LAYOUT_LANDSCAPE_WIDTH - LAYOUT_BUTTON_WIDTH - 2 * UI_ROW_X)
+
+char uiShown[UI_WIDGETS][UI_TEXT_LENGTH];   // text on the display
+bool uiShownSelected[UI_WIDGETS];
+
+void uiInvalidate() {
+//***************************************************************************************************
+//  the main area was cleared, no widget is on the display
+//***************************************************************************************************
+  int i;
+
+  for(i = 0; i < UI_WIDGETS; i++) {
+    uiShown[i][0] = '\x01';             // never a text
+    uiShownSelected[i] = false;
+  }
+}
+
+bool uiWidget(TFT_eSPI& display, int row, const char* text, bool selected) {
+//***************************************************************************************************
+//  draws the row only if it changed, returns true if it did
+//***************************************************************************************************
+  uint16_t fgcolor = selected ? COLOR_FG_SELECTED : COLOR_FG_MAIN_AREA;
+  uint16_t bgcolor = selected ? COLOR_BG_SELECTED : COLOR_BG_MAIN_AREA;
+  int ypos = UI_ROW_Y + row * UI_ROW_HEIGHT;
+
+  if(row < 0 || row >= UI_WIDGETS ||
+     (strncmp(uiShown[row], text, UI_TEXT_LENGTH - 1) == 0 && uiShownSelected[row] == selected)) {
+    return false;
+  }
+  display.fillRect(UI_ROW_X, ypos, UI_ROW_WIDTH, UI_ROW_HEIGHT, bgcolor);
+  display.setTextColor(fgcolor, bgcolor);
+  display.setTextDatum(TL_DATUM);
+  display.drawString(text, UI_ROW_X + 2, ypos + 1, FONT2);
+  uiShown[row][0] = '\0';
+  fmtAppend(uiShown[row], UI_TEXT_LENGTH, text);
+  uiShownSelected[row] = selected;
+  return true;
+}
+
+#endif